@@ -0,0 +1,94 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include "map.h"
+
+// Wall clock in seconds
+inline double benchNow()
+{
+#ifdef WIN32
+  LARGE_INTEGER freq, now;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&now);
+  return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+inline void benchReport(const std::string& name, long ops, double seconds)
+{
+  printf("%-40s %12ld ops %10.3f ms %10.2f Mops/s\n", name.c_str(), ops, seconds * 1000.0,
+         seconds > 0 ? ops / seconds / 1000000.0 : 0.0);
+}
+
+// Keep the optimiser from dropping benchmark results
+static volatile long benchSink = 0;
+
+// A map to link chunks into. It is never destroyed: its destructor writes
+// level.dat through the server singleton, which isn't running here
+inline Map* benchMap()
+{
+  return new Map;
+}
+
+// A chunk with all of its arrays allocated and zeroed, all air
+inline sChunk* benchChunk(int x, int z)
+{
+  sChunk* chunk = new sChunk;
+  chunk->x          = x;
+  chunk->z          = z;
+  chunk->blocks     = new uint8_t[16 * 16 * 128];
+  chunk->data       = new uint8_t[16 * 16 * 128 / 2];
+  chunk->blocklight = new uint8_t[16 * 16 * 128 / 2];
+  chunk->skylight   = new uint8_t[16 * 16 * 128 / 2];
+  chunk->heightmap  = new uint8_t[16 * 16];
+  memset(chunk->blocks, 0, 16 * 16 * 128);
+  memset(chunk->data, 0, 16 * 16 * 128 / 2);
+  memset(chunk->blocklight, 0, 16 * 16 * 128 / 2);
+  memset(chunk->skylight, 0, 16 * 16 * 128 / 2);
+  memset(chunk->heightmap, 0, 16 * 16);
+  return chunk;
+}
+
+#endif
@@ -0,0 +1,111 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+// ChunkMap lookup/insert throughput, compared against the old fixed
+// 441-bucket chained hash.
+
+#include <cstdlib>
+#include <vector>
+
+#include "chunkmap.h"
+#include "bench.h"
+#include "legacy_chunkmap.h"
+
+namespace
+{
+
+const int LOOKUPS = 2000000;
+
+template <class T>
+void run(const char* name, int count, std::vector<sChunk*>& chunks, const std::vector<int>& probes)
+{
+  T* map = new T;
+  char label[64];
+
+  double start = benchNow();
+  for (int i = 0; i < count; i++)
+  {
+    map->linkChunk(chunks[i], chunks[i]->x, chunks[i]->z);
+  }
+  snprintf(label, sizeof(label), "%s insert %d", name, count);
+  benchReport(label, count, benchNow() - start);
+
+  long found = 0;
+  start = benchNow();
+  for (int i = 0; i < LOOKUPS; i++)
+  {
+    sChunk* chunk = chunks[probes[i]];
+    found += (map->getChunk(chunk->x, chunk->z) != NULL);
+  }
+  snprintf(label, sizeof(label), "%s lookup %d", name, count);
+  benchReport(label, LOOKUPS, benchNow() - start);
+  benchSink += found;
+
+  delete map;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  const int sizes[] = { 1000, 10000, 100000 };
+
+  for (int s = 0; s < 3; s++)
+  {
+    int count = sizes[s];
+
+    // Square-ish area of resident chunks around spawn
+    int side = 1;
+    while (side * side < count)
+    {
+      side++;
+    }
+
+    std::vector<sChunk*> chunks;
+    for (int i = 0; i < count; i++)
+    {
+      sChunk* chunk = new sChunk;
+      chunk->x = i % side - side / 2;
+      chunk->z = i / side - side / 2;
+      chunks.push_back(chunk);
+    }
+
+    std::vector<int> probes(LOOKUPS);
+    srand(1);
+    for (int i = 0; i < LOOKUPS; i++)
+    {
+      probes[i] = rand() % count;
+    }
+
+    // ChunkMap owns its chunks and frees them, so it has to go last
+    run<LegacyChunkMap>("legacy", count, chunks, probes);
+    run<ChunkMap>("open addressing", count, chunks, probes);
+  }
+
+  return 0;
+}
@@ -0,0 +1,255 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// A player sprinting across 100 chunks at view distance 10. Every chunk
+// border runs the queueing loop of User::updatePos (441 addQueue calls and
+// the remove queue for the row left behind), followed by three pushMap()
+// rounds of 5 chunks and a popMap(), as the 1s timer would while running.
+// The old vectors of vec, ChunkSets with the queue sorted on every
+// pushMap(), and the ChunkQueue heap.
+
+#include <cstdlib>
+#include <vector>
+
+#include "chunkset.h"
+#include "chunkqueue.h"
+#include "bench.h"
+#include "legacy_chunkqueue.h"
+
+namespace
+{
+
+const int VIEW_DISTANCE = 10;
+const int CROSSINGS = 100;
+const int RUNS = 20;
+
+// ChunkSets with the queue sorted by distance on every pushMap()
+class SortedChunkQueues
+{
+public:
+  bool addQueue(int x, int z)
+  {
+    mapRemoveQueue.erase(x, z);
+    if (mapQueue.contains(x, z) || mapKnown.contains(x, z))
+    {
+      return false;
+    }
+    mapQueue.insert(x, z);
+    return true;
+  }
+
+  bool addRemoveQueue(int x, int z)
+  {
+    mapRemoveQueue.insert(x, z);
+    return true;
+  }
+
+  void pushMap(int cx, int cz, int maxcount)
+  {
+    mapQueue.sort(DistanceComparator(cx, cz));
+
+    std::vector<uint64_t> sent;
+    for (size_t i = 0; i < mapQueue.size() && maxcount > 0; i++)
+    {
+      maxcount--;
+      mapKnown.insert(mapQueue.x(i), mapQueue.z(i));
+      sent.push_back(mapQueue.keys()[i]);
+    }
+    for (size_t i = 0; i < sent.size(); i++)
+    {
+      mapQueue.erase(ChunkSet::keyX(sent[i]), ChunkSet::keyZ(sent[i]));
+    }
+  }
+
+  void popMap()
+  {
+    for (size_t i = 0; i < mapRemoveQueue.size(); i++)
+    {
+      mapKnown.erase(mapRemoveQueue.x(i), mapRemoveQueue.z(i));
+    }
+    mapRemoveQueue.clear();
+  }
+
+  size_t known() const
+  {
+    return mapKnown.size();
+  }
+
+private:
+  class DistanceComparator
+  {
+  private:
+    int x;
+    int z;
+  public:
+    DistanceComparator(int tx, int tz) : x(tx), z(tz)
+    {
+    }
+    int squareDistance(uint64_t k) const
+    {
+      const int dx = ChunkSet::keyX(k) - x;
+      const int dz = ChunkSet::keyZ(k) - z;
+      return dx * dx + dz * dz;
+    }
+    bool operator()(uint64_t a, uint64_t b) const
+    {
+      return squareDistance(a) < squareDistance(b);
+    }
+  };
+
+  ChunkSet mapQueue;
+  ChunkSet mapRemoveQueue;
+  ChunkSet mapKnown;
+};
+
+// What User does now, without sending anything
+class ChunkQueues
+{
+public:
+  bool addQueue(int x, int z)
+  {
+    mapRemoveQueue.erase(x, z);
+    if (mapQueue.contains(x, z) || mapKnown.contains(x, z))
+    {
+      return false;
+    }
+    mapQueue.insert(x, z);
+    return true;
+  }
+
+  bool addRemoveQueue(int x, int z)
+  {
+    mapRemoveQueue.insert(x, z);
+    return true;
+  }
+
+  void pushMap(int cx, int cz, int maxcount)
+  {
+    mapQueue.setCenter(cx, cz, 270.0f);
+
+    int x, z;
+    while (maxcount > 0 && mapQueue.pop(x, z))
+    {
+      maxcount--;
+      mapKnown.insert(x, z);
+    }
+  }
+
+  void popMap()
+  {
+    for (size_t i = 0; i < mapRemoveQueue.size(); i++)
+    {
+      mapKnown.erase(mapRemoveQueue.x(i), mapRemoveQueue.z(i));
+    }
+    mapRemoveQueue.clear();
+  }
+
+  size_t known() const
+  {
+    return mapKnown.size();
+  }
+
+private:
+  ChunkQueue mapQueue;
+  ChunkSet mapRemoveQueue;
+  ChunkSet mapKnown;
+};
+
+bool withinViewDistance(int a, int b)
+{
+  return a > b ? (a - b) < VIEW_DISTANCE : (b - a) < VIEW_DISTANCE;
+}
+
+template <class Q>
+long sprint()
+{
+  Q queues;
+
+  // Login, everything around the spawn is known
+  for (int x = -VIEW_DISTANCE; x <= VIEW_DISTANCE; x++)
+  {
+    for (int z = -VIEW_DISTANCE; z <= VIEW_DISTANCE; z++)
+    {
+      queues.addQueue(x, z);
+    }
+  }
+  queues.pushMap(0, 0, 441);
+
+  long calls = 0;
+  for (int cx = 1; cx <= CROSSINGS; cx++)
+  {
+    const int cz = 0;
+    const int chunkDiffX = 1;
+    const int chunkDiffZ = 0;
+
+    // Same loop as the neighbouring chunk case in User::updatePos
+    for (int mapx = cx - VIEW_DISTANCE; mapx <= cx + VIEW_DISTANCE; mapx++)
+    {
+      for (int mapz = cz - VIEW_DISTANCE; mapz <= cz + VIEW_DISTANCE; mapz++)
+      {
+        if (!withinViewDistance((mapx - chunkDiffX), cx) || !withinViewDistance((mapz - chunkDiffZ), cz))
+        {
+          queues.addRemoveQueue(mapx - chunkDiffX, mapz - chunkDiffZ);
+          calls++;
+        }
+        queues.addQueue(mapx, mapz);
+        calls++;
+      }
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+      queues.pushMap(cx, cz, 5);
+    }
+    queues.popMap();
+  }
+
+  benchSink += (long)queues.known();
+  return calls;
+}
+
+template <class Q>
+void run(const char* name)
+{
+  long calls = 0;
+  double start = benchNow();
+  for (int i = 0; i < RUNS; i++)
+  {
+    calls += sprint<Q>();
+  }
+  benchReport(name, calls, benchNow() - start);
+}
+
+}
+
+int main()
+{
+  run<LegacyChunkQueues>("vector queues, sprint 100 chunks");
+  run<SortedChunkQueues>("ChunkSet queues, sprint 100 chunks");
+  run<ChunkQueues>("ChunkQueue heap, sprint 100 chunks");
+  return 0;
+}
@@ -0,0 +1,140 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+// Full-chunk scan (16x16x128 voxels) through Map::getBlock, compared against
+// the old per-call work: chained hash lookup plus a time() call per voxel.
+
+#include <cstdlib>
+#include <ctime>
+
+#include "constants.h"
+#include "map.h"
+#include "tools.h"
+#include "bench.h"
+#include "legacy_chunkmap.h"
+
+namespace
+{
+
+const int SCANS = 50;
+
+// Random blocks, so scans can't be predicted
+sChunk* makeChunk(int x, int z)
+{
+  sChunk* chunk = benchChunk(x, z);
+  for (int i = 0; i < 16 * 16 * 128; i++)
+  {
+    chunk->blocks[i] = rand() % 256;
+  }
+  return chunk;
+}
+
+// What Map::getBlock used to do per voxel
+bool legacyGetBlock(LegacyChunkMap& chunks, int x, int y, int z, uint8_t* type, uint8_t* meta)
+{
+  sChunk* chunk = chunks.getChunk(blockToChunk(x), blockToChunk(z));
+  if (chunk == NULL)
+  {
+    return false;
+  }
+
+  int index = y + (blockToChunkBlock(z) << 7) + (blockToChunkBlock(x) << 11);
+  *type = chunk->blocks[index];
+  uint8_t metadata = chunk->data[index >> 1];
+  *meta = (y & 1) ? (metadata >> 4) : (metadata & 0x0f);
+  chunk->lastused = (int)time(0);
+  return true;
+}
+
+// Called through a pointer so it pays for a real call, like Map::getBlock
+bool (* volatile legacyGetBlockFn)(LegacyChunkMap&, int, int, int, uint8_t*, uint8_t*) = legacyGetBlock;
+
+}
+
+int main(int argc, char* argv[])
+{
+  Map* map = benchMap();
+  LegacyChunkMap legacy;
+
+  // Resident area similar to a couple of players online
+  for (int x = -15; x <= 15; x++)
+  {
+    for (int z = -15; z <= 15; z++)
+    {
+      sChunk* chunk = makeChunk(x, z);
+      map->chunks.linkChunk(chunk, x, z);
+      legacy.linkChunk(chunk, x, z);
+    }
+  }
+
+  const long voxels = (long)SCANS * 16 * 16 * 128;
+  uint8_t type, meta;
+  long sum = 0;
+
+  double start = benchNow();
+  for (int s = 0; s < SCANS; s++)
+  {
+    for (int x = 48; x < 64; x++)
+      for (int z = -32; z < -16; z++)
+        for (int y = 0; y < 128; y++)
+        {
+          legacyGetBlockFn(legacy, x, y, z, &type, &meta);
+          sum += type + meta;
+        }
+  }
+  benchReport("legacy getBlock chunk scan", voxels, benchNow() - start);
+
+  start = benchNow();
+  for (int s = 0; s < SCANS; s++)
+  {
+    for (int x = 48; x < 64; x++)
+      for (int z = -32; z < -16; z++)
+        for (int y = 0; y < 128; y++)
+        {
+          map->getBlock(x, y, z, &type, &meta, false);
+          sum += type + meta;
+        }
+  }
+  benchReport("Map::getBlock chunk scan", voxels, benchNow() - start);
+
+  start = benchNow();
+  for (int s = 0; s < SCANS; s++)
+  {
+    for (int x = 48; x < 64; x++)
+      for (int z = -32; z < -16; z++)
+        for (int y = 0; y < 128; y++)
+        {
+          map->setBlock(x, y, z, BLOCK_STONE, 0);
+        }
+  }
+  benchReport("Map::setBlock chunk scan", voxels, benchNow() - start);
+
+  benchSink += sum;
+
+  return 0;
+}
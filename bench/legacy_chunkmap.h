@@ -0,0 +1,105 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef _LEGACY_CHUNKMAP_H
+#define _LEGACY_CHUNKMAP_H
+
+#include <string.h>
+
+#include "chunkmap.h"
+
+// The ChunkMap as it was before the open addressing table
+class LegacyChunkMap
+{
+  struct Node
+  {
+    Node(sChunk* _chunk, Node* _next) : chunk(_chunk), next(_next) {}
+    sChunk* chunk;
+    Node* next;
+  };
+
+public:
+  LegacyChunkMap()
+  {
+    memset(m_buckets, 0, sizeof(m_buckets));
+  }
+
+  ~LegacyChunkMap()
+  {
+    for (int i = 0; i < 441; ++i)
+    {
+      Node* node = m_buckets[i];
+      while (node != NULL)
+      {
+        Node* next = node->next;
+        delete node;
+        node = next;
+      }
+    }
+  }
+
+  int hash(int x, int z)
+  {
+    x %= 21;
+    if (x < 0)
+    {
+      x += 21;
+    }
+
+    z %= 21;
+    if (z < 0)
+    {
+      z += 21;
+    }
+
+    return x + z * 21;
+  }
+
+  sChunk* getChunk(int x, int z)
+  {
+    for (Node* node = m_buckets[hash(x, z)]; node != NULL; node = node->next)
+    {
+      if ((node->chunk->x == x) && (node->chunk->z == z))
+      {
+        return node->chunk;
+      }
+    }
+    return NULL;
+  }
+
+  void linkChunk(sChunk* chunk, int x, int z)
+  {
+    int _hash = hash(x, z);
+    m_buckets[_hash] = new Node(chunk, m_buckets[_hash]);
+  }
+
+private:
+  Node* m_buckets[441];
+};
+
+#endif
@@ -0,0 +1,139 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _LEGACY_CHUNKQUEUE_H
+#define _LEGACY_CHUNKQUEUE_H
+
+#include <algorithm>
+#include <vector>
+
+#include "vec.h"
+
+// The User chunk queues as they were before ChunkSet: linear scans over
+// vectors of vec. Sending and the chunk user bookkeeping are left out.
+class LegacyChunkQueues
+{
+public:
+  bool addQueue(int x, int z)
+  {
+    vec newMap(x, 0, z);
+
+    for (unsigned int i = 0; i < mapRemoveQueue.size(); i++)
+    {
+      if (mapRemoveQueue[i].x() == newMap.x() && mapRemoveQueue[i].z() == newMap.z())
+      {
+        mapRemoveQueue.erase(mapRemoveQueue.begin() + i);
+        break;
+      }
+    }
+
+    for (unsigned int i = 0; i < mapQueue.size(); i++)
+    {
+      if (mapQueue[i].x() == newMap.x() && mapQueue[i].z() == newMap.z())
+      {
+        return false;
+      }
+    }
+
+    for (unsigned int i = 0; i < mapKnown.size(); i++)
+    {
+      if (mapKnown[i].x() == newMap.x() && mapKnown[i].z() == newMap.z())
+      {
+        return false;
+      }
+    }
+
+    mapQueue.push_back(newMap);
+    return true;
+  }
+
+  bool addRemoveQueue(int x, int z)
+  {
+    mapRemoveQueue.push_back(vec(x, 0, z));
+    return true;
+  }
+
+  bool delKnown(int x, int z)
+  {
+    for (unsigned int i = 0; i < mapKnown.size(); i++)
+    {
+      if (mapKnown[i].x() == x && mapKnown[i].z() == z)
+      {
+        mapKnown.erase(mapKnown.begin() + i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void pushMap(int cx, int cz, int maxcount)
+  {
+    sort(mapQueue.begin(), mapQueue.end(), DistanceComparator(vec(cx, 0, cz)));
+
+    while (mapQueue.size() && maxcount > 0)
+    {
+      maxcount--;
+      mapKnown.push_back(mapQueue[0]);
+      mapQueue.erase(mapQueue.begin());
+    }
+  }
+
+  void popMap()
+  {
+    while (mapRemoveQueue.size())
+    {
+      delKnown(mapRemoveQueue[0].x(), mapRemoveQueue[0].z());
+      mapRemoveQueue.erase(mapRemoveQueue.begin());
+    }
+  }
+
+  size_t known() const
+  {
+    return mapKnown.size();
+  }
+
+private:
+  class DistanceComparator
+  {
+  private:
+    vec target;
+  public:
+    DistanceComparator(vec tgt) : target(tgt)
+    {
+    }
+    bool operator()(vec a, vec b) const
+    {
+      return vec::squareDistance(a, target) < vec::squareDistance(b, target);
+    }
+  };
+
+  std::vector<vec> mapQueue;
+  std::vector<vec> mapRemoveQueue;
+  std::vector<vec> mapKnown;
+};
+
+#endif
@@ -0,0 +1,100 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _LEGACY_PACKET_H
+#define _LEGACY_PACKET_H
+
+#include <string.h>
+#include <vector>
+
+#include "tools.h"
+
+// Read side of Packet as it was before the receive buffer kept an offset:
+// appends every recv() and erases each parsed packet from the front
+class LegacyPacket
+{
+public:
+  LegacyPacket() : m_readPos(0), m_isValid(true) {}
+
+  bool haveData(int requiredBytes)
+  {
+    return m_isValid = m_isValid && ((m_readPos + requiredBytes) <= m_readBuffer.size());
+  }
+
+  operator bool() const
+  {
+    return m_isValid;
+  }
+
+  void reset()
+  {
+    m_readPos = 0;
+    m_isValid = true;
+  }
+
+  void addToRead(const void* data, size_t dataSize)
+  {
+    size_t start = m_readBuffer.size();
+    m_readBuffer.resize(start + dataSize);
+    memcpy(&m_readBuffer[start], data, dataSize);
+  }
+
+  void removePacket()
+  {
+    m_readBuffer.erase(m_readBuffer.begin(), m_readBuffer.begin() + m_readPos);
+    m_readPos = 0;
+  }
+
+  LegacyPacket& operator>>(int8_t& val)
+  {
+    if (haveData(1))
+    {
+      val = *reinterpret_cast<const int8_t*>(&m_readBuffer[m_readPos]);
+      m_readPos += 1;
+    }
+    return *this;
+  }
+
+  LegacyPacket& operator>>(double& val)
+  {
+    if (haveData(8))
+    {
+      uint64_t ival = *reinterpret_cast<const uint64_t*>(&m_readBuffer[m_readPos]);
+      ival = ntohll(ival);
+      memcpy(&val, &ival, 8);
+      m_readPos += 8;
+    }
+    return *this;
+  }
+
+private:
+  std::vector<uint8_t> m_readBuffer;
+  size_t m_readPos;
+  bool m_isValid;
+};
+
+#endif
@@ -0,0 +1,141 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+// Cost of one block edit with the incremental light update in Map::setBlock,
+// compared against relighting the whole chunk after every edit.
+
+#include <cstring>
+
+#include "constants.h"
+#include "map.h"
+#include "tools.h"
+#include "bench.h"
+
+namespace
+{
+
+const int EDITS = 2000;
+const int GROUND = 64;
+
+// Flat stone up to GROUND, air above
+sChunk* makeChunk(int x, int z)
+{
+  sChunk* chunk = benchChunk(x, z);
+  for (int i = 0; i < 16 * 16 * 128; i++)
+  {
+    chunk->blocks[i] = ((i & 127) < GROUND) ? BLOCK_STONE : BLOCK_AIR;
+  }
+  return chunk;
+}
+
+// Same edit pattern for both runs: torches in a dug cave and digging
+// or refilling holes at the surface
+void edit(Map* map, int i, bool relightChunk)
+{
+  const int x = (i * 7) % 48 - 24;
+  const int z = (i * 13) % 48 - 24;
+  const bool cave = (i & 1) != 0;
+  const int y = cave ? GROUND - 20 : GROUND - 1;
+
+  uint8_t type, meta;
+  map->getBlock(x, y, z, &type, &meta, false);
+  uint8_t newType;
+  if (cave)
+  {
+    newType = (type == BLOCK_TORCH) ? BLOCK_AIR : BLOCK_TORCH;
+  }
+  else
+  {
+    newType = (type == BLOCK_AIR) ? BLOCK_STONE : BLOCK_AIR;
+  }
+  map->setBlock(x, y, z, newType, 0);
+
+  if (relightChunk)
+  {
+    map->generateLight(blockToChunk(x), blockToChunk(z), map->chunks.getChunk(blockToChunk(x), blockToChunk(z)));
+  }
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  Map* map = benchMap();
+
+  for (int x = -3; x <= 3; x++)
+  {
+    for (int z = -3; z <= 3; z++)
+    {
+      map->chunks.linkChunk(makeChunk(x, z), x, z);
+    }
+  }
+
+  // Dig an open cave layer under the whole area to place torches in
+  for (int x = -40; x < 40; x++)
+  {
+    for (int z = -40; z < 40; z++)
+    {
+      map->chunks.getChunk(blockToChunk(x), blockToChunk(z))->blocks[GROUND - 20 + (blockToChunkBlock(z) << 7) + (blockToChunkBlock(x) << 11)] = BLOCK_AIR;
+    }
+  }
+
+  for (int x = -3; x <= 3; x++)
+  {
+    for (int z = -3; z <= 3; z++)
+    {
+      map->generateLight(x, z, map->chunks.getChunk(x, z));
+    }
+  }
+
+  double start = benchNow();
+  for (int i = 0; i < EDITS; i++)
+  {
+    edit(map, i, false);
+  }
+  const double incremental = benchNow() - start;
+  benchReport("setBlock, incremental light", EDITS, incremental);
+
+  // Undo the edits so the second run starts from the same world
+  for (int i = EDITS - 1; i >= 0; i--)
+  {
+    edit(map, i, false);
+  }
+
+  start = benchNow();
+  for (int i = 0; i < EDITS; i++)
+  {
+    edit(map, i, true);
+  }
+  const double full = benchNow() - start;
+  benchReport("setBlock + full chunk relight", EDITS, full);
+
+  printf("per edit: incremental %.2f us, full relight %.2f us\n",
+         incremental * 1000000.0 / EDITS, full * 1000000.0 / EDITS);
+
+  return 0;
+}
@@ -0,0 +1,124 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+// A client flooding player position packets (0x0b, 34 bytes each), pushed
+// through the receive path of client_callback: the old one with a 2048 byte
+// heap buffer per recv() and an erase per parsed packet, against reading
+// straight into the Packet's buffer.
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "packets.h"
+#include "tools.h"
+#include "bench.h"
+#include "legacy_packet.h"
+
+namespace
+{
+
+const int PACKETS = 2000000;
+const int POSITION_LEN = 33;
+
+std::vector<uint8_t> makeFlood()
+{
+  Packet pkt;
+  for (int i = 0; i < PACKETS; i++)
+  {
+    pkt << (int8_t)PACKET_PLAYER_POSITION << (double)i << 64.0 << 65.62 << (double) - i << (int8_t)1;
+  }
+  const uint8_t* data = (const uint8_t*)pkt.getWrite();
+  return std::vector<uint8_t>(data, data + pkt.getWriteLen());
+}
+
+template <class P>
+long parse(P& buffer)
+{
+  long sum = 0;
+  int8_t action;
+  buffer.reset();
+  while (buffer >> action)
+  {
+    if (!buffer.haveData(POSITION_LEN))
+    {
+      break;
+    }
+    double x, y, stance, z;
+    int8_t onground;
+    buffer >> x >> y >> stance >> z >> onground;
+    buffer.removePacket();
+    sum += (long)x + onground;
+  }
+  return sum;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  const std::vector<uint8_t> flood = makeFlood();
+  long sum = 0;
+
+  double start = benchNow();
+  {
+    LegacyPacket buffer;
+    for (size_t pos = 0; pos < flood.size();)
+    {
+      uint8_t* buf = new uint8_t[2048];
+      size_t read = std::min((size_t)2048, flood.size() - pos);
+      memcpy(buf, &flood[pos], read);
+      pos += read;
+      buffer.addToRead(buf, read);
+      delete[] buf;
+      sum += parse(buffer);
+    }
+  }
+  benchReport("legacy recv + parse (packets)", PACKETS, benchNow() - start);
+
+  start = benchNow();
+  {
+    Packet buffer;
+    for (size_t pos = 0; pos < flood.size();)
+    {
+      uint8_t* buf = buffer.prepareRead(16384);
+      size_t read = std::min(buffer.readSpace(), flood.size() - pos);
+      memcpy(buf, &flood[pos], read);
+      pos += read;
+      buffer.commitRead(read);
+      sum += parse(buffer);
+    }
+  }
+  benchReport("Packet recv + parse (packets)", PACKETS, benchNow() - start);
+
+  benchSink += sum;
+
+  return 0;
+}
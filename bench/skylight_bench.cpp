@@ -0,0 +1,250 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+// Sky light + heightmap for whole chunks: the old per-voxel setLight loop of
+// Map::generateLight against the SkyLight kernels. Every kernel is checked
+// against SkyLight::scalar first.
+
+#include <cstdlib>
+#include <cstring>
+
+#include "constants.h"
+#include "map.h"
+#include "skylight.h"
+#include "bench.h"
+
+namespace
+{
+
+const int CHUNKS = 64;
+const int ROUNDS = 20;
+
+// Terrain-like columns: stone, some water, leaves and glass, air on top
+void makeBlocks(uint8_t* blocks)
+{
+  for (int x = 0; x < 16; x++)
+  {
+    for (int z = 0; z < 16; z++)
+    {
+      const int ground = 40 + rand() % 60;
+      for (int y = 0; y < 128; y++)
+      {
+        uint8_t block = BLOCK_AIR;
+        if (y < ground)
+        {
+          block = (rand() % 8 == 0) ? BLOCK_AIR : BLOCK_STONE;
+        }
+        else if (y < ground + 4 && rand() % 3 == 0)
+        {
+          const uint8_t top[] = { BLOCK_WATER, BLOCK_LEAVES, BLOCK_GLASS, BLOCK_TORCH };
+          block = top[rand() % 4];
+        }
+        blocks[y + (z << 7) + (x << 11)] = block;
+      }
+    }
+  }
+  // A few empty and full columns, and one with only its bottom block
+  memset(blocks + (3 << 7), BLOCK_AIR, 128);
+  memset(blocks + (5 << 7) + (7 << 11), BLOCK_STONE, 128);
+  memset(blocks + (9 << 7) + (2 << 11), BLOCK_AIR, 128);
+  blocks[(9 << 7) + (2 << 11)] = BLOCK_STONE;
+}
+
+// The sky pass Map::generateLight used to run, through setLight per voxel
+void legacySkyLight(Map* map, sChunk* chunk)
+{
+  memset(chunk->skylight, 0, 16 * 16 * 128 / 2);
+  for (int block_x = 0; block_x < 16; block_x++)
+  {
+    for (int block_z = 0; block_z < 16; block_z++)
+    {
+      int light = 15;
+      bool foundheight = false;
+      int32_t blockx_blockz = (block_z << 7) + (block_x << 11);
+
+      for (int block_y = 127; block_y > 0; block_y--)
+      {
+        uint8_t block = chunk->blocks[block_y + blockx_blockz];
+        light -= map->stopLight[block];
+        if (light < 0)
+        {
+          light = 0;
+        }
+        if ((block != BLOCK_AIR) && (foundheight == false))
+        {
+          chunk->heightmap[block_z + (block_x << 4)] = ((block_y == 127) ? block_y : block_y + 1);
+          foundheight = true;
+        }
+        if (light < 1)
+        {
+          break;
+        }
+        map->setLight(chunk->x * 16 + block_x, block_y, chunk->z * 16 + block_z, light, 0, 1, chunk);
+      }
+    }
+  }
+}
+
+uint8_t nibble(const uint8_t* light, int index)
+{
+  return (index & 1) ? (light[index >> 1] >> 4) : (light[index >> 1] & 0x0f);
+}
+
+// SkyLight::scalar against the old sky pass. On purpose they differ in
+// two places: the old loop stopped above y = 0, leaving it dark, and left
+// the heightmap alone when it found no block above y = 0.
+bool checkLegacy(Map* map, sChunk* chunk, uint8_t* const* blocks)
+{
+  uint8_t sky[16384], height[256];
+  long bottom = 0, columns = 0;
+  for (int c = 0; c < CHUNKS; c++)
+  {
+    chunk->blocks = blocks[c];
+    memset(chunk->heightmap, 0xff, 256);
+    legacySkyLight(map, chunk);
+    SkyLight::scalar(blocks[c], map->stopLight, sky, height);
+
+    for (int i = 0; i < 16 * 16 * 128; i++)
+    {
+      if (nibble(sky, i) == nibble(chunk->skylight, i))
+      {
+        continue;
+      }
+      if ((i & 127) != 0)
+      {
+        printf("scalar differs from the legacy sky pass on chunk %d\n", c);
+        return false;
+      }
+      bottom++;
+    }
+
+    for (int i = 0; i < 256; i++)
+    {
+      if (chunk->heightmap[i] == 0xff && height[i] <= 1)
+      {
+        columns++;
+      }
+      else if (chunk->heightmap[i] != height[i])
+      {
+        printf("scalar heightmap differs from the legacy sky pass on chunk %d\n", c);
+        return false;
+      }
+    }
+  }
+  printf("scalar matches the legacy sky pass, but for %ld lit y = 0 voxels and %ld columns without a block above y = 0\n",
+         bottom, columns);
+  return true;
+}
+
+bool check(const char* name, SkyLight::Kernel kernel, const int* stopLight, uint8_t* const* blocks)
+{
+  uint8_t skyRef[16384], skyTest[16384], heightRef[256], heightTest[256];
+  for (int c = 0; c < CHUNKS; c++)
+  {
+    memset(skyTest, 0xaa, sizeof(skyTest));
+    SkyLight::scalar(blocks[c], stopLight, skyRef, heightRef);
+    kernel(blocks[c], stopLight, skyTest, heightTest);
+    if (memcmp(skyRef, skyTest, sizeof(skyRef)) || memcmp(heightRef, heightTest, sizeof(heightRef)))
+    {
+      printf("%s differs from the scalar reference on chunk %d\n", name, c);
+      return false;
+    }
+  }
+  return true;
+}
+
+void run(const char* name, SkyLight::Kernel kernel, const int* stopLight, uint8_t* const* blocks, sChunk* chunk)
+{
+  double start = benchNow();
+  for (int r = 0; r < ROUNDS; r++)
+  {
+    for (int c = 0; c < CHUNKS; c++)
+    {
+      kernel(blocks[c], stopLight, chunk->skylight, chunk->heightmap);
+      benchSink += chunk->skylight[c];
+    }
+  }
+  benchReport(name, (long)ROUNDS * CHUNKS, benchNow() - start);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  Map* map = benchMap();
+
+  uint8_t* blocks[CHUNKS];
+  for (int c = 0; c < CHUNKS; c++)
+  {
+    blocks[c] = new uint8_t[16 * 16 * 128];
+    makeBlocks(blocks[c]);
+  }
+
+  sChunk* chunk = benchChunk(0, 0);
+  map->chunks.linkChunk(chunk, 0, 0);
+
+  bool ok = checkLegacy(map, chunk, blocks);
+#ifdef SKYLIGHT_SSE2
+  ok = check("sse2", SkyLight::sse2, map->stopLight, blocks) && ok;
+#endif
+#ifdef SKYLIGHT_AVX2
+  if (SkyLight::haveAVX2())
+  {
+    ok = check("avx2", SkyLight::avx2, map->stopLight, blocks) && ok;
+  }
+#endif
+  if (!ok)
+  {
+    return 1;
+  }
+
+  double start = benchNow();
+  for (int r = 0; r < ROUNDS; r++)
+  {
+    for (int c = 0; c < CHUNKS; c++)
+    {
+      chunk->blocks = blocks[c];
+      legacySkyLight(map, chunk);
+      benchSink += chunk->skylight[c];
+    }
+  }
+  benchReport("legacy setLight sky pass (chunks)", (long)ROUNDS * CHUNKS, benchNow() - start);
+
+  run("SkyLight::scalar (chunks)", SkyLight::scalar, map->stopLight, blocks, chunk);
+#ifdef SKYLIGHT_SSE2
+  run("SkyLight::sse2 (chunks)", SkyLight::sse2, map->stopLight, blocks, chunk);
+#endif
+#ifdef SKYLIGHT_AVX2
+  if (SkyLight::haveAVX2())
+  {
+    run("SkyLight::avx2 (chunks)", SkyLight::avx2, map->stopLight, blocks, chunk);
+  }
+#endif
+
+  return 0;
+}
@@ -0,0 +1,115 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ATOMIC_H
+#define _ATOMIC_H
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//
+// The few atomic operations shared between the main thread and the worker
+// threads, on top of the compiler builtins
+//
+
+// Both return the new value
+inline int atomicIncrement(volatile int* value)
+{
+#ifdef _MSC_VER
+  return _InterlockedIncrement((volatile long*)value);
+#else
+  return __atomic_add_fetch(value, 1, __ATOMIC_ACQ_REL);
+#endif
+}
+
+inline int atomicDecrement(volatile int* value)
+{
+#ifdef _MSC_VER
+  return _InterlockedDecrement((volatile long*)value);
+#else
+  return __atomic_sub_fetch(value, 1, __ATOMIC_ACQ_REL);
+#endif
+}
+
+// Returns the new value
+inline int atomicAdd(volatile int* value, int amount)
+{
+#ifdef _MSC_VER
+  return _InterlockedExchangeAdd((volatile long*)value, amount) + amount;
+#else
+  return __atomic_add_fetch(value, amount, __ATOMIC_ACQ_REL);
+#endif
+}
+
+inline int atomicLoad(const volatile int* value)
+{
+#ifdef _MSC_VER
+  // Volatile reads have acquire semantics with MSVC
+  int result = *value;
+  _ReadWriteBarrier();
+  return result;
+#else
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Returns the old value
+inline int atomicExchange(volatile int* value, int newValue)
+{
+#ifdef _MSC_VER
+  return _InterlockedExchange((volatile long*)value, newValue);
+#else
+  return __atomic_exchange_n(value, newValue, __ATOMIC_SEQ_CST);
+#endif
+}
+
+template <class T>
+inline T* atomicLoadAcquire(T* const volatile* ptr)
+{
+#ifdef _MSC_VER
+  // Volatile reads have acquire semantics with MSVC
+  T* value = *ptr;
+  _ReadWriteBarrier();
+  return value;
+#else
+  return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+template <class T>
+inline void atomicStoreRelease(T* volatile* ptr, T* value)
+{
+#ifdef _MSC_VER
+  _ReadWriteBarrier();
+  *ptr = value;
+#else
+  __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+#endif
@@ -0,0 +1,184 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _BLOCKSCHEDULE_H
+#define _BLOCKSCHEDULE_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "keytable.h"
+
+//
+// Blocks waiting for an update on a later tick. Each block is in it once:
+// a KeyTable maps the packed position to the tick it is due,
+// scheduling it again keeps the earlier of the two. A timing wheel of
+// WHEEL_SIZE slots, one per tick, lists what is due when; entries the table
+// no longer agrees with are skipped when their slot comes up. Blocks due
+// but over the budget of a tick are carried over to the front of the next.
+//
+class BlockSchedule
+{
+public:
+  // Delays have to be shorter than this
+  enum { WHEEL_SIZE = 64 };
+
+  BlockSchedule() : m_tick(0)
+  {
+  }
+
+  // x and z in 26 bits, y in 12
+  static uint64_t key(int x, int y, int z)
+  {
+    return ((uint64_t)(x & 0x3FFFFFF) << 38) | ((uint64_t)(z & 0x3FFFFFF) << 12) | (uint64_t)(y & 0xFFF);
+  }
+
+  static int keyX(uint64_t k)
+  {
+    return (int32_t)((uint32_t)(k >> 38) << 6) >> 6;
+  }
+
+  static int keyY(uint64_t k)
+  {
+    return (int)(k & 0xFFF);
+  }
+
+  static int keyZ(uint64_t k)
+  {
+    return (int32_t)((uint32_t)(k >> 12) << 6) >> 6;
+  }
+
+  // Blocks waiting, including the ones carried over
+  size_t size() const
+  {
+    return m_due.size();
+  }
+
+  size_t carried() const
+  {
+    return m_carry.size();
+  }
+
+  // The last tick handed out by takeDue()
+  uint32_t tick() const
+  {
+    return m_tick;
+  }
+
+  bool contains(uint64_t k) const
+  {
+    return m_due.find(k) != NULL;
+  }
+
+  // Due delay ticks after the current one. Returns false if it was already
+  // due by then.
+  bool schedule(uint64_t k, uint32_t delay)
+  {
+    if (delay < 1)
+    {
+      delay = 1;
+    }
+    if (delay >= WHEEL_SIZE)
+    {
+      delay = WHEEL_SIZE - 1;
+    }
+    const uint32_t due = m_tick + delay;
+
+    uint32_t* current = m_due.find(k);
+    if (current != NULL)
+    {
+      if ((int32_t)(*current - due) <= 0)
+      {
+        return false;
+      }
+      *current = due;
+    }
+    else
+    {
+      m_due.insert(k, due);
+    }
+
+    m_wheel[due & (WHEEL_SIZE - 1)].push_back(k);
+    return true;
+  }
+
+  // Returns false if it wasn't scheduled
+  bool cancel(uint64_t k)
+  {
+    return m_due.erase(k);
+  }
+
+  // Moves on a tick and hands out what is due, carried over blocks first,
+  // at most limit of them. They are no longer scheduled afterwards.
+  void takeDue(size_t limit, std::vector<uint64_t>& out)
+  {
+    m_tick++;
+
+    std::vector<uint64_t> carry;
+    carry.swap(m_carry);
+    take(carry, limit, out, true);
+
+    std::vector<uint64_t>& slot = m_wheel[m_tick & (WHEEL_SIZE - 1)];
+    take(slot, limit, out, false);
+    slot.clear();
+  }
+
+private:
+  void take(const std::vector<uint64_t>& keys, size_t limit, std::vector<uint64_t>& out, bool carried)
+  {
+    for (size_t n = 0; n < keys.size(); n++)
+    {
+      // Cancelled or due later since, and anything in the wheel that was
+      // due earlier is carried over already
+      const uint32_t* due = m_due.find(keys[n]);
+      if (due == NULL || (carried ? (int32_t)(*due - m_tick) > 0 : *due != m_tick))
+      {
+        continue;
+      }
+
+      if (out.size() < limit)
+      {
+        out.push_back(keys[n]);
+        m_due.erase(keys[n]);
+      }
+      else
+      {
+        m_carry.push_back(keys[n]);
+      }
+    }
+  }
+
+  KeyTable<uint32_t> m_due;
+  uint32_t m_tick;
+  std::vector<uint64_t> m_wheel[WHEEL_SIZE];
+  std::vector<uint64_t> m_carry;
+
+  BlockSchedule(const BlockSchedule&);
+  BlockSchedule& operator=(const BlockSchedule&);
+};
+
+#endif
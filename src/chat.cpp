@@ -28,6 +28,7 @@
 #include <ctime>
 #include <iostream>
 #include <fstream>
+#include <vector>
 
 #include "constants.h"
 #include "config.h"
@@ -37,6 +38,7 @@
 #include "permissions.h"
 #include "tools.h"
 #include "plugin.h"
+#include "profiler.h"
 
 #include "chat.h"
 
@@ -121,11 +123,11 @@ bool Chat::handleMsg(User* user, std::string msg)
   std::string timeStamp(asctime(Tm));
   timeStamp = timeStamp.substr(11, 5);
 
-  if ((static_cast<Hook3<bool, const char*, time_t, const char*>*>(Mineserver::get()->plugin()->getHook("PlayerChatPre")))->doUntilFalse(user->nick.c_str(), rawTime, msg.c_str()))
+  if ((static_cast<Hook3<bool, const char*, time_t, const char*>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_CHAT_PRE)))->doUntilFalse(user->nick.c_str(), rawTime, msg.c_str()))
   {
     return false;
   }
-  (static_cast<Hook3<bool, const char*, time_t, const char*>*>(Mineserver::get()->plugin()->getHook("PlayerChatPost")))->doAll(user->nick.c_str(), rawTime, msg.c_str());
+  (static_cast<Hook3<bool, const char*, time_t, const char*>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_CHAT_POST)))->doAll(user->nick.c_str(), rawTime, msg.c_str());
   char prefix = msg[0];
 
   switch (prefix)
@@ -184,9 +186,13 @@ void Chat::handleCommand(User* user, std::string msg, const std::string& timeSta
     msg = MC_COLOR_RED + "[!] " + MC_COLOR_GREEN + "You have been authed as admin!";
     sendMsg(user, msg, USER);
   }
+  else if (command == "perf" && (IS_ADMIN(user->permissions) || user->serverAdmin))
+  {
+    handlePerf(user, cmd);
+  }
   else
   {
-    (static_cast<Hook4<bool, const char*, const char*, int, const char**>*>(Mineserver::get()->plugin()->getHook("PlayerChatCommand")))->doAll(user->nick.c_str(), command.c_str(), cmd.size(), (const char**)param);
+    (static_cast<Hook4<bool, const char*, const char*, int, const char**>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_CHAT_COMMAND)))->doAll(user->nick.c_str(), command.c_str(), cmd.size(), (const char**)param);
   }
 
   delete [] param;
@@ -194,6 +200,42 @@ void Chat::handleCommand(User* user, std::string msg, const std::string& timeSta
 }
 
 
+void Chat::handlePerf(User* user, const std::deque<std::string>& args)
+{
+  Profiler* profiler = Mineserver::get()->profiler();
+  const std::string arg = args.empty() ? "" : args[0];
+
+  if (arg == "on" || arg == "off")
+  {
+    profiler->setEnabled(arg == "on");
+    profiler->reset();
+    sendMsg(user, MC_COLOR_RED + "[!] " + MC_COLOR_GREEN + "Profiling " + arg, USER);
+  }
+  else if (arg == "reset")
+  {
+    profiler->reset();
+    sendMsg(user, MC_COLOR_RED + "[!] " + MC_COLOR_GREEN + "Profile cleared", USER);
+  }
+  else if (!profiler->enabled())
+  {
+    sendMsg(user, MC_COLOR_RED + "[!] " + MC_COLOR_GREEN + "Profiling is off, /perf on starts it", USER);
+  }
+  else
+  {
+    // The probes that took the most time
+    std::vector<std::string> lines;
+    profiler->report(lines, 8);
+    if (lines.empty())
+    {
+      lines.push_back("Nothing recorded yet");
+    }
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+      sendMsg(user, MC_COLOR_GREEN + lines[i], USER);
+    }
+  }
+}
+
 void Chat::handleServerMsg(User* user, std::string msg, const std::string& timeStamp)
 {
   // Decorate server message
@@ -59,6 +59,8 @@ public:
   void sendHelp(User* user, std::deque<std::string> args);
 
   void handleCommand(User* user, std::string msg, const std::string& timeStamp);
+  // /perf [on|off|reset], the profiler for admins
+  void handlePerf(User* user, const std::deque<std::string>& args);
 
 private:
   std::deque<std::string> parseCmd(std::string cmd);
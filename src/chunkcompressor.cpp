@@ -0,0 +1,140 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <zlib.h>
+
+#include "chunkcompressor.h"
+#include "profiler.h"
+
+ChunkCompressor::ChunkCompressor() : m_stopping(false)
+{
+}
+
+ChunkCompressor::~ChunkCompressor()
+{
+  shutdown();
+}
+
+bool ChunkCompressor::init(int threads)
+{
+  for (int i = 0; i < threads; i++)
+  {
+    Thread* thread = new Thread;
+    if (!thread->start(&ChunkCompressor::worker, this))
+    {
+      delete thread;
+      return false;
+    }
+    m_workers.push_back(thread);
+  }
+
+  return true;
+}
+
+void ChunkCompressor::shutdown()
+{
+  {
+    MutexLock lock(m_mutex);
+    m_stopping = true;
+    m_wakeup.broadcast();
+  }
+
+  for (std::vector<Thread*>::size_type i = 0; i < m_workers.size(); i++)
+  {
+    m_workers[i]->join();
+    delete m_workers[i];
+  }
+  m_workers.clear();
+
+  // Nobody is waiting for these anymore
+  for (std::deque<Job*>::size_type i = 0; i < m_queue.size(); i++)
+  {
+    delete m_queue[i];
+  }
+  m_queue.clear();
+
+  for (std::vector<Job*>::size_type i = 0; i < m_done.size(); i++)
+  {
+    delete m_done[i];
+  }
+  m_done.clear();
+}
+
+void ChunkCompressor::submit(Job* job)
+{
+  MutexLock lock(m_mutex);
+  m_queue.push_back(job);
+  m_wakeup.signal();
+}
+
+void ChunkCompressor::collect(std::vector<Job*>& done)
+{
+  MutexLock lock(m_mutex);
+  done.insert(done.end(), m_done.begin(), m_done.end());
+  m_done.clear();
+}
+
+void ChunkCompressor::deflate(const uint8_t* raw, std::vector<uint8_t>& out)
+{
+  uLongf written = compressBound(Job::RAW_SIZE);
+  out.resize(written);
+
+  // Compress data with zlib deflate
+  compress(&out[0], &written, raw, Job::RAW_SIZE);
+
+  out.resize(written);
+}
+
+void ChunkCompressor::worker(void* arg)
+{
+  ChunkCompressor* self = static_cast<ChunkCompressor*>(arg);
+
+  for (;;)
+  {
+    Job* job;
+    {
+      MutexLock lock(self->m_mutex);
+      while (!self->m_stopping && self->m_queue.empty())
+      {
+        self->m_wakeup.wait(self->m_mutex);
+      }
+      if (self->m_stopping)
+      {
+        return;
+      }
+      job = self->m_queue.front();
+      self->m_queue.pop_front();
+    }
+
+    const uint64_t start = Profiler::now();
+    deflate(job->raw, job->compressed);
+    job->micros = (uint32_t)(Profiler::now() - start);
+
+    MutexLock lock(self->m_mutex);
+    self->m_done.push_back(job);
+  }
+}
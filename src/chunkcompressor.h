@@ -0,0 +1,98 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _CHUNKCOMPRESSOR_H
+#define _CHUNKCOMPRESSOR_H
+
+#include <deque>
+#include <vector>
+
+#include <stdint.h>
+
+#include "threads.h"
+
+struct ChunkCompressJob
+{
+  // Uncompressed size of a full 16x128x16 chunk payload
+  enum { RAW_SIZE = 32768 + 16384 + 16384 + 16384 };
+
+  int map;
+  int x;
+  int z;
+  uint32_t version;
+
+  uint8_t raw[RAW_SIZE];
+  std::vector<uint8_t> compressed;
+  // How long the worker took, in microseconds
+  uint32_t micros;
+};
+
+//
+// Fixed size worker pool that deflates MAP_CHUNK payloads off the main thread.
+// The main thread hands over a snapshot of the chunk arrays and picks the
+// finished payloads up again with collect() on a later loop iteration.
+//
+class ChunkCompressor
+{
+public:
+  typedef ChunkCompressJob Job;
+
+  ChunkCompressor();
+  ~ChunkCompressor();
+
+  // Start the workers, 0 threads keeps compression on the main thread
+  bool init(int threads);
+  void shutdown();
+
+  bool enabled() const
+  {
+    return !m_workers.empty();
+  }
+
+  // Takes ownership of the job
+  void submit(Job* job);
+
+  // Moves all finished jobs to done, caller deletes them
+  void collect(std::vector<Job*>& done);
+
+  static void deflate(const uint8_t* raw, std::vector<uint8_t>& out);
+
+private:
+  static void worker(void* arg);
+
+  Mutex m_mutex;
+  Condition m_wakeup;
+  bool m_stopping;
+  std::deque<Job*> m_queue;
+  std::vector<Job*> m_done;
+  std::vector<Thread*> m_workers;
+
+  ChunkCompressor(const ChunkCompressor&);
+  ChunkCompressor& operator=(const ChunkCompressor&);
+};
+
+#endif
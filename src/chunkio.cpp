@@ -0,0 +1,146 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "nbt.h"
+#include "chunkstorage.h"
+#include "profiler.h"
+#include "chunkio.h"
+
+ChunkIO::ChunkIO() : m_stopping(false), m_running(false), m_busy(false)
+{
+}
+
+ChunkIO::~ChunkIO()
+{
+  shutdown();
+
+  for (std::vector<Job*>::size_type i = 0; i < m_done.size(); i++)
+  {
+    delete m_done[i]->nbt;
+    delete m_done[i];
+  }
+  m_done.clear();
+}
+
+bool ChunkIO::init()
+{
+  m_stopping = false;
+  m_running  = m_thread.start(&ChunkIO::worker, this);
+  return m_running;
+}
+
+void ChunkIO::shutdown()
+{
+  if (!m_running)
+  {
+    return;
+  }
+
+  {
+    MutexLock lock(m_mutex);
+    m_stopping = true;
+    m_wakeup.broadcast();
+  }
+
+  m_thread.join();
+  m_running = false;
+}
+
+void ChunkIO::submit(Job* job)
+{
+  MutexLock lock(m_mutex);
+  m_queue.push_back(job);
+  m_wakeup.signal();
+}
+
+void ChunkIO::collect(std::vector<Job*>& done)
+{
+  MutexLock lock(m_mutex);
+  done.insert(done.end(), m_done.begin(), m_done.end());
+  m_done.clear();
+}
+
+void ChunkIO::waitIdle()
+{
+  MutexLock lock(m_mutex);
+  while (m_running && (m_busy || !m_queue.empty()))
+  {
+    m_idle.wait(m_mutex);
+  }
+}
+
+void ChunkIO::run(Job* job)
+{
+  const uint64_t start = Profiler::now();
+  if (job->type == Job::LOAD)
+  {
+    std::vector<uint8_t> buffer;
+    if (job->storage->load(job->x, job->z, buffer, job->missing))
+    {
+      job->nbt = NBT_Value::LoadFromMemory(buffer);
+    }
+    job->ok = (job->nbt != NULL);
+  }
+  else
+  {
+    job->ok = job->storage->save(job->x, job->z, job->data);
+  }
+  job->micros = (uint32_t)(Profiler::now() - start);
+}
+
+void ChunkIO::worker(void* arg)
+{
+  ChunkIO* self = static_cast<ChunkIO*>(arg);
+
+  for (;;)
+  {
+    Job* job;
+    {
+      MutexLock lock(self->m_mutex);
+      self->m_busy = false;
+      while (!self->m_stopping && self->m_queue.empty())
+      {
+        self->m_idle.broadcast();
+        self->m_wakeup.wait(self->m_mutex);
+      }
+      // Pending saves still have to reach the disk
+      if (self->m_queue.empty())
+      {
+        self->m_idle.broadcast();
+        return;
+      }
+      job = self->m_queue.front();
+      self->m_queue.pop_front();
+      self->m_busy = true;
+    }
+
+    run(job);
+
+    MutexLock lock(self->m_mutex);
+    self->m_done.push_back(job);
+  }
+}
@@ -0,0 +1,116 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _CHUNKIO_H
+#define _CHUNKIO_H
+
+#include <deque>
+#include <vector>
+
+#include <stdint.h>
+
+#include "threads.h"
+
+class NBT_Value;
+class ChunkStorage;
+
+struct ChunkIOJob
+{
+  enum Type { LOAD, SAVE };
+
+  Type type;
+  int map;
+  int x;
+  int z;
+
+  ChunkStorage* storage;
+  // Uncompressed NBT to write
+  std::vector<uint8_t> data;
+
+  // Results
+  NBT_Value* nbt;
+  bool missing;
+  bool ok;
+  // How long run() took, in microseconds
+  uint32_t micros;
+
+  ChunkIOJob() : type(LOAD), map(0), x(0), z(0), storage(NULL), nbt(NULL), missing(false), ok(false), micros(0)
+  {
+  }
+};
+
+//
+// Single background thread doing chunk file reads and writes in order.
+// Finished jobs are picked up by the main loop with collect().
+//
+class ChunkIO
+{
+public:
+  typedef ChunkIOJob Job;
+
+  ChunkIO();
+  ~ChunkIO();
+
+  bool init();
+  // Finishes all queued jobs before stopping the thread
+  void shutdown();
+
+  bool enabled() const
+  {
+    return m_running;
+  }
+
+  // Takes ownership of the job
+  void submit(Job* job);
+
+  // Moves all finished jobs to done, caller deletes them
+  void collect(std::vector<Job*>& done);
+
+  // Block until every submitted job has been run
+  void waitIdle();
+
+  // The actual work, also used directly when running synchronously
+  static void run(Job* job);
+
+private:
+  static void worker(void* arg);
+
+  Mutex m_mutex;
+  Condition m_wakeup;
+  Condition m_idle;
+  bool m_stopping;
+  bool m_running;
+  bool m_busy;
+  std::deque<Job*> m_queue;
+  std::vector<Job*> m_done;
+  Thread m_thread;
+
+  ChunkIO(const ChunkIO&);
+  ChunkIO& operator=(const ChunkIO&);
+};
+
+#endif
@@ -37,6 +37,7 @@
 #include "packets.h"
 #include "user.h"
 #include "nbt.h"
+#include "keytable.h"
 
 class NBT_Value;
 
@@ -88,6 +89,15 @@ struct furnaceData
 };
 void removeFurnace(furnaceData* data_);
 
+// A block change waiting to be sent, offset is x << 12 | z << 8 | y
+// within the chunk like in PACKET_MULTI_BLOCK_CHANGE
+struct sBlockChange
+{
+  uint16_t offset;
+  int8_t type;
+  int8_t meta;
+};
+
 struct sChunk
 {
   uint8_t* blocks;
@@ -103,6 +113,16 @@ struct sChunk
   bool changed;
   time_t lastused;
 
+  // Bumped on every block or light change
+  uint32_t version;
+
+  // Deflated MAP_CHUNK payload, valid while compressedVersion == version
+  std::vector<uint8_t> compressed;
+  uint32_t compressedVersion;
+
+  // Sent and cleared by Map::flushBlockChanges()
+  std::vector<sBlockChange> blockChanges;
+
   NBT_Value* nbt;
   std::set<User*>           users;
   std::vector<spawnedItem*> items;
@@ -112,7 +132,7 @@ struct sChunk
   std::vector<signData*>    signs;
   std::vector<furnaceData*> furnaces;
 
-  sChunk() : refCount(0), lightRegen(false), changed(false), lastused(0), nbt(NULL)
+  sChunk() : refCount(0), lightRegen(false), changed(false), lastused(0), version(0), compressedVersion(0), nbt(NULL)
   {
   }
 
@@ -163,6 +183,12 @@ struct sChunk
 
   void sendPacket(const Packet& packet, User* nosend = NULL)
   {
+    if (packet.getWriteLen() == 0)
+    {
+      return;
+    }
+
+    SharedBuffer* shared = SharedBuffer::create(packet.getWrite(), packet.getWriteLen());
     std::set<User*>::iterator iter_a = users.begin(), iter_b = users.end();
 
     for (; iter_a != iter_b; ++iter_a)
@@ -171,212 +197,153 @@ struct sChunk
       {
         if ((*iter_a)->logged)
         {
-          (*iter_a)->buffer.addToWrite(packet.getWrite(), packet.getWriteLen());
+          (*iter_a)->buffer.addToWrite(shared);
         }
       }
     }
-
-  }
-
-  static bool userBoundary(sChunk* left, std::list<User*> &lusers, sChunk* right, std::list<User*> &rusers)
-  {
-    bool diff = false;
-
-    std::set<User*>::iterator iter_a;
-    std::set<User*>::iterator iter_b;
-
-    iter_a = left->users.begin(), iter_b = left->users.end();
-    for (; iter_a != iter_b; ++iter_a)
-    {
-      if (!right->users.count(*iter_a))
-      {
-        lusers.push_front(*iter_a);
-        diff = true;
-      }
-    }
-
-    iter_a = right->users.begin(), iter_b = right->users.end();
-    for (; iter_a != iter_b; ++iter_a)
-    {
-      if (!left->users.count(*iter_a))
-      {
-        rusers.push_front(*iter_a);
-        diff = true;
-      }
-    }
-
-    return diff;
+    shared->release();
   }
 };
 
-struct sChunkNode
+class ChunkMap
 {
-  sChunkNode(sChunk* _chunk, sChunkNode* _prev, sChunkNode* _next) : chunk(_chunk), prev(_prev), next(_next) {}
+public:
+  // Chunks are kept in a dense vector for iteration, the key table holds
+  // indices into it
+  ChunkMap() : m_lastKey(0), m_lastChunk(NULL)
+  {
+  }
 
-  ~sChunkNode()
+  ~ChunkMap()
   {
-    if (chunk != NULL)
+    std::vector<sChunk*>::iterator it = m_chunks.begin();
+    for (; it != m_chunks.end(); ++it)
     {
-      delete chunk;
-      chunk = NULL;
+      delete *it;
     }
+    m_chunks.clear();
+    m_keys.clear();
   }
 
-  sChunk* chunk;
-  sChunkNode* prev;
-  sChunkNode* next;
-};
+  static uint64_t key(int x, int z)
+  {
+    return ((uint64_t)(uint32_t)x << 32) | (uint64_t)(uint32_t)z;
+  }
 
-class ChunkMap
-{
-public:
-  ChunkMap()
+  int numChunks() const
   {
-    memset(m_buckets, 0, sizeof(m_buckets));
+    return (int)m_chunks.size();
   }
 
-  ~ChunkMap()
+  // All linked chunks, contiguous. Take a copy before iterating if the loop
+  // may unlink chunks.
+  const std::vector<sChunk*>& getChunks() const
   {
-    for (int i = 0; i < 441; ++i)
-    {
-      sChunkNode* node = m_buckets[i];
-      sChunkNode* next = NULL;
-      if (node != NULL)
-      {
-        next = node->next;
-        delete node;
-        node = next;
-      }
-      m_buckets[i] = NULL;
-    }
+    return m_chunks;
   }
 
-  int hash(int x, int z)
+  sChunk* getChunk(int x, int z) const
   {
-    x %= 21;
-    if (x < 0)
+    const uint64_t k = key(x, z);
+
+    // Block loops tend to stay inside one chunk
+    if (m_lastChunk != NULL && m_lastKey == k)
     {
-      x += 21;
+      return m_lastChunk;
     }
 
-    z %= 21;
-    if (z < 0)
+    const int32_t* index = m_table.find(k);
+    if (index == NULL)
     {
-      z += 21;
+      return NULL;
     }
 
-    return x + z * 21;
+    m_lastKey   = k;
+    m_lastChunk = m_chunks[*index];
+    return m_lastChunk;
   }
 
-  int numChunks()
+  void unlinkChunk(int x, int z)
   {
-    int num = 0;
+    const uint64_t k = key(x, z);
 
-    for (int i = 0; i < 441; ++i)
-      for (sChunkNode* node = m_buckets[i]; node != NULL; node = node->next)
-      {
-        num++;
-      }
+    const int32_t* found = m_table.find(k);
+    if (found == NULL)
+    {
+      return;
+    }
 
-    return num;
-  }
+    const int32_t index = *found;
+    sChunk* chunk = m_chunks[index];
 
-  sChunk* getChunk(int x, int z)
-  {
-    sChunkNode* node = NULL;
+    if (m_lastChunk == chunk)
+    {
+      m_lastChunk = NULL;
+    }
 
-    for (node = m_buckets[hash(x, z)]; node != NULL; node = node->next)
+    // Move the last chunk into the hole left in the dense array
+    const int32_t last = (int32_t)m_chunks.size() - 1;
+    if (index != last)
     {
-      if ((node->chunk->x == x) && (node->chunk->z == z))
-      {
-        return node->chunk;
-      }
+      m_chunks[index] = m_chunks[last];
+      m_keys[index]   = m_keys[last];
+      *m_table.find(m_keys[index]) = index;
     }
+    m_chunks.pop_back();
+    m_keys.pop_back();
+    m_table.erase(k);
 
-    return NULL;
+    chunk->refCount--;
+    if (chunk->refCount == 0)
+    {
+      delete chunk;
+    }
   }
 
-  void unlinkChunk(int x, int z)
+  void linkChunk(sChunk* chunk, int x, int z)
   {
-    int _hash = hash(x, z);
-
-    sChunkNode* root = m_buckets[_hash];
-    sChunkNode* node = root;
+    const uint64_t k = key(x, z);
 
-    // Loop until we reach the end of the chain
-    while (node != NULL)
+    int32_t* index = m_table.find(k);
+    if (index != NULL)
     {
-      // We've got the right node, time to get to work!
-      if ((node->chunk->x == x) && (node->chunk->z == z))
+      // Replace whatever was linked here before
+      sChunk* old = m_chunks[*index];
+      if (old == chunk)
       {
-        node->chunk->refCount--;
-
-        if (node->chunk->refCount == 0)
-        {
-          delete node->chunk;
-          node->chunk = NULL;
-        }
-
-        // If we have both next and previous nodes, we need to connect them up
-        // when we remove this node because we're in the middle of the chain.
-        if (node->next != NULL && node->prev != NULL)
-        {
-          node->next->prev = node->prev;
-          node->prev->next = node->next;
-        }
-        // Otherwise we're at one of the ends of the chain, so we just need to
-        // cut it off where it is.
-        else if (node->next != NULL)
-        {
-          node->next->prev = NULL;
-        }
-        else if (node->prev != NULL)
-        {
-          node->prev->next = NULL;
-        }
-
-        // If the node we're looking at is the root node, we need to update the
-        // bucket to point at the new start of the chain.
-        if (node == root)
-        {
-          m_buckets[_hash] = node->next;
-        }
-
-        // Free up the memory we were using for this node.
-        delete node;
-        node = NULL;
-
         return;
       }
-      // This isn't the right node, look at the next one.
-      else
+      chunk->refCount++;
+      m_chunks[*index] = chunk;
+      if (m_lastChunk == old)
+      {
+        m_lastChunk = NULL;
+      }
+      if (--old->refCount == 0)
       {
-        node = node->next;
+        delete old;
       }
+      return;
     }
-  }
-
-  void linkChunk(sChunk* chunk, int x, int z)
-  {
-    int _hash = hash(x, z);
 
     chunk->refCount++;
-
-    m_buckets[_hash] = new sChunkNode(chunk, NULL, m_buckets[_hash]);
-
-    if (m_buckets[_hash]->next != NULL)
-    {
-      m_buckets[_hash]->next->prev = m_buckets[_hash];
-    }
+    m_table.insert(k, (int32_t)m_chunks.size());
+    m_chunks.push_back(chunk);
+    m_keys.push_back(k);
   }
 
-  sChunkNode** getBuckets()
-  {
-    return m_buckets;
-  }
+private:
+  KeyTable<int32_t> m_table;
+  std::vector<sChunk*> m_chunks;
+  std::vector<uint64_t> m_keys;
+
+  // Last chunk handed out by getChunk()
+  mutable uint64_t m_lastKey;
+  mutable sChunk* m_lastChunk;
 
-  //private:
-  sChunkNode* m_buckets[441];
+  // Owns its chunks, a copy would free them twice
+  ChunkMap(const ChunkMap&);
+  ChunkMap& operator=(const ChunkMap&);
 };
 
 #endif
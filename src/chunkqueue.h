@@ -0,0 +1,198 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _CHUNKQUEUE_H
+#define _CHUNKQUEUE_H
+
+#include <algorithm>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+
+#include "chunkset.h"
+
+//
+// Chunks waiting to be sent to a player, handed out nearest first. Chunks
+// behind the player count as twice as far, so what it's looking at
+// arrives first. A min-heap keyed on that distance gives pop() in O(log n);
+// it is rebuilt when the player gets to another chunk or turns to another
+// eighth of the compass. erase() only drops the chunk from the set, the
+// heap entry is skipped when it comes up.
+//
+class ChunkQueue
+{
+public:
+  ChunkQueue() : m_x(0), m_z(0), m_sector(0), m_dirX(0), m_dirZ(1)
+  {
+  }
+
+  size_t size() const
+  {
+    return m_chunks.size();
+  }
+
+  bool empty() const
+  {
+    return m_chunks.empty();
+  }
+
+  bool contains(int x, int z) const
+  {
+    return m_chunks.contains(x, z);
+  }
+
+  // In no particular order
+  const std::vector<uint64_t>& keys() const
+  {
+    return m_chunks.keys();
+  }
+
+  // Returns false if it was already queued
+  bool insert(int x, int z)
+  {
+    if (!m_chunks.insert(x, z))
+    {
+      return false;
+    }
+
+    // Erased and re-queued chunks leave stale entries, drop them before
+    // they outnumber the queued ones
+    if (m_heap.size() > m_chunks.size() * 2 + 64)
+    {
+      rebuild();
+    }
+    else
+    {
+      Entry entry = { priority(ChunkSet::key(x, z)), ChunkSet::key(x, z) };
+      m_heap.push_back(entry);
+      std::push_heap(m_heap.begin(), m_heap.end(), Later());
+    }
+    return true;
+  }
+
+  bool erase(int x, int z)
+  {
+    return m_chunks.erase(x, z);
+  }
+
+  // Player position in chunks and its yaw, reorders when either moved
+  // far enough to matter
+  void setCenter(int x, int z, float yaw)
+  {
+    int sector = (int)floor(yaw / 45.0f + 0.5f) % 8;
+    if (sector < 0)
+    {
+      sector += 8;
+    }
+
+    if (x == m_x && z == m_z && sector == m_sector)
+    {
+      return;
+    }
+
+    m_x = x;
+    m_z = z;
+    m_sector = sector;
+    // Yaw 0 faces +z, 90 faces -x
+    const double angle = sector * 45.0 * 3.14159265358979 / 180.0;
+    m_dirX = -sin(angle);
+    m_dirZ = cos(angle);
+    rebuild();
+  }
+
+  // Takes the chunk to send next, false when the queue is empty
+  bool pop(int& x, int& z)
+  {
+    while (!m_heap.empty())
+    {
+      const uint64_t k = m_heap.front().key;
+      std::pop_heap(m_heap.begin(), m_heap.end(), Later());
+      m_heap.pop_back();
+
+      x = ChunkSet::keyX(k);
+      z = ChunkSet::keyZ(k);
+      if (m_chunks.erase(x, z))
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  struct Entry
+  {
+    int priority;
+    uint64_t key;
+  };
+
+  // Heap order, the smallest priority on top
+  struct Later
+  {
+    bool operator()(const Entry& a, const Entry& b) const
+    {
+      return a.priority > b.priority;
+    }
+  };
+
+  int priority(uint64_t k) const
+  {
+    const int dx = ChunkSet::keyX(k) - m_x;
+    const int dz = ChunkSet::keyZ(k) - m_z;
+    const int d2 = dx * dx + dz * dz;
+
+    // The chunks around the player are needed whichever way it looks
+    if (d2 > 2 && dx * m_dirX + dz * m_dirZ < 0)
+    {
+      return d2 * 2;
+    }
+    return d2;
+  }
+
+  void rebuild()
+  {
+    const std::vector<uint64_t>& keys = m_chunks.keys();
+    m_heap.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+      m_heap[i].priority = priority(keys[i]);
+      m_heap[i].key      = keys[i];
+    }
+    std::make_heap(m_heap.begin(), m_heap.end(), Later());
+  }
+
+  ChunkSet m_chunks;
+  std::vector<Entry> m_heap;
+
+  int m_x;
+  int m_z;
+  int m_sector;
+  double m_dirX;
+  double m_dirZ;
+};
+
+#endif
@@ -0,0 +1,150 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _CHUNKSET_H
+#define _CHUNKSET_H
+
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+
+#include "keytable.h"
+
+//
+// Set of chunk coordinates with constant time insert, erase and lookup.
+// Like ChunkMap the coordinates are kept in a dense vector for iteration
+// and a KeyTable holds indices into it. Erasing moves the last coordinate
+// into the hole, so the order is only kept by sort().
+//
+class ChunkSet
+{
+public:
+  static uint64_t key(int x, int z)
+  {
+    return ((uint64_t)(uint32_t)x << 32) | (uint64_t)(uint32_t)z;
+  }
+
+  static int keyX(uint64_t k)
+  {
+    return (int32_t)(uint32_t)(k >> 32);
+  }
+
+  static int keyZ(uint64_t k)
+  {
+    return (int32_t)(uint32_t)k;
+  }
+
+  size_t size() const
+  {
+    return m_keys.size();
+  }
+
+  bool empty() const
+  {
+    return m_keys.empty();
+  }
+
+  int x(size_t i) const
+  {
+    return keyX(m_keys[i]);
+  }
+
+  int z(size_t i) const
+  {
+    return keyZ(m_keys[i]);
+  }
+
+  const std::vector<uint64_t>& keys() const
+  {
+    return m_keys;
+  }
+
+  bool contains(int x, int z) const
+  {
+    return m_table.find(key(x, z)) != NULL;
+  }
+
+  // Returns false if it was already in the set
+  bool insert(int x, int z)
+  {
+    const uint64_t k = key(x, z);
+    if (!m_table.insert(k, (int32_t)m_keys.size()))
+    {
+      return false;
+    }
+    m_keys.push_back(k);
+    return true;
+  }
+
+  // Returns false if it was not in the set
+  bool erase(int x, int z)
+  {
+    const uint64_t k = key(x, z);
+
+    const int32_t* found = m_table.find(k);
+    if (found == NULL)
+    {
+      return false;
+    }
+
+    // Move the last coordinate into the hole left in the dense array
+    const int32_t index = *found;
+    const int32_t last  = (int32_t)m_keys.size() - 1;
+    if (index != last)
+    {
+      m_keys[index] = m_keys[last];
+      *m_table.find(m_keys[index]) = index;
+    }
+    m_keys.pop_back();
+    m_table.erase(k);
+
+    return true;
+  }
+
+  void clear()
+  {
+    m_keys.clear();
+    m_table.clear();
+  }
+
+  // Order the dense vector, compare gets two keys
+  template <class Compare>
+  void sort(Compare compare)
+  {
+    std::sort(m_keys.begin(), m_keys.end(), compare);
+    for (size_t n = 0; n < m_keys.size(); ++n)
+    {
+      *m_table.find(m_keys[n]) = (int32_t)n;
+    }
+  }
+
+private:
+  KeyTable<int32_t> m_table;
+  std::vector<uint64_t> m_keys;
+};
+
+#endif
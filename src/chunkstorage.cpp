@@ -0,0 +1,714 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef WIN32
+#include <direct.h>
+#else
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+
+#include <zlib.h>
+
+#include "tools.h"
+#include "chunkstorage.h"
+
+namespace
+{
+
+bool isDirectory(const std::string& path)
+{
+  struct stat stFileInfo;
+  return stat(path.c_str(), &stFileInfo) == 0 && (stFileInfo.st_mode & S_IFDIR);
+}
+
+bool makeDirectory(const std::string& path)
+{
+  if (isDirectory(path))
+  {
+    return true;
+  }
+#ifdef WIN32
+  return _mkdir(path.c_str()) != -1;
+#else
+  return mkdir(path.c_str(), 0755) != -1;
+#endif
+}
+
+bool listDirectory(const std::string& path, std::vector<std::string>& entries)
+{
+#ifdef WIN32
+  WIN32_FIND_DATAA data;
+  HANDLE find = FindFirstFileA((path + "\\*").c_str(), &data);
+  if (find == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+  do
+  {
+    std::string name(data.cFileName);
+    if (name != "." && name != "..")
+    {
+      entries.push_back(name);
+    }
+  }
+  while (FindNextFileA(find, &data));
+  FindClose(find);
+#else
+  DIR* dir = opendir(path.c_str());
+  if (dir == NULL)
+  {
+    return false;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL)
+  {
+    std::string name(entry->d_name);
+    if (name != "." && name != "..")
+    {
+      entries.push_back(name);
+    }
+  }
+  closedir(dir);
+#endif
+  return true;
+}
+
+// Parses "<prefix><x>.<z><suffix>" with coordinates in the given base
+bool parseCoords(const std::string& name, const std::string& prefix, const std::string& suffix, int base, int& x, int& z)
+{
+  if (name.size() <= prefix.size() + suffix.size() ||
+      name.compare(0, prefix.size(), prefix) != 0 ||
+      name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+  {
+    return false;
+  }
+
+  std::string coords = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+  std::string::size_type dot = coords.find('.');
+  if (dot == std::string::npos)
+  {
+    return false;
+  }
+
+  std::string xs = coords.substr(0, dot);
+  std::string zs = coords.substr(dot + 1);
+  char* end;
+  x = (int)strtol(xs.c_str(), &end, base);
+  if (xs.empty() || *end != '\0')
+  {
+    return false;
+  }
+  z = (int)strtol(zs.c_str(), &end, base);
+  if (zs.empty() || *end != '\0')
+  {
+    return false;
+  }
+
+  return true;
+}
+
+uint32_t getBE32(const uint8_t* buf)
+{
+  return ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) | ((uint32_t)buf[2] << 8) | (uint32_t)buf[3];
+}
+
+void putBE32(uint8_t* buf, uint32_t value)
+{
+  buf[0] = (uint8_t)(value >> 24);
+  buf[1] = (uint8_t)(value >> 16);
+  buf[2] = (uint8_t)(value >> 8);
+  buf[3] = (uint8_t)value;
+}
+
+}
+
+ChunkStorage* ChunkStorage::create(const std::string& format, const std::string& directory)
+{
+  if (format == "nbt")
+  {
+    return new NBTFileStorage(directory);
+  }
+  if (format == "region")
+  {
+    return new RegionStorage(directory);
+  }
+  return NULL;
+}
+
+//
+// NBTFileStorage
+//
+
+NBTFileStorage::NBTFileStorage(const std::string& directory) : m_directory(directory)
+{
+}
+
+bool NBTFileStorage::load(int x, int z, std::vector<uint8_t>& data, bool& missing)
+{
+  MutexLock lock(m_mutex);
+
+  std::string infile = m_directory + "/" + base36_encode(x & 0x3F) + "/" + base36_encode(z & 0x3F) + "/c." +
+                       base36_encode(x) + "." + base36_encode(z) + ".dat";
+
+  struct stat stFileInfo;
+  if (stat(infile.c_str(), &stFileInfo) != 0)
+  {
+    // Anything but a missing file is a failed load, not a chunk to generate
+    missing = (errno == ENOENT || errno == ENOTDIR);
+    return false;
+  }
+
+  missing = false;
+  return readGzipFile(infile, data);
+}
+
+bool NBTFileStorage::save(int x, int z, const std::vector<uint8_t>& data)
+{
+  MutexLock lock(m_mutex);
+
+  if (data.empty())
+  {
+    return false;
+  }
+
+  std::string outdir_a = m_directory + "/" + base36_encode(x & 0x3F);
+  std::string outdir_b = outdir_a + "/" + base36_encode(z & 0x3F);
+  std::string outfile  = outdir_b + "/c." + base36_encode(x) + "." + base36_encode(z) + ".dat";
+
+  // Try to create parent directories if necessary
+  struct stat stFileInfo;
+  if (stat(outfile.c_str(), &stFileInfo) != 0)
+  {
+    if (!makeDirectory(outdir_a) || !makeDirectory(outdir_b))
+    {
+      return false;
+    }
+  }
+
+  return writeGzipFile(outfile, data);
+}
+
+bool NBTFileStorage::list(std::vector<std::pair<int, int> >& chunks)
+{
+  MutexLock lock(m_mutex);
+
+  std::vector<std::string> level_a;
+  if (!listDirectory(m_directory, level_a))
+  {
+    return false;
+  }
+
+  for (std::vector<std::string>::size_type a = 0; a < level_a.size(); a++)
+  {
+    std::string dir_a = m_directory + "/" + level_a[a];
+    std::vector<std::string> level_b;
+    if (!isDirectory(dir_a) || !listDirectory(dir_a, level_b))
+    {
+      continue;
+    }
+
+    for (std::vector<std::string>::size_type b = 0; b < level_b.size(); b++)
+    {
+      std::vector<std::string> files;
+      if (!listDirectory(dir_a + "/" + level_b[b], files))
+      {
+        continue;
+      }
+
+      for (std::vector<std::string>::size_type f = 0; f < files.size(); f++)
+      {
+        int x, z;
+        if (parseCoords(files[f], "c.", ".dat", 36, x, z))
+        {
+          chunks.push_back(std::make_pair(x, z));
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+//
+// RegionFile
+//
+
+RegionFile::RegionFile() : m_file(NULL), m_mapped(NULL), m_mappedSize(0)
+{
+  memset(m_locations, 0, sizeof(m_locations));
+  memset(m_timestamps, 0, sizeof(m_timestamps));
+}
+
+RegionFile::~RegionFile()
+{
+  close();
+}
+
+bool RegionFile::open(const std::string& path, bool create, bool& missing)
+{
+  m_path  = path;
+  m_file  = fopen(path.c_str(), "r+b");
+  missing = false;
+  if (m_file == NULL)
+  {
+    // Only a file that isn't there may be started over
+    if (errno != ENOENT)
+    {
+      return false;
+    }
+    if (!create)
+    {
+      missing = true;
+      return false;
+    }
+    m_file = fopen(path.c_str(), "w+b");
+    if (m_file == NULL)
+    {
+      return false;
+    }
+  }
+
+  fseek(m_file, 0, SEEK_END);
+  long size = ftell(m_file);
+
+  // Pad to whole sectors, a new file gets an empty header
+  if (size < HEADER_SECTORS * SECTOR_SIZE || size % SECTOR_SIZE)
+  {
+    long padded = size < HEADER_SECTORS * SECTOR_SIZE ? HEADER_SECTORS * SECTOR_SIZE
+                  : (size / SECTOR_SIZE + 1) * SECTOR_SIZE;
+    std::vector<uint8_t> zero(padded - size, 0);
+    fwrite(&zero[0], 1, zero.size(), m_file);
+    fflush(m_file);
+    size = padded;
+  }
+
+  uint8_t header[HEADER_SECTORS * SECTOR_SIZE];
+  fseek(m_file, 0, SEEK_SET);
+  if (fread(header, 1, sizeof(header), m_file) != sizeof(header))
+  {
+    close();
+    return false;
+  }
+
+  m_sectors.assign(size / SECTOR_SIZE, false);
+  for (int i = 0; i < HEADER_SECTORS; i++)
+  {
+    m_sectors[i] = true;
+  }
+
+  for (int i = 0; i < CHUNKS; i++)
+  {
+    m_locations[i]  = getBE32(&header[i * 4]);
+    m_timestamps[i] = getBE32(&header[SECTOR_SIZE + i * 4]);
+
+    uint32_t offset = m_locations[i] >> 8;
+    uint32_t count  = m_locations[i] & 0xFF;
+    if (m_locations[i] == 0)
+    {
+      continue;
+    }
+
+    // Drop entries pointing outside the file
+    if (offset < HEADER_SECTORS || count == 0 || offset + count > m_sectors.size())
+    {
+      m_locations[i] = 0;
+      continue;
+    }
+
+    for (uint32_t s = offset; s < offset + count; s++)
+    {
+      m_sectors[s] = true;
+    }
+  }
+
+  return true;
+}
+
+void RegionFile::close()
+{
+  unmap();
+  if (m_file != NULL)
+  {
+    fclose(m_file);
+    m_file = NULL;
+  }
+}
+
+bool RegionFile::map()
+{
+#ifdef WIN32
+  return false;
+#else
+  size_t size = m_sectors.size() * SECTOR_SIZE;
+  if (m_mapped != NULL && m_mappedSize >= size)
+  {
+    return true;
+  }
+
+  unmap();
+  void* mapped = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(m_file), 0);
+  if (mapped == MAP_FAILED)
+  {
+    return false;
+  }
+  m_mapped     = static_cast<uint8_t*>(mapped);
+  m_mappedSize = size;
+  return true;
+#endif
+}
+
+void RegionFile::unmap()
+{
+#ifndef WIN32
+  if (m_mapped != NULL)
+  {
+    munmap(m_mapped, m_mappedSize);
+  }
+#endif
+  m_mapped     = NULL;
+  m_mappedSize = 0;
+}
+
+bool RegionFile::read(int lx, int lz, std::vector<uint8_t>& data)
+{
+  uint32_t location = m_locations[index(lx, lz)];
+  uint32_t offset   = location >> 8;
+  uint32_t count    = location & 0xFF;
+  if (location == 0)
+  {
+    return false;
+  }
+
+  const uint8_t* sectors;
+  std::vector<uint8_t> buffer;
+  if (map())
+  {
+    sectors = m_mapped + offset * SECTOR_SIZE;
+  }
+  else
+  {
+    // No mmap, read the sectors instead
+    buffer.resize(count * SECTOR_SIZE);
+    fseek(m_file, offset * SECTOR_SIZE, SEEK_SET);
+    if (fread(&buffer[0], 1, buffer.size(), m_file) != buffer.size())
+    {
+      return false;
+    }
+    sectors = &buffer[0];
+  }
+
+  uint32_t length = getBE32(sectors);
+  if (length < 1 || length > count * SECTOR_SIZE - 4)
+  {
+    return false;
+  }
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // zlib, or gzip for type 1
+  if (inflateInit2(&stream, sectors[4] == 1 ? 16 + MAX_WBITS : MAX_WBITS) != Z_OK)
+  {
+    return false;
+  }
+  stream.next_in  = const_cast<Bytef*>(sectors + 5);
+  stream.avail_in = length - 1;
+
+  data.resize(length * 4);
+  int result = Z_OK;
+  while (result == Z_OK)
+  {
+    if (stream.total_out == data.size())
+    {
+      data.resize(data.size() * 2);
+    }
+    stream.next_out  = &data[stream.total_out];
+    stream.avail_out = data.size() - stream.total_out;
+    result = inflate(&stream, Z_NO_FLUSH);
+  }
+  data.resize(stream.total_out);
+  inflateEnd(&stream);
+
+  return result == Z_STREAM_END;
+}
+
+bool RegionFile::write(int lx, int lz, const std::vector<uint8_t>& data)
+{
+  if (data.empty())
+  {
+    return false;
+  }
+
+  uLongf compressedSize = compressBound(data.size());
+  std::vector<uint8_t> buffer(5 + compressedSize);
+  if (compress(&buffer[5], &compressedSize, &data[0], data.size()) != Z_OK)
+  {
+    return false;
+  }
+  putBE32(&buffer[0], compressedSize + 1);
+  buffer[4] = COMPRESSION_ZLIB;
+
+  uint32_t needed = (5 + compressedSize + SECTOR_SIZE - 1) / SECTOR_SIZE;
+  if (needed > MAX_SECTORS)
+  {
+    return false;
+  }
+  // Whole sectors keep the file size a multiple of SECTOR_SIZE
+  buffer.resize(needed * SECTOR_SIZE, 0);
+
+  const int i = index(lx, lz);
+  uint32_t offset = m_locations[i] >> 8;
+  uint32_t count  = m_locations[i] & 0xFF;
+
+  if (offset != 0 && needed <= count)
+  {
+    // Fits where it was, give back the tail
+    for (uint32_t s = offset + needed; s < offset + count; s++)
+    {
+      m_sectors[s] = false;
+    }
+  }
+  else
+  {
+    for (uint32_t s = offset; offset != 0 && s < offset + count; s++)
+    {
+      m_sectors[s] = false;
+    }
+
+    // First free run that is long enough, else append
+    offset = 0;
+    uint32_t run = 0;
+    for (uint32_t s = HEADER_SECTORS; s < m_sectors.size(); s++)
+    {
+      run = m_sectors[s] ? 0 : run + 1;
+      if (run == needed)
+      {
+        offset = s - needed + 1;
+        break;
+      }
+    }
+    if (offset == 0)
+    {
+      offset = m_sectors.size();
+      m_sectors.resize(offset + needed, false);
+    }
+  }
+
+  for (uint32_t s = offset; s < offset + needed; s++)
+  {
+    m_sectors[s] = true;
+  }
+
+  fseek(m_file, offset * SECTOR_SIZE, SEEK_SET);
+  if (fwrite(&buffer[0], 1, buffer.size(), m_file) != buffer.size())
+  {
+    return false;
+  }
+
+  m_locations[i]  = (offset << 8) | needed;
+  m_timestamps[i] = (uint32_t)time(NULL);
+
+  return writeHeader(i);
+}
+
+bool RegionFile::writeHeader(int i)
+{
+  uint8_t entry[4];
+
+  putBE32(entry, m_locations[i]);
+  fseek(m_file, i * 4, SEEK_SET);
+  if (fwrite(entry, 1, 4, m_file) != 4)
+  {
+    return false;
+  }
+
+  putBE32(entry, m_timestamps[i]);
+  fseek(m_file, SECTOR_SIZE + i * 4, SEEK_SET);
+  if (fwrite(entry, 1, 4, m_file) != 4)
+  {
+    return false;
+  }
+
+  return fflush(m_file) == 0;
+}
+
+//
+// RegionStorage
+//
+
+RegionStorage::RegionStorage(const std::string& directory) : m_directory(directory + "/region")
+{
+}
+
+RegionStorage::~RegionStorage()
+{
+  for (std::map<uint64_t, OpenRegion>::iterator it = m_regions.begin(); it != m_regions.end(); ++it)
+  {
+    delete it->second.file;
+  }
+}
+
+RegionFile* RegionStorage::region(int rx, int rz, bool create, bool& missing)
+{
+  const uint64_t key = ((uint64_t)(uint32_t)rx << 32) | (uint32_t)rz;
+  missing = false;
+
+  std::map<uint64_t, OpenRegion>::iterator it = m_regions.find(key);
+  if (it != m_regions.end())
+  {
+    m_used.splice(m_used.begin(), m_used, it->second.used);
+    return it->second.file;
+  }
+
+  if (!create && m_absent.count(key))
+  {
+    missing = true;
+    return NULL;
+  }
+
+  if (create && !makeDirectory(m_directory))
+  {
+    return NULL;
+  }
+
+  // Make room, every open region holds a file handle and a mapping
+  while (m_regions.size() >= MAX_OPEN)
+  {
+    std::map<uint64_t, OpenRegion>::iterator oldest = m_regions.find(m_used.back());
+    delete oldest->second.file;
+    m_regions.erase(oldest);
+    m_used.pop_back();
+  }
+
+  std::ostringstream path;
+  path << m_directory << "/r." << rx << "." << rz << ".mcr";
+
+  RegionFile* file = new RegionFile;
+  if (!file->open(path.str(), create, missing))
+  {
+    delete file;
+    // Errors are not remembered, the next call tries again
+    if (missing)
+    {
+      m_absent.insert(key);
+    }
+    return NULL;
+  }
+
+  m_absent.erase(key);
+  m_used.push_front(key);
+  OpenRegion& open = m_regions[key];
+  open.file = file;
+  open.used = m_used.begin();
+  return file;
+}
+
+bool RegionStorage::load(int x, int z, std::vector<uint8_t>& data, bool& missing)
+{
+  MutexLock lock(m_mutex);
+
+  RegionFile* file = region(x >> 5, z >> 5, false, missing);
+  if (file == NULL)
+  {
+    return false;
+  }
+
+  missing = !file->has(x & 31, z & 31);
+  if (missing)
+  {
+    return false;
+  }
+
+  return file->read(x & 31, z & 31, data);
+}
+
+bool RegionStorage::save(int x, int z, const std::vector<uint8_t>& data)
+{
+  MutexLock lock(m_mutex);
+
+  bool missing;
+  RegionFile* file = region(x >> 5, z >> 5, true, missing);
+  if (file == NULL)
+  {
+    return false;
+  }
+
+  return file->write(x & 31, z & 31, data);
+}
+
+bool RegionStorage::list(std::vector<std::pair<int, int> >& chunks)
+{
+  MutexLock lock(m_mutex);
+
+  std::vector<std::string> files;
+  if (!listDirectory(m_directory, files))
+  {
+    // No region directory means no chunks
+    return !isDirectory(m_directory);
+  }
+
+  for (std::vector<std::string>::size_type f = 0; f < files.size(); f++)
+  {
+    int rx, rz;
+    if (!parseCoords(files[f], "r.", ".mcr", 10, rx, rz))
+    {
+      continue;
+    }
+
+    bool missing;
+    RegionFile* file = region(rx, rz, false, missing);
+    if (file == NULL)
+    {
+      if (missing)
+      {
+        continue;
+      }
+      return false;
+    }
+
+    for (int lz = 0; lz < 32; lz++)
+    {
+      for (int lx = 0; lx < 32; lx++)
+      {
+        if (file->has(lx, lz))
+        {
+          chunks.push_back(std::make_pair(rx * 32 + lx, rz * 32 + lz));
+        }
+      }
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,166 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _CHUNKSTORAGE_H
+#define _CHUNKSTORAGE_H
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "threads.h"
+
+//
+// Where chunk NBT lives on disk. Implementations are used from the chunk
+// I/O thread and the main thread at the same time and must lock themselves.
+//
+class ChunkStorage
+{
+public:
+  virtual ~ChunkStorage() {}
+
+  // Uncompressed chunk NBT, missing is set if the chunk was never saved
+  virtual bool load(int x, int z, std::vector<uint8_t>& data, bool& missing) = 0;
+  virtual bool save(int x, int z, const std::vector<uint8_t>& data) = 0;
+
+  // Coordinates of every stored chunk
+  virtual bool list(std::vector<std::pair<int, int> >& chunks) = 0;
+
+  // "nbt" or "region", NULL for an unknown format
+  static ChunkStorage* create(const std::string& format, const std::string& directory);
+};
+
+// One gzip NBT file per chunk in base36 named directories
+class NBTFileStorage : public ChunkStorage
+{
+public:
+  explicit NBTFileStorage(const std::string& directory);
+
+  bool load(int x, int z, std::vector<uint8_t>& data, bool& missing);
+  bool save(int x, int z, const std::vector<uint8_t>& data);
+  bool list(std::vector<std::pair<int, int> >& chunks);
+
+private:
+  std::string m_directory;
+  Mutex m_mutex;
+};
+
+//
+// 32x32 chunks per region file. The file starts with a 4KiB table of chunk
+// locations (3 byte sector offset, 1 byte sector count, big endian) and a
+// 4KiB table of save timestamps, followed by 4KiB sectors holding a 4 byte
+// length, a compression type byte and the zlib compressed chunk NBT.
+//
+class RegionFile
+{
+public:
+  enum
+  {
+    SECTOR_SIZE    = 4096,
+    HEADER_SECTORS = 2,
+    CHUNKS         = 32 * 32,
+    MAX_SECTORS    = 255,
+    COMPRESSION_ZLIB = 2
+  };
+
+  RegionFile();
+  ~RegionFile();
+
+  // missing is set when the file does not exist and create is false
+  bool open(const std::string& path, bool create, bool& missing);
+  void close();
+
+  bool has(int lx, int lz) const
+  {
+    return m_locations[index(lx, lz)] != 0;
+  }
+  bool read(int lx, int lz, std::vector<uint8_t>& data);
+  bool write(int lx, int lz, const std::vector<uint8_t>& data);
+
+private:
+  static int index(int lx, int lz)
+  {
+    return lx + lz * 32;
+  }
+
+  bool writeHeader(int index);
+  bool map();
+  void unmap();
+
+  std::string m_path;
+  FILE* m_file;
+  uint32_t m_locations[CHUNKS];
+  uint32_t m_timestamps[CHUNKS];
+  // true for sectors in use
+  std::vector<bool> m_sectors;
+
+  uint8_t* m_mapped;
+  size_t m_mappedSize;
+
+  RegionFile(const RegionFile&);
+  RegionFile& operator=(const RegionFile&);
+};
+
+// Region files in <directory>/region/r.<x>.<z>.mcr, at most MAX_OPEN of
+// them open at once
+class RegionStorage : public ChunkStorage
+{
+public:
+  enum { MAX_OPEN = 64 };
+
+  explicit RegionStorage(const std::string& directory);
+  ~RegionStorage();
+
+  bool load(int x, int z, std::vector<uint8_t>& data, bool& missing);
+  bool save(int x, int z, const std::vector<uint8_t>& data);
+  bool list(std::vector<std::pair<int, int> >& chunks);
+
+private:
+  RegionFile* region(int rx, int rz, bool create, bool& missing);
+
+  struct OpenRegion
+  {
+    RegionFile* file;
+    std::list<uint64_t>::iterator used;
+  };
+
+  std::string m_directory;
+  Mutex m_mutex;
+  std::map<uint64_t, OpenRegion> m_regions;
+  // Open regions, most recently used first
+  std::list<uint64_t> m_used;
+  // Regions without a file yet
+  std::set<uint64_t> m_absent;
+};
+
+#endif
@@ -79,8 +79,8 @@ void CliScreen::init(std::string version)
   stdinThread = CreateThread(NULL, 0, _stdinThreadProc, (void*)this, 0, NULL);
 #endif
 
-  static_cast<Hook3<bool, int, const char*, const char*>*>(Mineserver::get()->plugin()->getHook("LogPost"))->addCallback(&CliScreen::Log);
-  static_cast<Hook0<bool>*>(Mineserver::get()->plugin()->getHook("Timer200"))->addCallback(&CliScreen::CheckForCommand);
+  static_cast<Hook3<bool, int, const char*, const char*>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_LOG_POST))->addCallback(&CliScreen::Log);
+  static_cast<Hook0<bool>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_TIMER200))->addCallback(&CliScreen::CheckForCommand);
 }
 
 void CliScreen::end()
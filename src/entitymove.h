@@ -0,0 +1,131 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ENTITYMOVE_H
+#define _ENTITYMOVE_H
+
+#include <string>
+#include <stdint.h>
+
+#include "packets.h"
+
+//
+// Position and look of an entity as last sent to the clients, in 1/32
+// blocks and 1/256 turns. encode() writes the smallest packet that takes
+// the clients from there to the new state: a relative move (8 bytes), a
+// look (7), both (10), or the 19 byte teleport when a step doesn't fit in
+// a byte. Every TELEPORT_INTERVAL packets a teleport is sent anyway, so
+// clients that missed a step don't stay off.
+//
+class EntityMove
+{
+public:
+  enum { TELEPORT_INTERVAL = 100 };
+
+  EntityMove() : m_x(0), m_y(0), m_z(0), m_yaw(0), m_pitch(0), m_sinceTeleport(TELEPORT_INTERVAL)
+  {
+  }
+
+  // Make the next encode() a teleport, for when some clients only just
+  // got the entity spawned or never saw the last state
+  void reset()
+  {
+    m_sinceTeleport = TELEPORT_INTERVAL;
+  }
+
+  // Clients that get the spawn packet start from this state
+  void spawnedAt(double x, double y, double z, int8_t yaw, int8_t pitch)
+  {
+    m_x     = (int32_t)(x * 32);
+    m_y     = (int32_t)(y * 32);
+    m_z     = (int32_t)(z * 32);
+    m_yaw   = yaw;
+    m_pitch = pitch;
+    m_sinceTeleport = 0;
+  }
+
+  // Returns false, with nothing written, if the entity did not change
+  bool encode(Packet& pkt, int32_t eid, double x, double y, double z, int8_t yaw, int8_t pitch)
+  {
+    const int32_t newX = (int32_t)(x * 32);
+    const int32_t newY = (int32_t)(y * 32);
+    const int32_t newZ = (int32_t)(z * 32);
+    const int32_t dx = newX - m_x;
+    const int32_t dy = newY - m_y;
+    const int32_t dz = newZ - m_z;
+    const bool moved  = dx != 0 || dy != 0 || dz != 0;
+    const bool looked = yaw != m_yaw || pitch != m_pitch;
+
+    if (m_sinceTeleport >= TELEPORT_INTERVAL || !fitsByte(dx) || !fitsByte(dy) || !fitsByte(dz))
+    {
+      pkt << (int8_t)PACKET_ENTITY_TELEPORT << eid << newX << newY << newZ << yaw << pitch;
+      m_sinceTeleport = 0;
+    }
+    else if (moved && looked)
+    {
+      pkt << (int8_t)PACKET_ENTITY_LOOK_RELATIVE_MOVE << eid << (int8_t)dx << (int8_t)dy << (int8_t)dz
+          << yaw << pitch;
+      m_sinceTeleport++;
+    }
+    else if (moved)
+    {
+      pkt << (int8_t)PACKET_ENTITY_RELATIVE_MOVE << eid << (int8_t)dx << (int8_t)dy << (int8_t)dz;
+      m_sinceTeleport++;
+    }
+    else if (looked)
+    {
+      pkt << (int8_t)PACKET_ENTITY_LOOK << eid << yaw << pitch;
+      m_sinceTeleport++;
+    }
+    else
+    {
+      return false;
+    }
+
+    m_x     = newX;
+    m_y     = newY;
+    m_z     = newZ;
+    m_yaw   = yaw;
+    m_pitch = pitch;
+    return true;
+  }
+
+private:
+  static bool fitsByte(int32_t delta)
+  {
+    return delta >= -128 && delta <= 127;
+  }
+
+  int32_t m_x;
+  int32_t m_y;
+  int32_t m_z;
+  int8_t m_yaw;
+  int8_t m_pitch;
+  int m_sinceTeleport;
+};
+
+#endif
@@ -0,0 +1,358 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include "entitytracker.h"
+#include "constants.h"
+#include "tools.h"
+#include "user.h"
+#include "mob.h"
+
+EntityTracker::EntityTracker(int distance)
+  : m_distance(distance)
+{
+}
+
+EntityTracker::~EntityTracker()
+{
+  for (EntityMap::iterator it = m_entities.begin(); it != m_entities.end(); ++it)
+  {
+    delete it->second;
+  }
+}
+
+void EntityTracker::addUser(User* user)
+{
+  if (isTracked(user->UID))
+  {
+    return;
+  }
+
+  Entity* entity = new Entity;
+  entity->eid   = user->UID;
+  entity->user  = user;
+  entity->mob   = NULL;
+  entity->map   = user->pos.map;
+  entity->x     = user->pos.x;
+  entity->y     = user->pos.y;
+  entity->z     = user->pos.z;
+  entity->yaw   = angleToByte(user->pos.yaw);
+  entity->pitch = angleToByte(user->pos.pitch);
+  add(entity);
+}
+
+void EntityTracker::addMob(Mob* mob)
+{
+  if (isTracked(mob->UID))
+  {
+    return;
+  }
+
+  Entity* entity = new Entity;
+  entity->eid   = mob->UID;
+  entity->user  = NULL;
+  entity->mob   = mob;
+  entity->map   = mob->map;
+  entity->x     = mob->x;
+  entity->y     = mob->y;
+  entity->z     = mob->z;
+  entity->yaw   = mob->yaw;
+  entity->pitch = mob->pitch;
+  add(entity);
+}
+
+void EntityTracker::add(Entity* entity)
+{
+  entity->cellX = blockToChunk((int32_t)entity->x);
+  entity->cellZ = blockToChunk((int32_t)entity->z);
+  insertCell(entity);
+  m_entities[entity->eid] = entity;
+  entity->move.spawnedAt(entity->x, entity->y, entity->z, entity->yaw, entity->pitch);
+
+  std::vector<Entity*> near;
+  nearby(entity, near);
+  for (std::vector<Entity*>::iterator it = near.begin(); it != near.end(); ++it)
+  {
+    if ((*it)->user != NULL)
+    {
+      link(*it, entity);
+    }
+    if (entity->user != NULL)
+    {
+      link(entity, *it);
+    }
+  }
+}
+
+void EntityTracker::remove(uint32_t eid)
+{
+  EntityMap::iterator found = m_entities.find(eid);
+  if (found == m_entities.end())
+  {
+    return;
+  }
+  Entity* entity = found->second;
+
+  Packet pkt;
+  pkt << (int8_t)PACKET_DESTROY_ENTITY << (int32_t)eid;
+  sendToObservers(eid, pkt);
+
+  std::set<Entity*>::iterator it;
+  for (it = entity->observers.begin(); it != entity->observers.end(); ++it)
+  {
+    (*it)->visible.erase(entity);
+  }
+  for (it = entity->visible.begin(); it != entity->visible.end(); ++it)
+  {
+    (*it)->observers.erase(entity);
+  }
+
+  eraseCell(entity);
+  m_entities.erase(found);
+  delete entity;
+}
+
+void EntityTracker::move(uint32_t eid, int map, double x, double y, double z, int8_t yaw, int8_t pitch, bool teleport)
+{
+  EntityMap::iterator found = m_entities.find(eid);
+  if (found == m_entities.end())
+  {
+    return;
+  }
+  Entity* entity = found->second;
+
+  if (teleport)
+  {
+    entity->move.reset();
+  }
+  Packet pkt;
+  entity->move.encode(pkt, eid, x, y, z, yaw, pitch);
+
+  entity->x     = x;
+  entity->y     = y;
+  entity->z     = z;
+  entity->yaw   = yaw;
+  entity->pitch = pitch;
+
+  const int cellX = blockToChunk((int32_t)x);
+  const int cellZ = blockToChunk((int32_t)z);
+  if (map == entity->map && cellX == entity->cellX && cellZ == entity->cellZ)
+  {
+    sendToObservers(eid, pkt);
+    return;
+  }
+
+  // Moved to another cell, find out who got in and out of range
+  eraseCell(entity);
+  entity->map   = map;
+  entity->cellX = cellX;
+  entity->cellZ = cellZ;
+  insertCell(entity);
+
+  std::vector<Entity*> near;
+  nearby(entity, near);
+  std::set<Entity*> inRange(near.begin(), near.end());
+
+  std::vector<Entity*> gone;
+  std::set<Entity*>::iterator it;
+  for (it = entity->observers.begin(); it != entity->observers.end(); ++it)
+  {
+    if (!inRange.count(*it))
+    {
+      gone.push_back(*it);
+    }
+  }
+  for (size_t i = 0; i < gone.size(); i++)
+  {
+    unlink(gone[i], entity);
+  }
+
+  // Players that saw it before get the move, the new ones the spawn at
+  // the same position
+  sendToObservers(eid, pkt);
+  for (size_t i = 0; i < near.size(); i++)
+  {
+    if (near[i]->user != NULL && !entity->observers.count(near[i]))
+    {
+      link(near[i], entity);
+    }
+  }
+
+  if (entity->user == NULL)
+  {
+    return;
+  }
+
+  gone.clear();
+  for (it = entity->visible.begin(); it != entity->visible.end(); ++it)
+  {
+    if (!inRange.count(*it))
+    {
+      gone.push_back(*it);
+    }
+  }
+  for (size_t i = 0; i < gone.size(); i++)
+  {
+    unlink(entity, gone[i]);
+  }
+  for (size_t i = 0; i < near.size(); i++)
+  {
+    if (!entity->visible.count(near[i]))
+    {
+      link(entity, near[i]);
+    }
+  }
+}
+
+void EntityTracker::sendToObservers(uint32_t eid, const Packet& pkt)
+{
+  EntityMap::iterator found = m_entities.find(eid);
+  if (found == m_entities.end() || pkt.getWriteLen() == 0 || found->second->observers.empty())
+  {
+    return;
+  }
+
+  SharedBuffer* shared = SharedBuffer::create(pkt.getWrite(), pkt.getWriteLen());
+  std::set<Entity*>& observers = found->second->observers;
+  for (std::set<Entity*>::iterator it = observers.begin(); it != observers.end(); ++it)
+  {
+    (*it)->user->buffer.addToWrite(shared);
+  }
+  shared->release();
+}
+
+void EntityTracker::insertCell(Entity* entity)
+{
+  Cell cell = { entity->map, entity->cellX, entity->cellZ };
+  m_grid[cell].push_back(entity);
+}
+
+void EntityTracker::eraseCell(Entity* entity)
+{
+  Cell cell = { entity->map, entity->cellX, entity->cellZ };
+  Grid::iterator found = m_grid.find(cell);
+  if (found == m_grid.end())
+  {
+    return;
+  }
+
+  std::vector<Entity*>& entities = found->second;
+  std::vector<Entity*>::iterator it = std::find(entities.begin(), entities.end(), entity);
+  if (it != entities.end())
+  {
+    *it = entities.back();
+    entities.pop_back();
+  }
+  if (entities.empty())
+  {
+    m_grid.erase(found);
+  }
+}
+
+void EntityTracker::nearby(Entity* entity, std::vector<Entity*>& out)
+{
+  Cell cell;
+  cell.map = entity->map;
+  for (cell.x = entity->cellX - m_distance; cell.x <= entity->cellX + m_distance; cell.x++)
+  {
+    for (cell.z = entity->cellZ - m_distance; cell.z <= entity->cellZ + m_distance; cell.z++)
+    {
+      Grid::const_iterator found = m_grid.find(cell);
+      if (found == m_grid.end())
+      {
+        continue;
+      }
+      for (size_t i = 0; i < found->second.size(); i++)
+      {
+        if (found->second[i] != entity)
+        {
+          out.push_back(found->second[i]);
+        }
+      }
+    }
+  }
+}
+
+void EntityTracker::link(Entity* observer, Entity* entity)
+{
+  observer->visible.insert(entity);
+  entity->observers.insert(observer);
+
+  Packet pkt;
+  writeSpawn(entity, pkt);
+  send(observer, pkt);
+}
+
+void EntityTracker::unlink(Entity* observer, Entity* entity)
+{
+  observer->visible.erase(entity);
+  entity->observers.erase(observer);
+
+  Packet pkt;
+  pkt << (int8_t)PACKET_DESTROY_ENTITY << (int32_t)entity->eid;
+  send(observer, pkt);
+}
+
+void EntityTracker::writeSpawn(Entity* entity, Packet& pkt)
+{
+  if (entity->mob != NULL)
+  {
+    Mob* mob = entity->mob;
+    pkt << (int8_t)PACKET_MOB_SPAWN << (int32_t)entity->eid << (int8_t)mob->type
+        << (int32_t)(entity->x * 32) << (int32_t)(entity->y * 32) << (int32_t)(entity->z * 32)
+        << entity->yaw << entity->pitch;
+    if (mob->type == MOB_SHEEP)
+    {
+      pkt << (int8_t)0 << (int8_t)mob->meta << (int8_t)127;
+    }
+    else
+    {
+      pkt << (int8_t)127;
+    }
+    return;
+  }
+
+  User* user = entity->user;
+  int16_t holding = user->inv[user->curItem + 36].getType();
+  pkt << (int8_t)PACKET_NAMED_ENTITY_SPAWN << (int32_t)entity->eid << user->nick
+      << (int32_t)(entity->x * 32) << (int32_t)(entity->y * 32) << (int32_t)(entity->z * 32)
+      << entity->yaw << entity->pitch << (int16_t)(holding < 0 ? 0 : holding);
+
+  // Held item and armour
+  for (int slot = 0; slot < 5; slot++)
+  {
+    int n = (slot == 0) ? user->curItem + 36 : 9 - slot;
+    pkt << (int8_t)PACKET_ENTITY_EQUIPMENT << (int32_t)entity->eid
+        << (int16_t)slot << (int16_t)user->inv[n].getType() << (int16_t)0;
+  }
+}
+
+void EntityTracker::send(Entity* observer, const Packet& pkt)
+{
+  observer->user->buffer.addToWrite(pkt.getWrite(), pkt.getWriteLen());
+}
@@ -0,0 +1,132 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ENTITYTRACKER_H
+#define _ENTITYTRACKER_H
+
+#include <map>
+#include <set>
+#include <vector>
+#include <stdint.h>
+
+#include "entitymove.h"
+
+class User;
+class Mob;
+
+//
+// Keeps players and mobs on a grid of chunk sized cells and, for every
+// player, the set of entities within the tracking distance. Entities are
+// spawned for a player when they get into range and destroyed when they
+// leave it, and movement is only sent to the players that have the entity
+// spawned.
+//
+class EntityTracker
+{
+public:
+  // Distance in chunks, on both axes
+  explicit EntityTracker(int distance);
+  ~EntityTracker();
+
+  // Start tracking a player that just logged in. The player is spawned for
+  // those near, and gets everything near spawned.
+  void addUser(User* user);
+  void addMob(Mob* mob);
+  // Stop tracking, the entity is destroyed for everyone that saw it
+  void remove(uint32_t eid);
+
+  bool isTracked(uint32_t eid) const
+  {
+    return m_entities.count(eid) != 0;
+  }
+
+  // New position of a tracked entity. Observers get the smallest move
+  // packet, teleport forces a full position.
+  void move(uint32_t eid, int map, double x, double y, double z, int8_t yaw, int8_t pitch, bool teleport = false);
+
+  // Send to the players that have this entity spawned
+  void sendToObservers(uint32_t eid, const Packet& pkt);
+
+private:
+  struct Entity
+  {
+    uint32_t eid;
+    User* user;
+    Mob* mob;
+    int map;
+    int cellX;
+    int cellZ;
+    double x, y, z;
+    int8_t yaw, pitch;
+    EntityMove move;
+    // Players this entity is spawned for
+    std::set<Entity*> observers;
+    // For players, the entities spawned for them
+    std::set<Entity*> visible;
+  };
+
+  struct Cell
+  {
+    int map;
+    int x;
+    int z;
+
+    bool operator<(const Cell& other) const
+    {
+      if (map != other.map)
+      {
+        return map < other.map;
+      }
+      if (x != other.x)
+      {
+        return x < other.x;
+      }
+      return z < other.z;
+    }
+  };
+
+  typedef std::map<uint32_t, Entity*> EntityMap;
+  typedef std::map<Cell, std::vector<Entity*> > Grid;
+
+  void add(Entity* entity);
+  void insertCell(Entity* entity);
+  void eraseCell(Entity* entity);
+  // Everything within the tracking distance of the entity, itself excluded
+  void nearby(Entity* entity, std::vector<Entity*>& out);
+
+  void link(Entity* observer, Entity* entity);
+  void unlink(Entity* observer, Entity* entity);
+
+  static void writeSpawn(Entity* entity, Packet& pkt);
+  static void send(Entity* observer, const Packet& pkt);
+
+  int m_distance;
+  EntityMap m_entities;
+  Grid m_grid;
+};
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef _HOOK_H
 #define _HOOK_H
 
+#include <stdint.h>
+#include <cstddef>
 #include <vector>
 #include <utility>
 #include <cstdarg>
@@ -42,9 +44,48 @@ template <> struct va_widened<double>
   typedef double t;
 };
 
+// Times the calls of a hook. The server gives every hook one, and plugins
+// only call it through the vtable.
+class HookTimer
+{
+public:
+  virtual ~HookTimer() {}
+  // Start of a call, 0 if it isn't timed
+  virtual uint64_t start() = 0;
+  virtual void stop(uint64_t started) = 0;
+};
+
+class HookScope
+{
+public:
+  explicit HookScope(HookTimer* timer)
+    : m_timer(timer),
+      m_started(timer != NULL ? timer->start() : 0)
+  {
+  }
+  ~HookScope()
+  {
+    if (m_started != 0)
+    {
+      m_timer->stop(m_started);
+    }
+  }
+
+private:
+  HookTimer* m_timer;
+  uint64_t m_started;
+};
+
 class Hook
 {
 public:
+  Hook() : m_timer(NULL) {}
+
+  void setTimer(HookTimer* timer)
+  {
+    m_timer = timer;
+  }
+
   virtual void addCallback(void* function) {}
   virtual void addIdentifiedCallback(void* identifier, void* function) {}
   virtual bool hasCallback(void* function)
@@ -61,6 +102,9 @@ public:
     return false;
   }
   virtual void doAllVA(va_list vl) {}
+
+protected:
+  HookTimer* m_timer;
 };
 
 template <class R>
@@ -166,6 +210,7 @@ public:
 
   void doAll()
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -190,6 +235,7 @@ public:
 
   bool doUntilTrue()
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -222,6 +268,7 @@ public:
 
   bool doUntilFalse()
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -380,6 +427,7 @@ public:
 
   void doAll(A1 a1)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -404,6 +452,7 @@ public:
 
   bool doUntilTrue(A1 a1)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -436,6 +485,7 @@ public:
 
   bool doUntilFalse(A1 a1)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -594,6 +644,7 @@ public:
 
   void doAll(A1 a1, A2 a2)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -619,6 +670,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -652,6 +704,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -812,6 +865,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -838,6 +892,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -872,6 +927,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -1034,6 +1090,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -1061,6 +1118,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -1096,6 +1154,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -1260,6 +1319,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -1288,6 +1348,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -1324,6 +1385,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -1490,6 +1552,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -1519,6 +1582,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -1556,6 +1620,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -1724,6 +1789,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -1754,6 +1820,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -1792,6 +1859,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -1962,6 +2030,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -1993,6 +2062,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -2032,6 +2102,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -2204,6 +2275,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -2236,6 +2308,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -2276,6 +2349,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -2450,6 +2524,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -2483,6 +2558,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -2524,6 +2600,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -2700,6 +2777,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -2734,6 +2812,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -2776,6 +2855,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -2954,6 +3034,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -2989,6 +3070,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -3032,6 +3114,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -3212,6 +3295,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -3248,6 +3332,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -3292,6 +3377,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -3474,6 +3560,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -3511,6 +3598,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -3556,6 +3644,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -3740,6 +3829,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -3778,6 +3868,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -3824,6 +3915,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -4010,6 +4102,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -4049,6 +4142,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -4096,6 +4190,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -4284,6 +4379,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -4324,6 +4420,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -4372,6 +4469,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -4562,6 +4660,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -4603,6 +4702,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -4652,6 +4752,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -4844,6 +4945,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18, A19 a19)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -4886,6 +4988,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18, A19 a19)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -4936,6 +5039,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18, A19 a19)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -5130,6 +5234,7 @@ public:
 
   void doAll(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18, A19 a19, A20 a20)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -5173,6 +5278,7 @@ public:
 
   bool doUntilTrue(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18, A19 a19, A20 a20)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
@@ -5224,6 +5330,7 @@ public:
 
   bool doUntilFalse(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10, A11 a11, A12 a12, A13 a13, A14 a14, A15 a15, A16 a16, A17 a17, A18 a18, A19 a19, A20 a20)
   {
+    HookScope scope(m_timer);
     typename std::vector<std::pair<void*, void*> >::iterator ia = m_callbacks.begin();
     typename std::vector<std::pair<void*, void*> >::iterator ib = m_callbacks.end();
     for (; ia != ib; ++ia)
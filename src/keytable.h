@@ -0,0 +1,216 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _KEYTABLE_H
+#define _KEYTABLE_H
+
+#include <cstddef>
+#include <stdint.h>
+
+//
+// Hash table from 64 bit keys to small values, shared by the containers
+// keyed by packed coordinates (ChunkMap, ChunkSet, BlockSchedule). Linear
+// probing with backward-shift deletion, so there are no tombstones, and the
+// load factor is kept below 1/2. All slots live in one array, nothing is
+// allocated per entry.
+//
+template <class T>
+class KeyTable
+{
+public:
+  KeyTable() : m_slots(NULL), m_capacity(0), m_mask(0), m_size(0)
+  {
+    resize(64);
+  }
+
+  KeyTable(const KeyTable& other) : m_slots(NULL), m_capacity(0), m_mask(0), m_size(0)
+  {
+    *this = other;
+  }
+
+  KeyTable& operator=(const KeyTable& other)
+  {
+    if (this != &other)
+    {
+      delete [] m_slots;
+      m_capacity = other.m_capacity;
+      m_mask     = other.m_mask;
+      m_size     = other.m_size;
+      m_slots    = new Slot[m_capacity];
+      for (size_t i = 0; i < m_capacity; ++i)
+      {
+        m_slots[i] = other.m_slots[i];
+      }
+    }
+    return *this;
+  }
+
+  ~KeyTable()
+  {
+    delete [] m_slots;
+  }
+
+  size_t size() const
+  {
+    return m_size;
+  }
+
+  // Value stored for k, NULL if k is not in the table. The pointer is only
+  // good until the next insert or erase.
+  T* find(uint64_t k)
+  {
+    const size_t i = slot(k);
+    return i == NONE ? NULL : &m_slots[i].value;
+  }
+
+  const T* find(uint64_t k) const
+  {
+    const size_t i = slot(k);
+    return i == NONE ? NULL : &m_slots[i].value;
+  }
+
+  // Returns false, leaving the stored value alone, if k was already there
+  bool insert(uint64_t k, const T& value)
+  {
+    if ((m_size + 1) * 2 > m_capacity)
+    {
+      resize(m_capacity * 2);
+    }
+
+    size_t i = hash(k) & m_mask;
+    for (; m_slots[i].used; i = (i + 1) & m_mask)
+    {
+      if (m_slots[i].key == k)
+      {
+        return false;
+      }
+    }
+
+    m_slots[i].key   = k;
+    m_slots[i].value = value;
+    m_slots[i].used  = true;
+    m_size++;
+    return true;
+  }
+
+  // Returns false if k was not in the table
+  bool erase(uint64_t k)
+  {
+    const size_t i = slot(k);
+    if (i == NONE)
+    {
+      return false;
+    }
+
+    // Backward-shift following entries so lookups never hit a false empty
+    size_t hole = i;
+    for (size_t j = (hole + 1) & m_mask; m_slots[j].used; j = (j + 1) & m_mask)
+    {
+      size_t home = hash(m_slots[j].key) & m_mask;
+      if (((j - home) & m_mask) >= ((j - hole) & m_mask))
+      {
+        m_slots[hole] = m_slots[j];
+        hole = j;
+      }
+    }
+    m_slots[hole].used = false;
+    m_size--;
+    return true;
+  }
+
+  void clear()
+  {
+    for (size_t i = 0; i < m_capacity; ++i)
+    {
+      m_slots[i].used = false;
+    }
+    m_size = 0;
+  }
+
+private:
+  static const size_t NONE = (size_t)-1;
+
+  struct Slot
+  {
+    uint64_t key;
+    T        value;
+    bool     used;
+  };
+
+  static size_t hash(uint64_t k)
+  {
+    // Fibonacci hashing, high bits are the best mixed
+    return (size_t)((k * 0x9E3779B97F4A7C15ULL) >> 32);
+  }
+
+  size_t slot(uint64_t k) const
+  {
+    for (size_t i = hash(k) & m_mask; m_slots[i].used; i = (i + 1) & m_mask)
+    {
+      if (m_slots[i].key == k)
+      {
+        return i;
+      }
+    }
+    return NONE;
+  }
+
+  void resize(size_t capacity)
+  {
+    Slot* old = m_slots;
+    const size_t oldCapacity = m_capacity;
+
+    m_capacity = capacity;
+    m_mask     = capacity - 1;
+    m_slots    = new Slot[m_capacity];
+    for (size_t i = 0; i < m_capacity; ++i)
+    {
+      m_slots[i].used = false;
+    }
+
+    for (size_t n = 0; n < oldCapacity; ++n)
+    {
+      if (old[n].used)
+      {
+        size_t i = hash(old[n].key) & m_mask;
+        while (m_slots[i].used)
+        {
+          i = (i + 1) & m_mask;
+        }
+        m_slots[i] = old[n];
+      }
+    }
+    delete [] old;
+  }
+
+  Slot* m_slots;
+  size_t m_capacity;
+  size_t m_mask;
+  size_t m_size;
+};
+
+#endif
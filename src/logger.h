@@ -36,9 +36,9 @@
 #include "logtype.h"
 
 #ifdef _WIN32
-#define LOGLF(msg) Mineserver::get()->logger()->log(msg, std::string(((strrchr(__FILE__, '\\') ?"": __FILE__ - 1) + 1)), __LINE__)
+#define LOGLF(msg) Mineserver::get()->logger()->log(msg, std::string(strrchr(__FILE__, '\\') ? strrchr(__FILE__, '\\') + 1 : __FILE__), __LINE__)
 #else
-#define LOGLF(msg) Mineserver::get()->logger()->log(msg, std::string(((strrchr(__FILE__, '/') ?"": __FILE__ - 1) + 1)), __LINE__)
+#define LOGLF(msg) Mineserver::get()->logger()->log(msg, std::string(strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__), __LINE__)
 #endif
 
 #define LOG(type, source, msg) Mineserver::get()->logger()->log(LogType::LOG_##type, source, msg)
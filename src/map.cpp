@@ -59,21 +59,31 @@
 #include "mineserver.h"
 #include "tree.h"
 #include "furnaceManager.h"
+#include "chunkcompressor.h"
+#include "chunkio.h"
+#include "chunkstorage.h"
+#include "skylight.h"
+#include "profiler.h"
 
 Map::Map(const Map& oldmap)
 {
   // Copy Construtor
   maps = oldmap.maps;
-  chunks = oldmap.chunks;
+  // The chunks stay owned by oldmap
   mapLastused = oldmap.mapLastused;
   mapChanged = oldmap.mapChanged;
   mapLightRegen = oldmap.mapLightRegen;
   items = oldmap.items;
   mapTime = oldmap.mapTime;
   mapSeed = oldmap.mapSeed;
+  chunkCacheHits = oldmap.chunkCacheHits;
+  chunkCacheMisses = oldmap.chunkCacheMisses;
+  chunksGenerated = oldmap.chunksGenerated;
+  // Backends own open files, the copy needs init() to get its own
+  storage = NULL;
 }
 
-Map::Map()
+Map::Map() : storage(NULL), chunkCacheHits(0), chunkCacheMisses(0), chunksGenerated(0)
 {
   for (int i = 0; i < 256; i++)
   {
@@ -129,16 +139,19 @@ Map::Map()
 Map::~Map()
 {
   // Free chunk memory
-  for (int i = 0; i < 441; ++i)
+  std::vector<sChunk*> loaded = chunks.getChunks();
+  for (std::vector<sChunk*>::iterator it = loaded.begin(); it != loaded.end(); ++it)
   {
-    sChunkNode* nextnode = NULL;
-    for (sChunkNode* node = chunks.getBuckets()[i]; node != NULL; node = nextnode)
-    {
-      nextnode = node->next;
-      releaseMap(node->chunk->x, node->chunk->z);
-    }
+    releaseMap((*it)->x, (*it)->z);
   }
 
+  // Queued saves still use the storage
+  if (Mineserver::get()->chunkIO() != NULL)
+  {
+    Mineserver::get()->chunkIO()->waitIdle();
+  }
+  delete storage;
+
 
   maps.clear();
   // Free item memory
@@ -263,6 +276,18 @@ void Map::init(int number)
     exit(EXIT_FAILURE);
   }
 
+  std::string format = Mineserver::get()->config()->sData("map.storage.format");
+  if (format.empty())
+  {
+    format = "nbt";
+  }
+  storage = ChunkStorage::create(format, mapDirectory);
+  if (storage == NULL)
+  {
+    LOG(EMERG, "Map", "Error: Unknown map.storage.format \"" + format + "\"");
+    exit(EXIT_FAILURE);
+  }
+
   std::string infile = mapDirectory + "/level.dat";
 
   struct stat stFileInfo;
@@ -370,12 +395,10 @@ bool Map::saveWholeMap()
 {
 
   //Loop every chunk loaded
-  for (int i = 0; i < 441; ++i)
+  const std::vector<sChunk*>& loaded = chunks.getChunks();
+  for (std::vector<sChunk*>::const_iterator it = loaded.begin(); it != loaded.end(); ++it)
   {
-    for (sChunkNode* node = chunks.getBuckets()[i]; node != NULL; node = node->next)
-    {
-      saveMap(node->chunk->x, node->chunk->z);
-    }
+    saveMap((*it)->x, (*it)->z);
   }
   /*
   for(std::map<uint32_t, sChunk>::const_iterator it = maps.begin(); it != maps.end(); ++it)
@@ -440,10 +463,35 @@ bool Map::generateLight(int x, int z)
   return generateLight(x, z, chunk);
 }
 
+int Map::generateQueuedLight(uint32_t budgetMs)
+{
+  const uint32_t start = clockMs();
+  int lit = 0;
+  while (!lightQueue.empty() && (budgetMs == 0 || clockMs() - start < budgetMs))
+  {
+    const std::pair<int, int> pos = lightQueue.front();
+    lightQueue.pop_front();
+
+    // Gone, or lit on the way out already
+    sChunk* chunk = chunks.getChunk(pos.first, pos.second);
+    if (chunk == NULL || !chunk->lightRegen)
+    {
+      continue;
+    }
+
+    generateLight(pos.first, pos.second, chunk);
+    chunk->lightRegen = false;
+    lit++;
+  }
+  return lit;
+}
+
 //#define PRINT_LIGHTGEN_TIME
 
 bool Map::generateLight(int x, int z, sChunk* chunk)
 {
+  PROFILE(Profiler::LIGHT);
+
 #ifdef PRINT_LIGHTGEN_TIME
 #ifdef WIN32
   DWORD t_begin, t_end;
@@ -459,57 +507,10 @@ bool Map::generateLight(int x, int z, sChunk* chunk)
   uint8_t* blocklight = chunk->blocklight;
   uint8_t* heightmap  = chunk->heightmap;
 
-  int highest_y = 0;
-
-  // Clear lightmaps
-  memset(skylight, 0, 16 * 16 * 128 / 2);
+  // Sky light and heightmap, the kernel writes every voxel
+  SkyLight::generate(blocks, stopLight, skylight, heightmap);
   memset(blocklight, 0, 16 * 16 * 128 / 2);
-
-  // Sky light
-  int light = 0;
-  bool foundheight = false;
-  for (int block_x = 0; block_x < 16; block_x++)
-  {
-    for (int block_z = 0; block_z < 16; block_z++)
-    {
-      light = 15;
-      foundheight = false;
-      int32_t blockx_blockz = (block_z << 7) + (block_x << 11);
-
-      for (int block_y = 127; block_y > 0; block_y--)
-      {
-        int index      = block_y + blockx_blockz;
-        int absolute_x = x * 16 + block_x;
-        int absolute_z = z * 16 + block_z;
-        uint8_t block    = blocks[index];
-
-        light -= stopLight[block];
-        if (light < 0)
-        {
-          light = 0;
-        }
-
-        // Calculate heightmap while looping this
-        if ((block != BLOCK_AIR) && (foundheight == false))
-        {
-          heightmap[block_z + (block_x << 4)] = ((block_y == 127) ? block_y : block_y + 1);
-          foundheight = true;
-        }
-
-        if (light < 1)
-        {
-          if (block_y > highest_y)
-          {
-            highest_y = block_y;
-          }
-
-          break;
-        }
-
-        setLight(absolute_x, block_y, absolute_z, light, 0, 1, chunk);
-      }
-    }
-  }
+  chunk->version++;
 
   // Block light
   for (int block_x = 0; block_x < 16; block_x++)
@@ -517,7 +518,8 @@ bool Map::generateLight(int x, int z, sChunk* chunk)
     for (int block_z = 0; block_z < 16; block_z++)
     {
       int32_t blockx_blockz = (block_z << 7) + (block_x << 11);
-      for (int block_y = highest_y; block_y >= 0; block_y--)
+      // Nothing above the heightmap but air
+      for (int block_y = heightmap[block_z + (block_x << 4)]; block_y >= 0; block_y--)
       {
         int index      = block_y + blockx_blockz;
         int absolute_x = x * 16 + block_x;
@@ -683,6 +685,277 @@ bool Map::spreadLight(int x, int y, int z, int skylight, int blocklight, sChunk*
   return true;
 }
 
+namespace
+{
+
+const int lightDirs[6][3] = { {1, 0, 0}, { -1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1} };
+
+inline int lightIndex(int x, int y, int z)
+{
+  return y + (blockToChunkBlock(z) << 7) + (blockToChunkBlock(x) << 11);
+}
+
+inline uint8_t getNibble(const uint8_t* array, int index)
+{
+  return (index & 1) ? (array[index >> 1] >> 4) : (array[index >> 1] & 0x0f);
+}
+
+inline void setNibble(uint8_t* array, int index, uint8_t value)
+{
+  if (index & 1)
+  {
+    array[index >> 1] = (array[index >> 1] & 0x0f) | (value << 4);
+  }
+  else
+  {
+    array[index >> 1] = (array[index >> 1] & 0xf0) | value;
+  }
+}
+
+inline uint8_t* lightArray(int channel, sChunk* chunk)
+{
+  return channel ? chunk->blocklight : chunk->skylight;
+}
+
+inline void writeLight(int channel, sChunk* chunk, int index, uint8_t value)
+{
+  setNibble(lightArray(channel, chunk), index, value);
+  chunk->changed = true;
+  chunk->version++;
+}
+
+}
+
+int Map::sourceLight(int channel, sChunk* chunk, int x, int y, int z)
+{
+  const int column = lightIndex(x, 0, z);
+
+  if (channel == LIGHT_BLOCK)
+  {
+    return emitLight[chunk->blocks[column + y]];
+  }
+
+  // Same falloff as the sky light pass of generateLight
+  int light = 15;
+  for (int block_y = 127; block_y >= y; block_y--)
+  {
+    light -= stopLight[chunk->blocks[column + block_y]];
+    if (light <= 0)
+    {
+      return 0;
+    }
+  }
+  return light;
+}
+
+void Map::removeLight(int channel)
+{
+  for (size_t head = 0; head < m_lightRemove.size(); head++)
+  {
+    const sLightNode node = m_lightRemove[head];
+
+    for (int dir = 0; dir < 6; dir++)
+    {
+      const int x = node.x + lightDirs[dir][0];
+      const int y = node.y + lightDirs[dir][1];
+      const int z = node.z + lightDirs[dir][2];
+      if (y < 0 || y > 127)
+      {
+        continue;
+      }
+
+      sChunk* chunk = chunks.getChunk(blockToChunk(x), blockToChunk(z));
+      if (chunk == NULL)
+      {
+        continue;
+      }
+
+      const int index = lightIndex(x, y, z);
+      const uint8_t light = getNibble(lightArray(channel, chunk), index);
+      if (light == 0)
+      {
+        continue;
+      }
+
+      if (light < node.light)
+      {
+        // May have been lit through the removed voxel
+        writeLight(channel, chunk, index, 0);
+        m_lightRemove.push_back(sLightNode(x, y, z, light));
+
+        const int source = sourceLight(channel, chunk, x, y, z);
+        if (source > 0)
+        {
+          writeLight(channel, chunk, index, source);
+          m_lightAdd.push_back(sLightNode(x, y, z, source));
+        }
+      }
+      else
+      {
+        // Lit some other way, spread it back into the cleared area
+        m_lightAdd.push_back(sLightNode(x, y, z, light));
+      }
+    }
+  }
+
+  m_lightRemove.clear();
+}
+
+void Map::addLight(int channel)
+{
+  for (size_t head = 0; head < m_lightAdd.size(); head++)
+  {
+    const sLightNode node = m_lightAdd[head];
+
+    sChunk* chunk = chunks.getChunk(blockToChunk(node.x), blockToChunk(node.z));
+    if (chunk == NULL)
+    {
+      continue;
+    }
+
+    // Use the current value, the voxel may have been brightened since it was queued
+    const int light = getNibble(lightArray(channel, chunk), lightIndex(node.x, node.y, node.z));
+    if (light <= 1)
+    {
+      continue;
+    }
+
+    for (int dir = 0; dir < 6; dir++)
+    {
+      const int x = node.x + lightDirs[dir][0];
+      const int y = node.y + lightDirs[dir][1];
+      const int z = node.z + lightDirs[dir][2];
+      if (y < 0 || y > 127)
+      {
+        continue;
+      }
+
+      sChunk* neighbour = chunks.getChunk(blockToChunk(x), blockToChunk(z));
+      if (neighbour == NULL)
+      {
+        continue;
+      }
+
+      const int index = lightIndex(x, y, z);
+      const int lightNew = light - stopLight[neighbour->blocks[index]] - 1;
+      if (lightNew > getNibble(lightArray(channel, neighbour), index))
+      {
+        writeLight(channel, neighbour, index, lightNew);
+        m_lightAdd.push_back(sLightNode(x, y, z, lightNew));
+      }
+    }
+  }
+
+  m_lightAdd.clear();
+}
+
+void Map::updateLight(int x, int y, int z, uint8_t oldType)
+{
+  sChunk* chunk = chunks.getChunk(blockToChunk(x), blockToChunk(z));
+  if (chunk == NULL)
+  {
+    return;
+  }
+
+  const int column  = lightIndex(x, 0, z);
+  const int index   = column + y;
+  const uint8_t newType = chunk->blocks[index];
+
+  // Heightmap of the changed column
+  int height = 0;
+  for (int block_y = 127; block_y >= 0; block_y--)
+  {
+    if (chunk->blocks[column + block_y] != BLOCK_AIR)
+    {
+      height = (block_y == 127) ? block_y : block_y + 1;
+      break;
+    }
+  }
+  chunk->heightmap[blockToChunkBlock(z) + (blockToChunkBlock(x) << 4)] = height;
+
+  if (emitLight[oldType] == emitLight[newType] && stopLight[oldType] == stopLight[newType])
+  {
+    return;
+  }
+
+  // Block light: clear what the old block lit or passed on, then relight
+  m_lightRemove.push_back(sLightNode(x, y, z, getNibble(chunk->blocklight, index)));
+  writeLight(LIGHT_BLOCK, chunk, index, 0);
+  removeLight(LIGHT_BLOCK);
+
+  if (emitLight[newType] > 0)
+  {
+    writeLight(LIGHT_BLOCK, chunk, index, emitLight[newType]);
+    m_lightAdd.push_back(sLightNode(x, y, z, emitLight[newType]));
+  }
+  for (int dir = 0; dir < 6; dir++)
+  {
+    m_lightAdd.push_back(sLightNode(x + lightDirs[dir][0], y + lightDirs[dir][1], z + lightDirs[dir][2], 0));
+  }
+  addLight(LIGHT_BLOCK);
+
+  // Sky light: compare direct light below the change before and after it
+  int lightOld = 15;
+  int lightNew;
+  for (int block_y = 127; block_y > y; block_y--)
+  {
+    lightOld -= stopLight[chunk->blocks[column + block_y]];
+    if (lightOld <= 0)
+    {
+      break;
+    }
+  }
+  if (lightOld < 0)
+  {
+    lightOld = 0;
+  }
+  lightNew = lightOld;
+
+  // The changed voxel itself is always cleared, it may have been lit from the side
+  for (int block_y = y; block_y >= 0 && (block_y == y || lightOld > 0); block_y--)
+  {
+    const uint8_t block = chunk->blocks[column + block_y];
+    lightOld -= stopLight[block_y == y ? oldType : block];
+    lightNew -= stopLight[block];
+    if (lightOld < 0)
+    {
+      lightOld = 0;
+    }
+    if (lightNew < 0)
+    {
+      lightNew = 0;
+    }
+
+    const uint8_t current = getNibble(chunk->skylight, column + block_y);
+    if (current > 0 && (block_y == y || lightNew < lightOld))
+    {
+      m_lightRemove.push_back(sLightNode(x, block_y, z, current));
+      writeLight(LIGHT_SKY, chunk, column + block_y, 0);
+    }
+  }
+  removeLight(LIGHT_SKY);
+
+  lightNew = 15;
+  for (int block_y = 127; block_y >= 0; block_y--)
+  {
+    lightNew -= stopLight[chunk->blocks[column + block_y]];
+    if (lightNew <= 0)
+    {
+      break;
+    }
+    if (block_y <= y && lightNew > getNibble(chunk->skylight, column + block_y))
+    {
+      writeLight(LIGHT_SKY, chunk, column + block_y, lightNew);
+      m_lightAdd.push_back(sLightNode(x, block_y, z, lightNew));
+    }
+  }
+  for (int dir = 0; dir < 6; dir++)
+  {
+    m_lightAdd.push_back(sLightNode(x + lightDirs[dir][0], y + lightDirs[dir][1], z + lightDirs[dir][2], 0));
+  }
+  addLight(LIGHT_SKY);
+}
+
 bool Map::getBlock(int x, int y, int z, uint8_t* type, uint8_t* meta, bool generate)
 {
   if ((y < 0) || (y > 127))
@@ -695,7 +968,13 @@ bool Map::getBlock(int x, int y, int z, uint8_t* type, uint8_t* meta, bool gener
   int chunk_x = blockToChunk(x);
   int chunk_z = blockToChunk(z);
 
-  sChunk* chunk = getMapData(chunk_x, chunk_z, generate);
+  // Resident chunks (the common case) skip the getMapData call
+  sChunk* chunk = chunks.getChunk(chunk_x, chunk_z);
+
+  if (!chunk)
+  {
+    chunk = getMapData(chunk_x, chunk_z, generate);
+  }
 
   if (!chunk)
   {
@@ -732,7 +1011,7 @@ bool Map::getBlock(int x, int y, int z, uint8_t* type, uint8_t* meta, bool gener
   }
 
   *meta              = metadata;
-  chunk->lastused    = (int)time(0);
+  chunk->lastused    = tickTime;
 
   return true;
 }
@@ -863,6 +1142,8 @@ bool Map::setLight(int x, int y, int z, int skylight, int blocklight, int type,
     blocklightPtr[index >> 1] = blocklight_local;
   }
 
+  chunk->version++;
+
   return true;
 }
 
@@ -878,7 +1159,12 @@ bool Map::setBlock(int x, int y, int z, char type, char meta)
   int chunk_x = blockToChunk(x);
   int chunk_z = blockToChunk(z);
 
-  sChunk* chunk = getMapData(chunk_x, chunk_z, true);
+  sChunk* chunk = chunks.getChunk(chunk_x, chunk_z);
+
+  if (!chunk)
+  {
+    chunk = getMapData(chunk_x, chunk_z, true);
+  }
 
   if (!chunk)
   {
@@ -893,6 +1179,7 @@ bool Map::setBlock(int x, int y, int z, char type, char meta)
   uint8_t* blocks      = chunk->blocks;
   uint8_t* metapointer = chunk->data;
   int index          = y + (chunk_block_z << 7) + (chunk_block_x << 11);
+  uint8_t oldType    = blocks[index];
   blocks[index] = type;
   char metadata      = metapointer[index >> 1];
 
@@ -909,8 +1196,14 @@ bool Map::setBlock(int x, int y, int z, char type, char meta)
   metapointer[index >> 1] = metadata;
 
   chunk->changed       = true;
-  chunk->lightRegen    = true;
-  chunk->lastused      = (int)time(NULL);
+  chunk->lastused      = tickTime;
+  chunk->version++;
+
+  // A chunk still waiting for its light gets all of it at once later
+  if (oldType != static_cast<uint8_t>(type) && !chunk->lightRegen)
+  {
+    updateLight(x, y, z, oldType);
+  }
 
   if (type == BLOCK_AIR)
   {
@@ -938,20 +1231,118 @@ bool Map::setBlock(int x, int y, int z, char type, char meta)
 
 bool Map::sendBlockChange(int x, int y, int z, char type, char meta)
 {
-  Packet pkt;
-  pkt << PACKET_BLOCK_CHANGE << (int32_t)x << (int8_t)y << (int32_t)z << (int8_t)type << (int8_t)meta;
+  if (y < 0 || y > 127)
+  {
+    return false;
+  }
 
-  sChunk* chunk = chunks.getChunk(blockToChunk(x), blockToChunk(z));
+  const int chunk_x = blockToChunk(x);
+  const int chunk_z = blockToChunk(z);
+  sChunk* chunk = chunks.getChunk(chunk_x, chunk_z);
   if (chunk == NULL)
   {
     return false;
   }
 
-  chunk->sendPacket(pkt);
+  if (chunk->blockChanges.empty())
+  {
+    m_changedChunks.push_back(std::make_pair(chunk_x, chunk_z));
+  }
+
+  sBlockChange change;
+  change.offset = (uint16_t)(((x - chunk_x * 16) << 12) | ((z - chunk_z * 16) << 8) | y);
+  change.type   = type;
+  change.meta   = meta;
+  chunk->blockChanges.push_back(change);
 
   return true;
 }
 
+namespace
+{
+bool blockChangeBefore(const sBlockChange& a, const sBlockChange& b)
+{
+  return a.offset < b.offset;
+}
+}
+
+void Map::flushBlockChanges()
+{
+  for (std::vector<std::pair<int, int> >::size_type i = 0; i < m_changedChunks.size(); i++)
+  {
+    // Changes to chunks unloaded since then went with them
+    sChunk* chunk = chunks.getChunk(m_changedChunks[i].first, m_changedChunks[i].second);
+    if (chunk != NULL && !chunk->blockChanges.empty())
+    {
+      flushBlockChanges(chunk);
+    }
+  }
+  m_changedChunks.clear();
+}
+
+void Map::flushBlockChanges(sChunk* chunk)
+{
+  std::vector<sBlockChange>& changes = chunk->blockChanges;
+
+  // Only the last change to each block is sent
+  if (changes.size() > 1)
+  {
+    std::stable_sort(changes.begin(), changes.end(), blockChangeBefore);
+    std::vector<sBlockChange>::size_type last = 0;
+    for (std::vector<sBlockChange>::size_type i = 1; i < changes.size(); i++)
+    {
+      if (changes[i].offset != changes[last].offset)
+      {
+        last++;
+      }
+      changes[last] = changes[i];
+    }
+    changes.resize(last + 1);
+  }
+
+  Packet pkt;
+  if (changes.size() == 1)
+  {
+    const sBlockChange& change = changes[0];
+    pkt << (int8_t)PACKET_BLOCK_CHANGE
+        << (int32_t)(chunk->x * 16 + (change.offset >> 12)) << (int8_t)(change.offset & 0x7f)
+        << (int32_t)(chunk->z * 16 + ((change.offset >> 8) & 0xf))
+        << change.type << change.meta;
+    chunk->sendPacket(pkt);
+  }
+  else if (changes.size() <= MULTI_BLOCK_CHANGE_MAX)
+  {
+    pkt << (int8_t)PACKET_MULTI_BLOCK_CHANGE << (int32_t)chunk->x << (int32_t)chunk->z
+        << (int16_t)changes.size();
+    for (std::vector<sBlockChange>::size_type i = 0; i < changes.size(); i++)
+    {
+      pkt << (int16_t)changes[i].offset;
+    }
+    for (std::vector<sBlockChange>::size_type i = 0; i < changes.size(); i++)
+    {
+      pkt << changes[i].type;
+    }
+    for (std::vector<sBlockChange>::size_type i = 0; i < changes.size(); i++)
+    {
+      pkt << changes[i].meta;
+    }
+    chunk->sendPacket(pkt);
+  }
+  else
+  {
+    std::set<User*>::const_iterator it = chunk->users.begin();
+    for (; it != chunk->users.end(); ++it)
+    {
+      if ((*it)->logged)
+      {
+        sendToUser(*it, chunk->x, chunk->z);
+      }
+    }
+  }
+
+  changes.clear();
+}
+
 bool Map::sendNote(int x, int y, int z, char instrument, char pitch)
 {
   Packet pkt;
@@ -1072,91 +1463,133 @@ sChunk*  Map::loadMap(int x, int z, bool generate)
     return chunk;
   }
 
-  // Generate map file name
-
-  int mapposx = x;
-  int modulox = mapposx & 0x3F;
+  const uint64_t key = ChunkMap::key(x, z);
+  if (failedChunks.count(key))
+  {
+    return NULL;
+  }
 
-  int mapposz = z;
-  int moduloz = mapposz & 0x3F;
+  // The file may still be waiting in the I/O queue
+  ChunkIO* chunkIO = Mineserver::get()->chunkIO();
+  if (chunkIO != NULL && savingChunks.count(key))
+  {
+    chunkIO->waitIdle();
+  }
 
-  std::string infile = mapDirectory + "/" + base36_encode(modulox) + "/" + base36_encode(moduloz) + "/c." + base36_encode(mapposx) + "." + base36_encode(mapposz) + ".dat";
+  ChunkIOJob job;
+  job.type = ChunkIOJob::LOAD;
+  job.x    = x;
+  job.z    = z;
+  job.storage = storage;
+  ChunkIO::run(&job);
+  Mineserver::get()->profiler()->record(Profiler::CHUNK_LOAD, job.micros);
 
-  struct stat stFileInfo;
-  if (stat(infile.c_str(), &stFileInfo) != 0)
+  if (job.missing)
   {
     // If generate (false only for lightmapgenerator)
     if (generate)
     {
-      //chunk = new sChunk;
-      // Re-seed! We share map gens with other maps
-      Mineserver::get()->mapGen(m_number)->init((int32_t)mapSeed);
-      Mineserver::get()->mapGen(m_number)->generateChunk(x, z, m_number);
-      generateLight(x, z);
-      bool foundLand = false;
-      uint8_t block, meta;
-      int spx = spawnPos.x(), spy = 120, spz = spawnPos.z();
-      while (!foundLand)
+      return generateMap(x, z);
+    }
+    else
+    {
+      return NULL;
+    }
+  }
+
+  chunk = linkMap(x, z, job.nbt);
+  if (chunk == NULL)
+  {
+    chunkFailed(x, z);
+  }
+  return chunk;
+}
+
+void Map::chunkFailed(int x, int z)
+{
+  LOG(WARNING, "Map", "Leaving out chunk " + dtos(x) + "," + dtos(z) + " of " + mapDirectory + ", it could not be loaded");
+  failedChunks.insert(ChunkMap::key(x, z));
+}
+
+sChunk* Map::generateMap(int x, int z)
+{
+  // Re-seed! We share map gens with other maps
+  {
+    PROFILE(Profiler::CHUNK_GEN);
+    Mineserver::get()->mapGen(m_number)->init((int32_t)mapSeed);
+    Mineserver::get()->mapGen(m_number)->generateChunk(x, z, m_number);
+  }
+  chunksGenerated++;
+
+  // Lit later, when there's time for it
+  sChunk* chunk = chunks.getChunk(x, z);
+  if (chunk != NULL)
+  {
+    chunk->lightRegen = true;
+    lightQueue.push_back(std::make_pair(x, z));
+  }
+
+  bool foundLand = false;
+  uint8_t block, meta;
+  int spx = spawnPos.x(), spy = 120, spz = spawnPos.z();
+  while (!foundLand)
+  {
+    spx++;
+    for (int count = 0; count < 110; count++)
+    {
+      if (getBlock(spx, spy - count, spz, &block, &meta))
       {
-        spx++;
-        for (int count = 0; count < 110; count++)
+        switch (block)
         {
-          if (getBlock(spx, spy - count, spz, &block, &meta))
-          {
-            switch (block)
-            {
-            case BLOCK_AIR:
-            case BLOCK_RED_ROSE:
-            case BLOCK_YELLOW_FLOWER:
-            case BLOCK_BROWN_MUSHROOM:
-            case BLOCK_RED_MUSHROOM:
-              // Not ground
-              continue;
-              break; // Does this matter here?
-            case BLOCK_GRASS:
-            case BLOCK_DIRT:
-            case BLOCK_SAND:
-            case BLOCK_NETHERSTONE:
-            case BLOCK_GRAY_CLOTH:
-              // Ground
-              foundLand = true;
-              spy = (spy - count) + 2;
-              break;
-            default:
-              count = 110;
-              continue;
-              break;
-            }
-          }
+        case BLOCK_AIR:
+        case BLOCK_RED_ROSE:
+        case BLOCK_YELLOW_FLOWER:
+        case BLOCK_BROWN_MUSHROOM:
+        case BLOCK_RED_MUSHROOM:
+          // Not ground
+          continue;
+          break; // Does this matter here?
+        case BLOCK_GRASS:
+        case BLOCK_DIRT:
+        case BLOCK_SAND:
+        case BLOCK_NETHERSTONE:
+        case BLOCK_GRAY_CLOTH:
+          // Ground
+          foundLand = true;
+          spy = (spy - count) + 2;
+          break;
+        default:
+          count = 110;
+          continue;
+          break;
         }
       }
-      spawnPos.y() = spy;
-      spawnPos.x() = spx;
-      spawnPos.z() = spz;
-      std::string infile = mapDirectory + "/level.dat";
-      NBT_Value* root = NBT_Value::LoadFromFile(infile);
-      if (root != NULL)
-      {
-        NBT_Value& data = *((*root)["Data"]);
-        *data["SpawnX"] = (int32_t)spawnPos.x();
-        *data["SpawnY"] = (int32_t)spawnPos.y();
-        *data["SpawnZ"] = (int32_t)spawnPos.z();
+    }
+  }
+  spawnPos.y() = spy;
+  spawnPos.x() = spx;
+  spawnPos.z() = spz;
+  std::string infile = mapDirectory + "/level.dat";
+  NBT_Value* root = NBT_Value::LoadFromFile(infile);
+  if (root != NULL)
+  {
+    NBT_Value& data = *((*root)["Data"]);
+    *data["SpawnX"] = (int32_t)spawnPos.x();
+    *data["SpawnY"] = (int32_t)spawnPos.y();
+    *data["SpawnZ"] = (int32_t)spawnPos.z();
 
-        root->SaveToFile(infile);
+    root->SaveToFile(infile);
 
-        delete root;
-      }
-      return chunks.getChunk(x, z);
-    }
-    else
-    {
-      return NULL;
-    }
+    delete root;
   }
+  return chunks.getChunk(x, z);
+}
 
-  chunk = new sChunk();
+sChunk* Map::linkMap(int x, int z, NBT_Value* nbt)
+{
+  sChunk* chunk = new sChunk();
 
-  chunk->nbt = NBT_Value::LoadFromFile(infile.c_str());
+  chunk->nbt = nbt;
 
 
   if (chunk->nbt == NULL)
@@ -1404,50 +1837,9 @@ bool Map::saveMap(int x, int z)
   if (chunk->lightRegen)
   {
     generateLight(x, z, chunk);
+    chunk->lightRegen = false;
   }
 
-  // Generate map file name
-
-  int mapposx = x;
-  int modulox = mapposx & 0x3F;
-
-  int mapposz = z;
-  int moduloz = mapposz & 0x3F;
-
-  std::string outfile = mapDirectory + "/" + base36_encode(modulox) + "/" + base36_encode(moduloz) + "/c." +
-                        base36_encode(mapposx) + "." + base36_encode(mapposz) + ".dat";
-
-  // Try to create parent directories if necessary
-  struct stat stFileInfo;
-  if (stat(outfile.c_str(), &stFileInfo) != 0)
-  {
-    std::string outdir_a = mapDirectory + "/" + base36_encode(modulox);
-    std::string outdir_b = mapDirectory + "/" + base36_encode(modulox) + "/" + base36_encode(moduloz);
-
-    if (stat(outdir_b.c_str(), &stFileInfo) != 0)
-    {
-      if (stat(outdir_a.c_str(), &stFileInfo) != 0)
-      {
-#ifdef WIN32
-        if (_mkdir(outdir_a.c_str()) == -1)
-#else
-        if (mkdir(outdir_a.c_str(), 0755) == -1)
-#endif
-
-          return false;
-      }
-
-#ifdef WIN32
-      if (_mkdir(outdir_b.c_str()) == -1)
-#else
-      if (mkdir(outdir_b.c_str(), 0755) == -1)
-#endif
-
-        return false;
-    }
-  }
-
-
   NBT_Value* entityList = (*(*chunk->nbt)["Level"])["TileEntities"];
 
   if (!entityList)
@@ -1528,13 +1920,110 @@ bool Map::saveMap(int x, int z)
   }
 
 
-  chunk->nbt->SaveToFile(outfile);
+  ChunkIOJob* job = new ChunkIOJob;
+  job->type = ChunkIOJob::SAVE;
+  job->map  = m_number;
+  job->x    = x;
+  job->z    = z;
+  job->storage = storage;
+  chunk->nbt->SaveToMemory(job->data);
 
   // Set "not changed"
   chunk->changed    = false;
   chunk->lightRegen = false;
 
-  return true;
+  ChunkIO* chunkIO = Mineserver::get()->chunkIO();
+  if (chunkIO != NULL && chunkIO->enabled())
+  {
+    savingChunks[ChunkMap::key(x, z)]++;
+    chunkIO->submit(job);
+    return true;
+  }
+
+  ChunkIO::run(job);
+  Mineserver::get()->profiler()->record(Profiler::CHUNK_SAVE, job->micros);
+  bool ok = job->ok;
+  delete job;
+
+  return ok;
+}
+
+bool Map::requestMap(int x, int z)
+{
+  if (chunks.getChunk(x, z) != NULL)
+  {
+    return true;
+  }
+
+  ChunkIO* chunkIO = Mineserver::get()->chunkIO();
+  if (chunkIO == NULL || !chunkIO->enabled())
+  {
+    return loadMap(x, z) != NULL;
+  }
+
+  // Broken chunks are not sent, there is nothing to wait for
+  const uint64_t key = ChunkMap::key(x, z);
+  if (failedChunks.count(key))
+  {
+    return true;
+  }
+
+  // Jobs run in order, so a load queued after a pending save reads the new file
+  if (loadingChunks.count(key) == 0)
+  {
+    loadingChunks.insert(key);
+
+    ChunkIOJob* job = new ChunkIOJob;
+    job->type = ChunkIOJob::LOAD;
+    job->map  = m_number;
+    job->x    = x;
+    job->z    = z;
+    job->storage = storage;
+    chunkIO->submit(job);
+  }
+
+  return false;
+}
+
+void Map::chunkLoaded(ChunkIOJob* job)
+{
+  Mineserver::get()->profiler()->record(Profiler::CHUNK_LOAD, job->micros);
+  loadingChunks.erase(ChunkMap::key(job->x, job->z));
+
+  // Someone needed it right away and loaded it synchronously
+  if (chunks.getChunk(job->x, job->z) != NULL)
+  {
+    delete job->nbt;
+    job->nbt = NULL;
+    return;
+  }
+
+  if (job->missing)
+  {
+    generateMap(job->x, job->z);
+    return;
+  }
+
+  if (linkMap(job->x, job->z, job->nbt) == NULL)
+  {
+    chunkFailed(job->x, job->z);
+  }
+  job->nbt = NULL;
+}
+
+void Map::chunkSaved(ChunkIOJob* job)
+{
+  Mineserver::get()->profiler()->record(Profiler::CHUNK_SAVE, job->micros);
+  std::map<uint64_t, int>::iterator saving = savingChunks.find(ChunkMap::key(job->x, job->z));
+  if (saving != savingChunks.end() && --saving->second <= 0)
+  {
+    savingChunks.erase(saving);
+  }
+
+  if (!job->ok)
+  {
+    LOG(ERROR, "Map", "Could not save chunk " + dtos(job->x) + "," + dtos(job->z) + " of " + mapDirectory);
+  }
 }
 
 bool Map::releaseMap(int x, int z)
@@ -1565,11 +2054,6 @@ void Map::sendToUser(User* user, int x, int z, bool login)
     return;
   }
 
-  uint8_t* data4   = new uint8_t[18 + 81920];
-  uint8_t* mapdata = new uint8_t[81920];
-  int32_t mapposx    = x;
-  int32_t mapposz    = z;
-
   //Regenerate lighting if needed
   if (chunk->lightRegen)
   {
@@ -1577,24 +2061,69 @@ void Map::sendToUser(User* user, int x, int z, bool login)
     chunk->lightRegen = false;
   }
 
+  // Only deflate again if the chunk changed since the last send
+  if (chunk->compressed.empty() || chunk->compressedVersion != chunk->version)
+  {
+    ChunkCompressor* compressor = Mineserver::get()->chunkCompressor();
+    // Login chunks have to be in loginBuffer before the spawn packets
+    const bool async = !login && compressor != NULL && compressor->enabled();
 
-  // Chunk
-  (*p) << (int8_t)PACKET_MAP_CHUNK << (int32_t)(mapposx * 16) << (int16_t)0 << (int32_t)(mapposz * 16)
-       << (int8_t)15 << (int8_t)127 << (int8_t)15;
+    const uint64_t key = ChunkMap::key(x, z);
+    std::map<uint64_t, sPendingChunk>::iterator pending = pendingChunks.find(key);
+    if (async && pending != pendingChunks.end() && pending->second.version == chunk->version)
+    {
+      // Already on its way, just wait for it
+      pending->second.users.push_back(std::make_pair(user, user->UID));
+      chunkCacheHits++;
+      return;
+    }
+
+    ChunkCompressJob* job = new ChunkCompressJob;
+    job->map     = m_number;
+    job->x       = x;
+    job->z       = z;
+    job->version = chunk->version;
 
-  memcpy(&mapdata[0], chunk->blocks, 32768);
-  memcpy(&mapdata[32768], chunk->data, 16384);
-  memcpy(&mapdata[32768 + 16384], chunk->blocklight, 16384);
-  memcpy(&mapdata[32768 + 16384 + 16384], chunk->skylight, 16384);
+    memcpy(&job->raw[0], chunk->blocks, 32768);
+    memcpy(&job->raw[32768], chunk->data, 16384);
+    memcpy(&job->raw[32768 + 16384], chunk->blocklight, 16384);
+    memcpy(&job->raw[32768 + 16384 + 16384], chunk->skylight, 16384);
 
-  uLongf written = 81920;
-  Bytef* buffer = new Bytef[written];
+    chunkCacheMisses++;
 
-  // Compress data with zlib deflate
-  compress(buffer, &written, &mapdata[0], 81920);
+    if (async)
+    {
+      sPendingChunk& entry = pendingChunks[key];
+      entry.version = chunk->version;
+      entry.users.push_back(std::make_pair(user, user->UID));
+      compressor->submit(job);
+      return;
+    }
+
+    {
+      PROFILE(Profiler::COMPRESS);
+      ChunkCompressor::deflate(job->raw, chunk->compressed);
+    }
+    chunk->compressedVersion = chunk->version;
+
+    delete job;
+  }
+  else
+  {
+    chunkCacheHits++;
+  }
 
-  (*p) << (int32_t)written;
-  (*p).addToWrite(buffer, written);
+  writeChunk(p, chunk, x, z);
+}
+
+void Map::writeChunk(Packet* p, sChunk* chunk, int x, int z)
+{
+  // Chunk
+  (*p) << (int8_t)PACKET_MAP_CHUNK << (int32_t)(x * 16) << (int16_t)0 << (int32_t)(z * 16)
+       << (int8_t)15 << (int8_t)127 << (int8_t)15;
+
+  (*p) << (int32_t)chunk->compressed.size();
+  (*p).addToWrite(&chunk->compressed[0], chunk->compressed.size());
 
   //Push sign data to player
   for (uint32_t i = 0; i < chunk->signs.size(); i++)
@@ -1602,11 +2131,50 @@ void Map::sendToUser(User* user, int x, int z, bool login)
     (*p) << (int8_t)PACKET_SIGN << chunk->signs[i]->x << (int16_t)chunk->signs[i]->y << chunk->signs[i]->z;
     (*p) << chunk->signs[i]->text1 << chunk->signs[i]->text2 << chunk->signs[i]->text3 << chunk->signs[i]->text4;
   }
+}
 
 
-  delete [] buffer;
+void Map::chunkCompressed(ChunkCompressJob* job)
+{
+  Mineserver::get()->profiler()->record(Profiler::COMPRESS, job->micros);
 
-  delete[] data4;
-  delete[] mapdata;
-}
+  std::map<uint64_t, sPendingChunk>::iterator pending = pendingChunks.find(ChunkMap::key(job->x, job->z));
+  // A newer snapshot was submitted after this one, wait for that instead
+  if (pending == pendingChunks.end() || pending->second.version != job->version)
+  {
+    return;
+  }
+
+  std::vector<std::pair<User*, uint32_t> > users;
+  users.swap(pending->second.users);
+  pendingChunks.erase(pending);
+
+  sChunk* chunk = chunks.getChunk(job->x, job->z);
+  if (chunk == NULL)
+  {
+    return;
+  }
 
+  if (chunk->version == job->version)
+  {
+    chunk->compressed.swap(job->compressed);
+    chunk->compressedVersion = job->version;
+  }
+
+  for (std::vector<std::pair<User*, uint32_t> >::size_type i = 0; i < users.size(); i++)
+  {
+    // Only users still holding the chunk are alive and still want it
+    if (chunk->users.count(users[i].first) && users[i].first->UID == users[i].second)
+    {
+      if (chunk->compressedVersion == chunk->version && !chunk->compressed.empty())
+      {
+        writeChunk(&users[i].first->buffer, chunk, job->x, job->z);
+      }
+      else
+      {
+        // Changed while compressing, take a new snapshot
+        sendToUser(users[i].first, job->x, job->z);
+      }
+    }
+  }
+}
@@ -29,13 +29,19 @@
 #define _MAP_H_
 
 #include <map>
+#include <set>
 #include <list>
+#include <deque>
 #include <ctime>
 
 #include "vec.h"
 #include "chunkmap.h"
 
 class User;
+struct ChunkCompressJob;
+struct ChunkIOJob;
+class NBT_Value;
+class ChunkStorage;
 
 struct sTree
 {
@@ -48,6 +54,15 @@ struct sTree
     plantedTime(_plantedTime), plantedBy(_plantedBy) {}
 };
 
+struct sLightNode
+{
+  int32_t x, y, z;
+  uint8_t light;
+
+  sLightNode(int32_t _x, int32_t _y, int32_t _z, uint8_t _light) :
+    x(_x), y(_y), z(_z), light(_light) {}
+};
+
 class Map
 {
 public:
@@ -57,6 +72,9 @@ public:
 
   std::string mapDirectory;
 
+  // Chunk file backend, chosen by map.storage.format
+  ChunkStorage* storage;
+
   // List of saplings ready to grow
   std::list<sTree> saplings;
   void addSapling(User* user, int x, int y, int z);
@@ -101,6 +119,26 @@ public:
   void init(int number);
   void sendToUser(User* user, int x, int z, bool login = false);
 
+  // MAP_CHUNK payload cache counters
+  uint64_t chunkCacheHits;
+  uint64_t chunkCacheMisses;
+  // Chunks generated since the start
+  uint64_t chunksGenerated;
+
+  // Users waiting for a chunk that is being compressed by a worker
+  struct sPendingChunk
+  {
+    uint32_t version;
+    std::vector<std::pair<User*, uint32_t> > users; // user, UID
+  };
+  std::map<uint64_t, sPendingChunk> pendingChunks;
+
+  // Finish the sends waiting for a worker compressed chunk
+  void chunkCompressed(ChunkCompressJob* job);
+
+  // Write the cached MAP_CHUNK payload and sign data of a chunk
+  void writeChunk(Packet* p, sChunk* chunk, int x, int z);
+
   //Time in the map
   int64_t mapTime;
 
@@ -113,9 +151,22 @@ public:
   // Load map chunk
   sChunk* loadMap(int x, int z, bool generate = true);
 
+  // Load map chunk in the background, true once it is in memory or failed
+  bool requestMap(int x, int z);
+
   // Save map chunk to disc
   bool saveMap(int x, int z);
 
+  // Chunk I/O completions from the main loop
+  void chunkLoaded(ChunkIOJob* job);
+  void chunkSaved(ChunkIOJob* job);
+
+  // Chunks with a queued load or save
+  std::set<uint64_t> loadingChunks;
+  std::map<uint64_t, int> savingChunks;
+  // Chunks that could not be read, left out rather than read again
+  std::set<uint64_t> failedChunks;
+
   // Save whole map to disc (/save command)
   bool saveWholeMap();
 
@@ -123,9 +174,24 @@ public:
   bool generateLight(int x, int z);
   bool generateLight(int x, int z, sChunk* chunk);
 
+  // Generated chunks waiting for their light. They get it from the tick
+  // that has time for it, or when sent or saved, whichever comes first.
+  std::deque<std::pair<int, int> > lightQueue;
+  // Light queued chunks until budgetMs is used up, 0 for all of them.
+  // Returns how many were lit.
+  int generateQueuedLight(uint32_t budgetMs);
+
   // Release/save map chunk
   bool releaseMap(int x, int z);
 
+  // Generate a missing chunk
+  sChunk* generateMap(int x, int z);
+
+  // Build and link a chunk from its loaded NBT, takes ownership of nbt
+  sChunk* linkMap(int x, int z, NBT_Value* nbt);
+  // Remember a chunk that failed to load so it is not read again
+  void chunkFailed(int x, int z);
+
   // Light get/set
   bool getLight(int x, int y, int z, uint8_t* blocklight, uint8_t* skylight);
   bool getLight(int x, int y, int z, uint8_t* blocklight, uint8_t* skylight, sChunk* chunk);
@@ -134,6 +200,9 @@ public:
   bool spreadLight(int x, int y, int z, int skylight, int blocklight);
   bool spreadLight(int x, int y, int z, int skylight, int blocklight, sChunk* chunk);
 
+  // Relight only the area affected by a block change, across chunk borders
+  void updateLight(int x, int y, int z, uint8_t oldType);
+
   // Block value/meta get/set
   bool getBlock(int x, int y, int z, uint8_t* type, uint8_t* meta, bool generate = true);
   bool getBlock(int x, int y, int z, uint8_t* type, uint8_t* meta, bool generate, sChunk* chunk);
@@ -147,11 +216,15 @@ public:
     return setBlock(pos.x(), pos.y(), pos.z(), type, meta);
   }
 
+  // Queued per chunk until flushBlockChanges()
   bool sendBlockChange(int x, int y, int z, char type, char meta);
   bool sendBlockChange(vec pos, char type, char meta)
   {
     return sendBlockChange(pos.x(), pos.y(), pos.z(), type, meta);
   }
+  // Send every chunk's queued changes as one block change, one multi block
+  // change or, with too many, the whole chunk again
+  void flushBlockChanges();
   bool sendNote(int x, int y, int z, char instrument, char pitch);
   bool sendNote(vec pos, char instrument, char pitch)
   {
@@ -162,6 +235,26 @@ public:
   void createPickupSpawn(int x, int y, int z, int type, int count, int health, User* user);
 
   bool sendProjectileSpawn(User* user, int8_t projID);
+
+private:
+  enum { LIGHT_SKY, LIGHT_BLOCK };
+
+  // More changes than this in a chunk and it's sent again instead
+  enum { MULTI_BLOCK_CHANGE_MAX = 64 };
+
+  void flushBlockChanges(sChunk* chunk);
+
+  // Chunks with queued block changes
+  std::vector<std::pair<int, int> > m_changedChunks;
+
+  // Light a voxel gets on its own: emitted block light or direct sky light
+  int sourceLight(int channel, sChunk* chunk, int x, int y, int z);
+  void removeLight(int channel);
+  void addLight(int channel);
+
+  // BFS queues for updateLight, kept to reuse their memory
+  std::vector<sLightNode> m_lightRemove;
+  std::vector<sLightNode> m_lightAdd;
 };
 
 #endif
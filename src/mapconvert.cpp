@@ -0,0 +1,97 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Moves a world between chunk storage formats:
+//   mapconvert <world directory> <nbt|region>
+// Chunks are copied from the other format, the source files are left alone.
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "chunkstorage.h"
+
+int main(int argc, char* argv[])
+{
+  if (argc != 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " <world directory> <nbt|region>" << std::endl;
+    return 1;
+  }
+
+  const std::string directory(argv[1]);
+  const std::string to(argv[2]);
+  const std::string from(to == "region" ? "nbt" : "region");
+
+  ChunkStorage* source = ChunkStorage::create(from, directory);
+  ChunkStorage* target = ChunkStorage::create(to, directory);
+  if (source == NULL || target == NULL)
+  {
+    std::cerr << "Unknown storage format \"" << to << "\"" << std::endl;
+    delete source;
+    delete target;
+    return 1;
+  }
+
+  std::vector<std::pair<int, int> > chunks;
+  if (!source->list(chunks))
+  {
+    std::cerr << "Could not read " << from << " chunks from " << directory << std::endl;
+    delete source;
+    delete target;
+    return 1;
+  }
+
+  std::cout << "Converting " << chunks.size() << " chunks from " << from << " to " << to << std::endl;
+
+  size_t converted = 0;
+  std::vector<uint8_t> data;
+  for (std::vector<std::pair<int, int> >::size_type i = 0; i < chunks.size(); i++)
+  {
+    const int x = chunks[i].first;
+    const int z = chunks[i].second;
+    bool missing;
+
+    data.clear();
+    if (!source->load(x, z, data, missing) || !target->save(x, z, data))
+    {
+      std::cerr << "Failed to convert chunk " << x << "," << z << std::endl;
+      continue;
+    }
+    converted++;
+  }
+
+  std::cout << converted << "/" << chunks.size() << " chunks converted" << std::endl;
+  std::cout << "Set map.storage.format = \"" << to << "\"; in config.cfg to use them" << std::endl;
+
+  delete source;
+  delete target;
+
+  return converted == chunks.size() ? 0 : 1;
+}
@@ -0,0 +1,438 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef WIN32
+#include <winsock2.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <algorithm>
+
+#include "tools.h"
+#include "logger.h"
+#include "mineserver.h"
+#include "map.h"
+#include "physics.h"
+#include "user.h"
+#include "netthreads.h"
+#include "sockets.h"
+#include "metrics.h"
+
+extern int setnonblock(int fd);
+
+namespace
+{
+
+// Scrapers at a time, and how much of a request is read at most
+const size_t MAX_CLIENTS = 16;
+const size_t MAX_REQUEST = 8192;
+// A scrape has this many seconds to finish
+const int CLIENT_TIMEOUT = 5;
+
+// A scraper hanging up mid-response must not raise SIGPIPE. Where send()
+// has no flag for it, acceptCallback() sets SO_NOSIGPIPE on the socket.
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+// The last recv() or send() failed only because it would have blocked
+bool wouldBlock()
+{
+#ifdef WIN32
+  return ERROR_NUMBER == WSAEWOULDBLOCK || ERROR_NUMBER == WSAEINTR;
+#else
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+void closeFd(int fd)
+{
+#ifdef WIN32
+  closesocket(fd);
+#else
+  close(fd);
+#endif
+}
+
+void describe(std::ostream& out, const char* name, const char* type, const char* help)
+{
+  out << "# HELP " << name << " " << help << "\n";
+  out << "# TYPE " << name << " " << type << "\n";
+}
+
+}
+
+struct Metrics::Client
+{
+  Metrics* metrics;
+  int fd;
+  struct event event;
+  std::string request;
+  std::string response;
+  size_t sent;
+};
+
+Metrics::Metrics()
+  : m_listenFd(-1),
+    m_ticksSince(0),
+    m_tickCount(0),
+    m_tickTotal(0),
+    m_saveMicros(0),
+    m_saves(0)
+{
+}
+
+Metrics::~Metrics()
+{
+  shutdown();
+}
+
+bool Metrics::init(const std::string& ip, int port, const std::string& path)
+{
+  int fd;
+#ifndef WIN32
+  if (!path.empty())
+  {
+    struct sockaddr_un address;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+      LOG(ERROR, "Metrics", "Socket path too long: " + path);
+      return false;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+      LOG(ERROR, "Metrics", "Failed to create socket");
+      return false;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path.c_str());
+
+    // Left behind if the server didn't shut down cleanly
+    unlink(path.c_str());
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0)
+    {
+      LOG(ERROR, "Metrics", "Failed to bind to " + path);
+      closeFd(fd);
+      return false;
+    }
+    m_path = path;
+  }
+  else
+#endif
+  {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+      LOG(ERROR, "Metrics", "Failed to create socket");
+      return false;
+    }
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = inet_addr(ip.c_str());
+    address.sin_port        = htons(port);
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (char*)&reuse, sizeof(reuse));
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0)
+    {
+      LOG(ERROR, "Metrics", "Failed to bind to " + ip + ":" + dtos(port));
+      closeFd(fd);
+      return false;
+    }
+  }
+
+  if (listen(fd, 5) < 0)
+  {
+    LOG(ERROR, "Metrics", "Failed to listen to socket");
+    closeFd(fd);
+    return false;
+  }
+
+  setnonblock(fd);
+  m_listenFd = fd;
+  event_set(&m_listenEvent, m_listenFd, EV_READ | EV_PERSIST, acceptCallback, this);
+  event_add(&m_listenEvent, NULL);
+
+  m_ticksSince = tickTime;
+  update();
+
+  LOG(INFO, "Metrics", "Serving metrics on " + (m_path.empty() ? ip + ":" + dtos(port) : m_path));
+  return true;
+}
+
+void Metrics::shutdown()
+{
+  while (!m_clients.empty())
+  {
+    closeClient(m_clients.back());
+  }
+
+  if (m_listenFd != -1)
+  {
+    event_del(&m_listenEvent);
+    closeFd(m_listenFd);
+    m_listenFd = -1;
+  }
+
+#ifndef WIN32
+  if (!m_path.empty())
+  {
+    unlink(m_path.c_str());
+    m_path.clear();
+  }
+#endif
+}
+
+void Metrics::recordTick(uint32_t us)
+{
+  m_ticks.record(us);
+  m_tickCount++;
+  m_tickTotal += us;
+}
+
+void Metrics::recordSave(uint32_t us)
+{
+  m_saveMicros = us;
+  m_saves++;
+}
+
+void Metrics::update()
+{
+  Mineserver* server = Mineserver::get();
+
+  // The percentiles cover the last one to two minutes
+  if (tickTime - m_ticksSince >= 60)
+  {
+    m_lastTicks  = m_ticks;
+    m_ticksSince = tickTime;
+    m_ticks.reset();
+  }
+  Histogram ticks(m_lastTicks);
+  ticks.add(m_ticks);
+
+  int players = 0;
+  uint64_t backlog = 0;
+  for (std::vector<User*>::size_type i = 0; i < server->users().size(); i++)
+  {
+    const User* user = server->users()[i];
+    if (user->logged)
+    {
+      players++;
+    }
+    backlog += user->sendBacklog();
+  }
+
+  std::ostringstream out;
+
+  describe(out, "mineserver_players", "gauge", "Players logged in.");
+  out << "mineserver_players " << players << "\n";
+
+  describe(out, "mineserver_chunks_resident", "gauge", "Chunks in memory.");
+  for (int i = 0; i < server->mapCount(); i++)
+  {
+    out << "mineserver_chunks_resident{map=\"" << i << "\"} " << server->map(i)->chunks.numChunks() << "\n";
+  }
+  describe(out, "mineserver_chunks_generated_total", "counter", "Chunks generated.");
+  for (int i = 0; i < server->mapCount(); i++)
+  {
+    out << "mineserver_chunks_generated_total{map=\"" << i << "\"} " << server->map(i)->chunksGenerated << "\n";
+  }
+
+  describe(out, "mineserver_physics_pending_blocks", "gauge", "Liquid blocks waiting for an update.");
+  for (int i = 0; i < server->mapCount(); i++)
+  {
+    out << "mineserver_physics_pending_blocks{map=\"" << i << "\"} " << server->physics(i)->pending() << "\n";
+  }
+  describe(out, "mineserver_physics_updates_total", "counter", "Liquid block updates.");
+  for (int i = 0; i < server->mapCount(); i++)
+  {
+    out << "mineserver_physics_updates_total{map=\"" << i << "\"} " << server->physics(i)->updates() << "\n";
+  }
+
+  describe(out, "mineserver_network_received_bytes_total", "counter", "Bytes received from clients.");
+  out << "mineserver_network_received_bytes_total " << server->netThreads()->bytesReceived() << "\n";
+  describe(out, "mineserver_network_sent_bytes_total", "counter", "Bytes written to client sockets.");
+  out << "mineserver_network_sent_bytes_total " << server->netThreads()->bytesWritten() << "\n";
+  describe(out, "mineserver_network_send_backlog_bytes", "gauge", "Output queued for clients and not written yet.");
+  out << "mineserver_network_send_backlog_bytes " << backlog << "\n";
+
+  describe(out, "mineserver_save_duration_seconds", "gauge", "Time the last periodic map save took.");
+  out << "mineserver_save_duration_seconds " << m_saveMicros / 1000000.0 << "\n";
+  describe(out, "mineserver_saves_total", "counter", "Periodic map saves.");
+  out << "mineserver_saves_total " << m_saves << "\n";
+
+  describe(out, "mineserver_tick_duration_seconds", "summary", "Time a tick took, quantiles over the last minute or two.");
+  const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+  for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++)
+  {
+    out << "mineserver_tick_duration_seconds{quantile=\"" << quantiles[i] << "\"} "
+        << ticks.percentile(quantiles[i] * 100) / 1000000.0 << "\n";
+  }
+  out << "mineserver_tick_duration_seconds_sum " << m_tickTotal / 1000000.0 << "\n";
+  out << "mineserver_tick_duration_seconds_count " << m_tickCount << "\n";
+
+  m_snapshot = out.str();
+}
+
+void Metrics::acceptCallback(int fd, short ev, void* arg)
+{
+  Metrics* self = (Metrics*)arg;
+
+  int clientFd = accept(fd, NULL, NULL);
+  if (clientFd < 0)
+  {
+    return;
+  }
+  if (self->m_clients.size() >= MAX_CLIENTS)
+  {
+    closeFd(clientFd);
+    return;
+  }
+  setnonblock(clientFd);
+#ifdef SO_NOSIGPIPE
+  int on = 1;
+  setsockopt(clientFd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+  Client* client  = new Client;
+  client->metrics = self;
+  client->fd      = clientFd;
+  client->sent    = 0;
+  self->m_clients.push_back(client);
+
+  timeval timeout = { CLIENT_TIMEOUT, 0 };
+  event_set(&client->event, clientFd, EV_READ, clientCallback, client);
+  event_add(&client->event, &timeout);
+}
+
+void Metrics::clientCallback(int fd, short ev, void* arg)
+{
+  Client* client = (Client*)arg;
+  if (!client->metrics->serve(client, ev))
+  {
+    client->metrics->closeClient(client);
+  }
+}
+
+bool Metrics::serve(Client* client, short ev)
+{
+  if (ev & EV_TIMEOUT)
+  {
+    return false;
+  }
+
+  timeval timeout = { CLIENT_TIMEOUT, 0 };
+  if (client->response.empty())
+  {
+    char buf[1024];
+    int got = recv(client->fd, buf, sizeof(buf), 0);
+    if (got == SOCKET_ERROR && wouldBlock())
+    {
+      event_add(&client->event, &timeout);
+      return true;
+    }
+    if (got <= 0)
+    {
+      return false;
+    }
+    client->request.append(buf, got);
+    if (client->request.size() > MAX_REQUEST)
+    {
+      return false;
+    }
+
+    // Answer once the headers are in, whatever the path
+    if (client->request.find("\r\n\r\n") == std::string::npos && client->request.find("\n\n") == std::string::npos)
+    {
+      event_add(&client->event, &timeout);
+      return true;
+    }
+
+    if (client->request.compare(0, 4, "GET ") == 0)
+    {
+      std::ostringstream response;
+      response << "HTTP/1.0 200 OK\r\n"
+               << "Content-Type: text/plain; version=0.0.4\r\n"
+               << "Content-Length: " << m_snapshot.size() << "\r\n"
+               << "Connection: close\r\n\r\n" << m_snapshot;
+      client->response = response.str();
+    }
+    else
+    {
+      client->response = "HTTP/1.0 405 Method Not Allowed\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    }
+
+    event_set(&client->event, client->fd, EV_WRITE, clientCallback, client);
+    event_add(&client->event, &timeout);
+    return true;
+  }
+
+  int sent = send(client->fd, client->response.data() + client->sent, client->response.size() - client->sent, SEND_FLAGS);
+  if (sent == SOCKET_ERROR)
+  {
+    // Still the same write event, wait for room
+    if (wouldBlock())
+    {
+      event_add(&client->event, &timeout);
+      return true;
+    }
+    return false;
+  }
+  client->sent += sent;
+  if (client->sent < client->response.size())
+  {
+    event_add(&client->event, &timeout);
+    return true;
+  }
+  return false;
+}
+
+void Metrics::closeClient(Client* client)
+{
+  event_del(&client->event);
+  closeFd(client->fd);
+  m_clients.erase(std::find(m_clients.begin(), m_clients.end(), client));
+  delete client;
+}
@@ -0,0 +1,98 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <event.h>
+
+#include "profiler.h"
+
+//
+// Counters and gauges in the Prometheus text format, served over HTTP on
+// a local TCP port or a Unix socket from the main event loop. update()
+// renders a snapshot of the game state once a second and a scrape only
+// ever sends the last snapshot, it never looks at the game itself.
+//
+class Metrics
+{
+public:
+  Metrics();
+  ~Metrics();
+
+  // Listen on ip:port, or on the Unix socket at path if it isn't empty
+  bool init(const std::string& ip, int port, const std::string& path);
+  void shutdown();
+
+  bool enabled() const
+  {
+    return m_listenFd != -1;
+  }
+
+  // How long a tick took, in microseconds
+  void recordTick(uint32_t us);
+  // How long the last periodic save took, in microseconds
+  void recordSave(uint32_t us);
+
+  // Render a new snapshot from the server state
+  void update();
+
+private:
+  struct Client;
+
+  static void acceptCallback(int fd, short ev, void* arg);
+  static void clientCallback(int fd, short ev, void* arg);
+  // Read the request and answer it, false once the client is done
+  bool serve(Client* client, short ev);
+  void closeClient(Client* client);
+
+  int m_listenFd;
+  struct event m_listenEvent;
+  std::string m_path;
+  std::vector<Client*> m_clients;
+
+  std::string m_snapshot;
+
+  // Tick times of this and the last minute, for the percentiles
+  Histogram m_ticks;
+  Histogram m_lastTicks;
+  time_t m_ticksSince;
+  uint64_t m_tickCount;
+  uint64_t m_tickTotal;
+
+  uint32_t m_saveMicros;
+  uint64_t m_saves;
+
+  Metrics(const Metrics&);
+  Metrics& operator=(const Metrics&);
+};
+
+#endif
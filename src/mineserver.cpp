@@ -76,6 +76,16 @@
 #include "cliScreen.h"
 #include "hook.h"
 #include "mob.h"
+#include "chunkcompressor.h"
+#include "chunkio.h"
+#include "netthreads.h"
+#include "entitytracker.h"
+#include "sendpacer.h"
+#include "viewdistance.h"
+#include "physicsthreads.h"
+#include "tickscheduler.h"
+#include "profiler.h"
+#include "metrics.h"
 //#include "minecart.h"
 #ifdef WIN32
 static bool quit = false;
@@ -122,6 +132,26 @@ std::string removeChar(std::string str, const char* c)
   return str;
 }
 
+// Configs from older versions lack newer keys, which read as 0
+static int configInt(Config* config, const std::string& name, int fallback)
+{
+  return config->has(name) ? config->iData(name) : fallback;
+}
+
+// Liquid delays in ticks have to fit in the physics timing wheel
+static int physicsDelay(Config* config, const std::string& name, int fallback)
+{
+  const int delay = configInt(config, name, fallback);
+  if (delay < 1 || delay >= BlockSchedule::WHEEL_SIZE)
+  {
+    LOG(WARNING, "Physics", name + " must be 1 to " + dtos(BlockSchedule::WHEEL_SIZE - 1) +
+        " ticks, using " + dtos(fallback));
+    return fallback;
+  }
+  return delay;
+}
+
+#ifndef MINESERVER_NO_MAIN
 int main(int argc, char* argv[])
 {
   signal(SIGTERM, sighandler);
@@ -137,6 +167,7 @@ int main(int argc, char* argv[])
 
   return Mineserver::get()->run(argc, argv);
 }
+#endif
 
 Mineserver::Mineserver()
 {
@@ -146,6 +177,7 @@ Mineserver::Mineserver()
   initConstants();
 
   m_config         = new Config;
+  m_profiler       = new Profiler;
 
   std::string file_config;
   file_config.assign(CONFIG_FILE);
@@ -217,6 +249,27 @@ Mineserver::Mineserver()
   m_packetHandler  = new PacketHandler;
   m_inventory      = new Inventory;
   m_mobs           = new Mobs;
+  m_chunkCompressor = new ChunkCompressor;
+  m_physicsThreads = new PhysicsThreads;
+  m_chunkIO        = new ChunkIO;
+  m_netThreads     = new NetThreads;
+  m_entityTracker  = new EntityTracker(std::max(configInt(m_config, "map.entity_distance", 5), 1));
+  m_viewDistance   = new ViewDistance(std::max(configInt(m_config, "map.view_distance", 10), 1),
+                                      std::max(configInt(m_config, "map.view_distance_min", 4), 1),
+                                      std::max(configInt(m_config, "map.view_budget.tick", 40), 0),
+                                      std::max(configInt(m_config, "map.view_budget.chunks", 6000), 0));
+  m_tickScheduler  = new TickScheduler(std::max(configInt(m_config, "system.tick.ms", 50), 1),
+                                       std::max(configInt(m_config, "system.tick.catch_up", 5), 1));
+  m_tickScheduler->setBudget(TickScheduler::TASK_CHUNKS, std::max(configInt(m_config, "system.tick.budget.chunks", 10), 0));
+  m_tickScheduler->setBudget(TickScheduler::TASK_PHYSICS, std::max(configInt(m_config, "system.tick.budget.physics", 10), 0));
+  m_tickScheduler->setBudget(TickScheduler::TASK_LIGHTING, std::max(configInt(m_config, "system.tick.budget.lighting", 5), 0));
+  m_tickScheduler->setBudget(TickScheduler::TASK_PLUGINS, std::max(configInt(m_config, "system.tick.budget.plugins", 10), 0));
+  m_pushNext       = 0;
+  m_blockTimerNext = 0;
+  m_profiler->setEnabled(m_config->bData("system.profiler.enabled"));
+  m_profileFile     = m_config->sData("system.profiler.dump_file");
+  m_profileInterval = std::max(m_config->iData("system.profiler.dump_interval"), 0);
+  m_metrics         = new Metrics;
   m_mobs->mobNametoType("Creeper");
 }
 
@@ -234,6 +287,14 @@ void Mineserver::saveAll()
   saveAllPlayers();
 }
 
+void Mineserver::flushBlockChanges()
+{
+  for (std::vector<Map*>::size_type i = 0; i < m_map.size(); i++)
+  {
+    m_map[i]->flushBlockChanges();
+  }
+}
+
 void Mineserver::saveAllPlayers()
 {
   if (users().size() == 0)
@@ -325,8 +386,6 @@ void Mineserver::parseCommandLine(int argc, char* argv[])
 
 int Mineserver::run(int argc, char* argv[])
 {
-  uint32_t starttime = (uint32_t)time(0);
-  uint32_t tick      = (uint32_t)time(0);
   m_plugin         = new Plugin;
 
   init_plugin_api();
@@ -363,10 +422,15 @@ int Mineserver::run(int argc, char* argv[])
   }
   pid_out.close();
 
+  const int waterDelay    = physicsDelay(m_config, "system.physics.water_delay", 5);
+  const int lavaDelay     = physicsDelay(m_config, "system.physics.lava_delay", 30);
+  const int physicsBudget = configInt(m_config, "system.physics.budget", 500);
+
   // Initialize map
   for (int i = 0; i < (int)m_map.size(); i++)
   {
     Mineserver::get()->physics(i)->enabled = (Mineserver::get()->config()->bData("system.physics.enabled"));
+    Mineserver::get()->physics(i)->configure(waterDelay, lavaDelay, physicsBudget);
 
     m_map[i]->init(i);
     if (Mineserver::get()->config()->bData("map.generate_spawn.enabled"))
@@ -419,6 +483,29 @@ int Mineserver::run(int argc, char* argv[])
 #endif
   }
 
+  // Start the chunk I/O thread, on unless the config turns it off
+  bool asyncIO = !m_config->has("map.async_io") || m_config->bData("map.async_io");
+  if (asyncIO && !m_chunkIO->init())
+  {
+    LOG(WARNING, "Map", "Could not start chunk I/O thread, loading and saving on the main thread");
+  }
+
+  // Start chunk compression workers
+  int compressionThreads = configInt(m_config, "map.compression_threads", 2);
+  if (compressionThreads > 0 && !m_chunkCompressor->init(compressionThreads))
+  {
+    LOG(WARNING, "Map", "Could not start chunk compression threads, compressing on the main thread");
+    m_chunkCompressor->shutdown();
+  }
+
+  // Start the physics workers
+  int physicsThreads = Mineserver::get()->config()->iData("system.physics.threads");
+  if (physicsThreads > 0 && !m_physicsThreads->init(physicsThreads))
+  {
+    LOG(WARNING, "Physics", "Could not start physics threads, simulating on the main thread");
+    m_physicsThreads->shutdown();
+  }
+
   // Initialize packethandler
   Mineserver::get()->packetHandler()->init();
 
@@ -485,6 +572,24 @@ int Mineserver::run(int argc, char* argv[])
   event_set(&m_listenEvent, m_socketlisten, EV_WRITE | EV_READ | EV_PERSIST, accept_callback, NULL);
   event_add(&m_listenEvent, NULL);
 
+  if (m_config->bData("net.metrics.enabled"))
+  {
+    m_metrics->init(m_config->sData("net.metrics.ip"), m_config->iData("net.metrics.port"),
+                    m_config->sData("net.metrics.socket"));
+  }
+
+  // Start the network threads
+  int netThreads = Mineserver::get()->config()->iData("net.threads");
+  if (netThreads > 0 && !m_netThreads->init(netThreads))
+  {
+    LOG(WARNING, "Socket", "Could not start network threads, doing socket I/O on the main thread");
+    m_netThreads->shutdown();
+  }
+
+  SendPacer::configure(std::max(configInt(m_config, "net.pacing.max_backlog", 512), 16) * 1024,
+                       configInt(m_config, "net.pacing.max_chunks", 32),
+                       std::max(configInt(m_config, "net.pacing.user_rate", 0), 0) * 1024);
+
   if (ip == "0.0.0.0")
   {
     // Print all local IPs
@@ -505,25 +610,161 @@ int Mineserver::run(int argc, char* argv[])
     Mineserver::get()->logger()->log(LogType::LOG_INFO, "Socket", myip + ":" + dtos(port));
   }
 
-  timeval loopTime;
-  loopTime.tv_sec  = 0;
-  loopTime.tv_usec = 200000; // 200ms
-
   m_running = true;
-  event_base_loopexit(m_eventBase, &loopTime);
+  m_tickScheduler->start();
+
+  // Network events are handled while waiting for the next tick
+  while (m_running)
+  {
+    const uint32_t wait = m_tickScheduler->untilNext();
+    timeval loopTime;
+    loopTime.tv_sec  = wait / 1000;
+    loopTime.tv_usec = (wait % 1000) * 1000;
+    event_base_loopexit(m_eventBase, &loopTime);
+    if (event_base_loop(m_eventBase, 0) != 0)
+    {
+      break;
+    }
+
+    for (int due = m_tickScheduler->due(); due > 0 && m_running; due--)
+    {
+      runTick();
+    }
+  }
+
+  // Closes the client sockets the network threads own
+  m_netThreads->shutdown();
+  m_metrics->shutdown();
+
+#ifdef WIN32
+  closesocket(m_socketlisten);
+#else
+  close(m_socketlisten);
+#endif
 
-  // Create our Server Console user so we can issue commands
+  // Remove the PID file
+#ifdef WIN32
+  _unlink((Mineserver::get()->config()->sData("system.pid_file")).c_str());
+#else
+  unlink((Mineserver::get()->config()->sData("system.pid_file")).c_str());
+#endif
+
+  // Let the user know we're shutting the server down cleanly
+  logger()->log(LogType::LOG_INFO, "Mineserver", "Shutting down...");
 
-  time_t timeNow = time(NULL);
-  while (m_running && event_base_loop(m_eventBase, 0) == 0)
+  // Close the cli session if its in use
+  if (Mineserver::get()->config()->bData("system.interface.use_cli"))
   {
-    // Run 200ms timer hook
-    static_cast<Hook0<bool>*>(plugin()->getHook("Timer200"))->doAll();
-    // Alert any block types that care about timers
-    BlockBasic* blockcb;
-    for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+    screen()->end();
+  }
+
+  delete m_chunkCompressor;
+  m_chunkCompressor = NULL;
+
+  delete m_physicsThreads;
+  m_physicsThreads = NULL;
+
+  delete m_netThreads;
+  m_netThreads = NULL;
+
+  saveAll();
+
+  /* Free memory */
+  for (std::vector<Map*>::size_type i = 0; i < m_map.size(); i++)
+  {
+    delete m_map[i];
+    delete m_physics[i];
+    delete m_mapGen[i];
+  }
+
+  // Writes everything still queued
+  delete m_chunkIO;
+  m_chunkIO = NULL;
+
+  delete m_chat;
+  delete m_plugin;
+  delete m_screen;
+  delete m_config;
+  delete m_furnaceManager;
+  delete m_packetHandler;
+  delete m_logger;
+  delete m_inventory;
+  delete m_entityTracker;
+  delete m_viewDistance;
+  delete m_tickScheduler;
+  delete m_profiler;
+  delete m_metrics;
+
+  freeConstants();
+
+  event_base_free(m_eventBase);
+
+  return EXIT_SUCCESS;
+}
+
+void Mineserver::runTick()
+{
+  TickScheduler& ticks = *m_tickScheduler;
+  ticks.begin();
+  PROFILE(Profiler::TICK);
+  const uint64_t tickStart = Profiler::now();
+  updateTickTime();
+  const time_t timeNow = tickTime;
+
+  // Hand out chunks compressed by the workers since the last tick
+  std::vector<ChunkCompressJob*> compressed;
+  m_chunkCompressor->collect(compressed);
+  for (std::vector<ChunkCompressJob*>::size_type i = 0; i < compressed.size(); i++)
+  {
+    m_map[compressed[i]->map]->chunkCompressed(compressed[i]);
+    delete compressed[i];
+  }
+
+  // Chunk loads and saves finished by the I/O thread
+  std::vector<ChunkIOJob*> ioDone;
+  m_chunkIO->collect(ioDone);
+  for (std::vector<ChunkIOJob*>::size_type i = 0; i < ioDone.size(); i++)
+  {
+    if (ioDone[i]->type == ChunkIOJob::LOAD)
+    {
+      m_map[ioDone[i]->map]->chunkLoaded(ioDone[i]);
+    }
+    else
+    {
+      m_map[ioDone[i]->map]->chunkSaved(ioDone[i]);
+    }
+    delete ioDone[i];
+  }
+
+  // Plugins. A hook can't be cut short, the block timers left when the
+  // budget runs out go on in the next tick.
+  {
+    TickScheduler::Slice slice(ticks, TickScheduler::TASK_PLUGINS);
+    const std::vector<BlockBasic*>& blockcbs = plugin()->getBlockCB();
+    if (ticks.every(200))
     {
-      blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
+      // Run 200ms timer hook
+      static_cast<Hook0<bool>*>(plugin()->getHook(Plugin::HOOK_TIMER200))->doAll();
+      if (m_blockTimerNext >= blockcbs.size())
+      {
+        m_blockTimerNext = 0;
+      }
+    }
+    if (ticks.every(1000, 500))
+    {
+      // Run 1s timer hook
+      static_cast<Hook0<bool>*>(plugin()->getHook(Plugin::HOOK_TIMER1000))->doAll();
+    }
+    if (ticks.every(10000, 5000))
+    {
+      // Run 10s timer hook
+      static_cast<Hook0<bool>*>(plugin()->getHook(Plugin::HOOK_TIMER10000))->doAll();
+    }
+
+    // Alert any block types that care about timers, at least one a tick
+    for (bool first = true; m_blockTimerNext < blockcbs.size() && (first || slice.left()); first = false)
+    {
+      BlockBasic* blockcb = blockcbs[m_blockTimerNext++];
       if (blockcb != NULL)
       {
         blockcb->timer200();
@@ -532,118 +773,194 @@ int Mineserver::run(int argc, char* argv[])
     //    for(uint32_t i=0; i<minecarts.size(); i++){
     //      minecarts[i]->timer();
     //    }
+  }
 
+  // Liquids due this tick
+  {
+    TickScheduler::Slice slice(ticks, TickScheduler::TASK_PHYSICS);
+    const uint32_t budget = ticks.budget(TickScheduler::TASK_PHYSICS);
+    for (std::vector<Physics*>::size_type i = 0; i < m_physics.size(); i++)
+    {
+      m_physics[i]->update(budget ? std::max(budget / (uint32_t)m_physics.size(), 1U) : 0);
+    }
+  }
 
-    timeNow = time(0);
-    if (timeNow - starttime > 10)
+  // Light for the chunks generated lately
+  {
+    TickScheduler::Slice slice(ticks, TickScheduler::TASK_LIGHTING);
+    const uint32_t budget = ticks.budget(TickScheduler::TASK_LIGHTING);
+    for (std::vector<Map*>::size_type i = 0; i < m_map.size(); i++)
     {
-      starttime = (uint32_t)timeNow;
+      m_map[i]->generateQueuedLight(budget ? std::max(budget / (uint32_t)m_map.size(), 1U) : 0);
+    }
+  }
 
-      //Map saving on configurable interval
-      if (m_saveInterval != 0 && timeNow - m_lastSave >= m_saveInterval)
-      {
-        //Save
-        for (std::vector<Map*>::size_type i = 0; i < m_map.size(); i++)
-        {
-          m_map[i]->saveWholeMap();
-        }
+  // Every 10 seconds, the jobs a second apart
+  if (ticks.every(10000) && User::all().size() > 0)
+  {
+    // 0x00 package
+    uint8_t data = 0;
+    User::all()[0]->sendAll(&data, 1);
+
+    // Send server time
+    Packet pkt;
+    pkt << (int8_t)PACKET_TIME_UPDATE << (int64_t)m_map[0]->mapTime;
+    User::all()[0]->sendAll((uint8_t*)pkt.getWrite(), pkt.getWriteLen());
+  }
 
-        m_lastSave = timeNow;
-      }
+  //Map saving on configurable interval
+  if (ticks.every(10000, 1000) && m_saveInterval != 0 && timeNow - m_lastSave >= m_saveInterval)
+  {
+    //Save
+    PROFILE(Profiler::SAVE);
+    const uint64_t saveStart = Profiler::now();
+    for (std::vector<Map*>::size_type i = 0; i < m_map.size(); i++)
+    {
+      m_map[i]->saveWholeMap();
+    }
+    m_metrics->recordSave((uint32_t)(Profiler::now() - saveStart));
+
+    m_lastSave = timeNow;
+  }
 
-      // If users, ping them
-      if (User::all().size() > 0)
+  //Check for tree generation from saplings
+  if (ticks.every(10000, 2000))
+  {
+    for (std::vector<Map*>::size_type i = 0; i < m_map.size(); i++)
+    {
+      m_map[i]->checkGenTrees();
+    }
+  }
+
+  if (ticks.every(10000, 3000))
+  {
+    //Report chunk payload cache usage
+    for (std::vector<Map*>::size_type i = 0; i < m_map.size(); i++)
+    {
+      const uint64_t hits   = m_map[i]->chunkCacheHits;
+      const uint64_t misses = m_map[i]->chunkCacheMisses;
+      if (hits + misses > 0)
       {
-        // 0x00 package
-        uint8_t data = 0;
-        User::all()[0]->sendAll(&data, 1);
+        LOG(DEBUG, "Map", "Map " + dtos(i) + " chunk cache: " + dtos(hits) + " hits, " + dtos(misses) + " misses (" +
+            dtos((double)hits * 100 / (double)(hits + misses)) + "% hit rate)");
+      }
+    }
 
-        // Send server time
-        Packet pkt;
-        pkt << (int8_t)PACKET_TIME_UPDATE << (int64_t)m_map[0]->mapTime;
-        User::all()[0]->sendAll((uint8_t*)pkt.getWrite(), pkt.getWriteLen());
+    for (std::vector<Physics*>::size_type i = 0; i < m_physics.size(); i++)
+    {
+      if (m_physics[i]->pending() > 0 || m_physics[i]->updatesPerSecond() > 0)
+      {
+        LOG(DEBUG, "Physics", "Map " + dtos(i) + ": " + dtos(m_physics[i]->pending()) + " blocks pending, " +
+            dtos(m_physics[i]->carried()) + " carried over, " + dtos(m_physics[i]->updatesPerSecond()) + " updates/s");
       }
+    }
 
-      //Check for tree generation from saplings
-      for (std::vector<Map*>::size_type i = 0; i < m_map.size(); i++)
+    for (std::vector<User*>::size_type i = 0; i < users().size(); i++)
+    {
+      const User* user = users()[i];
+      if (!user->mapQueue.empty())
       {
-        m_map[i]->checkGenTrees();
+        const SendPacer& pacer = user->pacer;
+        LOG(DEBUG, "Net", user->nick + ": " + dtos(user->mapQueue.size()) + " chunks queued, " +
+            dtos(pacer.chunksSent()) + " sent, " + dtos(pacer.drainRate() / 1024) + " KB/s, " +
+            dtos(pacer.backlog() / 1024) + " KB waiting, throttled " + dtos(pacer.throttled()) + " times");
       }
+    }
 
-      // TODO: Run garbage collection for chunk storage dealie?
+    LOG(DEBUG, "Tick", dtos(ticks.statTicks()) + " ticks, " + dtos(ticks.tickAverage()) + "ms average, " +
+        dtos(ticks.tickMax()) + "ms max, " + dtos(ticks.overruns()) + " over " + dtos(ticks.tickMs()) + "ms; chunks " +
+        dtos(ticks.taskAverage(TickScheduler::TASK_CHUNKS)) + "ms, physics " +
+        dtos(ticks.taskAverage(TickScheduler::TASK_PHYSICS)) + "ms, lighting " +
+        dtos(ticks.taskAverage(TickScheduler::TASK_LIGHTING)) + "ms, plugins " +
+        dtos(ticks.taskAverage(TickScheduler::TASK_PLUGINS)) + "ms");
+    if (ticks.skipped() > 0)
+    {
+      LOG(WARNING, "Tick", "Can't keep up, skipped " + dtos(ticks.skipped()) + " ticks (" +
+          dtos(ticks.skipped() * ticks.tickMs()) + "ms) in the last " + dtos(ticks.statTicks() * ticks.tickMs() / 1000) + "s");
+    }
+    ticks.resetStats();
 
-      // Run 10s timer hook
-      static_cast<Hook0<bool>*>(plugin()->getHook("Timer10000"))->doAll();
+    // TODO: Run garbage collection for chunk storage dealie?
+  }
+
+  // Latency histograms since the last dump
+  if (m_profiler->enabled() && m_profileInterval > 0 && !m_profileFile.empty() &&
+      ticks.every(m_profileInterval * 1000, 4000))
+  {
+    if (!m_profiler->dump(m_profileFile))
+    {
+      LOG(WARNING, "Profiler", "Can't write " + m_profileFile);
     }
+    m_profiler->reset();
+  }
 
-    // Every second
-    if (timeNow - tick > 0)
+  // Every second
+  if (ticks.every(1000))
+  {
+    // Loop users
+    for (int i = users().size() - 1; i >= 0; i--)
     {
-      tick = (uint32_t)timeNow;
-      // Loop users
-      for (int i = users().size() - 1; i >= 0; i--)
+      // No data received in 30s, timeout
+      if (users()[i]->logged && (timeNow - users()[i]->lastData) > 30)
       {
-        // No data received in 30s, timeout
-        if (users()[i]->logged && (timeNow - users()[i]->lastData) > 30)
-        {
-          Mineserver::get()->logger()->log(LogType::LOG_INFO, "Sockets", "Player " + users()[i]->nick + " timed out");
-
-          delete users()[i];
-        }
-        else if (!users()[i]->logged && (timeNow - users()[i]->lastData) > 100)
-        {
-          delete users()[i];
-        }
-        else
-        {
-          if (m_damage_enabled)
-          {
-            users()[i]->checkEnvironmentDamage();
-          }
-          users()[i]->pushMap();
-          users()[i]->popMap();
-        }
-
-        // Minecart hacks!!
-        /*
-        if (User::all()[i]->attachedTo)
-        {
-          Packet pkt;
-          pkt << PACKET_ENTITY_VELOCITY << (int32_t)User::all()[i]->attachedTo <<  (int16_t)10000       << (int16_t)0 << (int16_t)0;
-          // pkt << PACKET_ENTITY_RELATIVE_MOVE << (int32_t)User::all()[i]->attachedTo <<  (int8_t)100       << (int8_t)0 << (int8_t)0;
-          User::all()[i]->sendAll((int8_t*)pkt.getWrite(), pkt.getWriteLen());
-        }
-        */
+        Mineserver::get()->logger()->log(LogType::LOG_INFO, "Sockets", "Player " + users()[i]->nick + " timed out");
 
+        delete users()[i];
       }
-
-      for (std::vector<Map*>::size_type i = 0 ; i < m_map.size(); i++)
+      else if (!users()[i]->logged && (timeNow - users()[i]->lastData) > 100)
       {
-        m_map[i]->mapTime += 20;
-        if (m_map[i]->mapTime >= 24000)
+        delete users()[i];
+      }
+      else
+      {
+        if (m_damage_enabled)
         {
-          m_map[i]->mapTime = 0;
+          users()[i]->checkEnvironmentDamage();
         }
-        Mineserver::get()->physics(i)->update();
+        users()[i]->popMap();
+      }
 
+      // Minecart hacks!!
+      /*
+      if (User::all()[i]->attachedTo)
+      {
+        Packet pkt;
+        pkt << PACKET_ENTITY_VELOCITY << (int32_t)User::all()[i]->attachedTo <<  (int16_t)10000       << (int16_t)0 << (int16_t)0;
+        // pkt << PACKET_ENTITY_RELATIVE_MOVE << (int32_t)User::all()[i]->attachedTo <<  (int8_t)100       << (int8_t)0 << (int8_t)0;
+        User::all()[i]->sendAll((int8_t*)pkt.getWrite(), pkt.getWriteLen());
       }
+      */
 
+    }
 
-      for (int i = users().size() - 1; i >= 0; i--)
+    for (std::vector<Map*>::size_type i = 0 ; i < m_map.size(); i++)
+    {
+      m_map[i]->mapTime += 20;
+      if (m_map[i]->mapTime >= 24000)
       {
-        users()[i]->pushMap();
-        users()[i]->popMap();
+        m_map[i]->mapTime = 0;
       }
+    }
+  }
 
-      // Check for Furnace activity
-      Mineserver::get()->furnaceManager()->update();
+  if (ticks.every(1000, 250))
+  {
+    // Check for Furnace activity
+    Mineserver::get()->furnaceManager()->update();
+  }
 
-      // Run 1s timer hook
-      static_cast<Hook0<bool>*>(plugin()->getHook("Timer1000"))->doAll();
+  if (ticks.every(1000, 750))
+  {
+    for (int i = users().size() - 1; i >= 0; i--)
+    {
+      users()[i]->popMap();
     }
+  }
 
-    // Underwater check / drowning
-    // ToDo: this could be done a bit differently? - Fador
+  // Underwater check / drowning
+  // ToDo: this could be done a bit differently? - Fador
+  if (ticks.every(200, 100))
+  {
     int i = 0;
     int s = User::all().size();
     for (i = 0; i < s; i++)
@@ -654,56 +971,50 @@ int Mineserver::run(int argc, char* argv[])
         User::all()[i]->sethealth(User::all()[i]->health - 5);
       }
     }
-
-    event_base_loopexit(m_eventBase, &loopTime);
   }
 
-#ifdef WIN32
-  closesocket(m_socketlisten);
-#else
-  close(m_socketlisten);
-#endif
-
-  // Remove the PID file
-#ifdef WIN32
-  _unlink((Mineserver::get()->config()->sData("system.pid_file")).c_str());
-#else
-  unlink((Mineserver::get()->config()->sData("system.pid_file")).c_str());
-#endif
-
-  // Let the user know we're shutting the server down cleanly
-  logger()->log(LogType::LOG_INFO, "Mineserver", "Shutting down...");
-
-  // Close the cli session if its in use
-  if (Mineserver::get()->config()->bData("system.interface.use_cli"))
+  // Chunks go out as fast as each connection takes them. Players take
+  // turns, the next tick starts with whoever didn't fit in this one.
   {
-    screen()->end();
+    TickScheduler::Slice slice(ticks, TickScheduler::TASK_CHUNKS);
+    PROFILE(Profiler::CHUNK_SEND);
+    const std::vector<User*>::size_type count = users().size();
+    for (std::vector<User*>::size_type n = 0; n < count && (n == 0 || slice.left()); n++)
+    {
+      users()[m_pushNext++ % count]->pushMap();
+    }
   }
 
-  saveAll();
+  // Output queued during this tick
+  flushBlockChanges();
+  m_netThreads->flush();
 
-  /* Free memory */
+  int chunks = 0;
   for (std::vector<Map*>::size_type i = 0; i < m_map.size(); i++)
   {
-    delete m_map[i];
-    delete m_physics[i];
-    delete m_mapGen[i];
+    chunks += m_map[i]->chunks.numChunks();
+  }
+  if (m_viewDistance->update(timeNow, clockMs() - ticks.tickStart(), chunks))
+  {
+    LOG(INFO, "Map", "View distance now " + dtos(m_viewDistance->distance()) + " chunks (" +
+        dtos(m_viewDistance->tickAverage()) + "ms per tick, " + dtos(chunks) + " chunks loaded)");
+    for (std::vector<User*>::size_type i = 0; i < users().size(); i++)
+    {
+      users()[i]->setViewDistance(m_viewDistance->distance());
+    }
   }
 
-  delete m_chat;
-  delete m_plugin;
-  delete m_screen;
-  delete m_config;
-  delete m_furnaceManager;
-  delete m_packetHandler;
-  delete m_logger;
-  delete m_inventory;
-
-  freeConstants();
-
-  event_base_free(m_eventBase);
+  // What a scrape of the metrics gets to see
+  if (m_metrics->enabled())
+  {
+    m_metrics->recordTick((uint32_t)(Profiler::now() - tickStart));
+    if (ticks.every(1000, 100))
+    {
+      m_metrics->update();
+    }
+  }
 
-  return EXIT_SUCCESS;
+  ticks.end();
 }
 
 Physics* Mineserver::physics(int n)
@@ -55,6 +55,15 @@ class Logger;
 class Inventory;
 class Mobs;
 class Mob;
+class ChunkCompressor;
+class ChunkIO;
+class NetThreads;
+class EntityTracker;
+class ViewDistance;
+class PhysicsThreads;
+class TickScheduler;
+class Profiler;
+class Metrics;
 
 #define MINESERVER
 #include "plugin_api.h"
@@ -171,14 +180,55 @@ public:
   {
     m_inventory = m_inventory;
   }
+  ChunkCompressor* chunkCompressor() const
+  {
+    return m_chunkCompressor;
+  }
+  ChunkIO* chunkIO() const
+  {
+    return m_chunkIO;
+  }
+  NetThreads* netThreads() const
+  {
+    return m_netThreads;
+  }
+  EntityTracker* entityTracker() const
+  {
+    return m_entityTracker;
+  }
+  ViewDistance* viewDistance() const
+  {
+    return m_viewDistance;
+  }
+  PhysicsThreads* physicsThreads() const
+  {
+    return m_physicsThreads;
+  }
+  TickScheduler* tickScheduler() const
+  {
+    return m_tickScheduler;
+  }
+  Profiler* profiler() const
+  {
+    return m_profiler;
+  }
+  Metrics* metrics() const
+  {
+    return m_metrics;
+  }
 
   void saveAllPlayers();
   void saveAll();
+  // Send the block changes queued on every map
+  void flushBlockChanges();
 
   void parseCommandLine(int argc, char* argv[]);
 
 private:
   Mineserver();
+  // One game tick, run by the main loop at the tick rate
+  void runTick();
+
   event_base* m_eventBase;
   bool m_running;
   // holds all connected users
@@ -199,6 +249,21 @@ private:
   Logger* m_logger;
   Inventory* m_inventory;
   Mobs* m_mobs;
+  ChunkCompressor* m_chunkCompressor;
+  ChunkIO* m_chunkIO;
+  NetThreads* m_netThreads;
+  EntityTracker* m_entityTracker;
+  ViewDistance* m_viewDistance;
+  PhysicsThreads* m_physicsThreads;
+  TickScheduler* m_tickScheduler;
+  // Where chunk sending and the block timers pick up in the next tick
+  size_t m_pushNext;
+  size_t m_blockTimerNext;
+  Profiler* m_profiler;
+  // Profile dump file, written every m_profileInterval seconds
+  std::string m_profileFile;
+  uint32_t m_profileInterval;
+  Metrics* m_metrics;
 };
 
 #endif
@@ -27,6 +27,7 @@
 
 #include "mob.h"
 #include "math.h"
+#include "entitytracker.h"
 #include <algorithm>
 
 Mob::Mob()
@@ -43,6 +44,8 @@ Mob::Mob()
 
 Mob::~Mob()
 {
+  Mineserver::get()->entityTracker()->remove(UID);
+
   std::vector<Mob*> mobs = Mineserver::get()->mobs()->getAll();
   for (std::vector<Mob*>::iterator i = mobs.begin() ; i != mobs.end(); i++)
   {
@@ -66,13 +69,10 @@ void Mob::sethealth(int health)
   }
   if (health < this->health)
   {
-    for (int i = 0; i < Mineserver::get()->users().size(); i++)
-    {
-      User* user = Mineserver::get()->users()[i];
-      user->buffer << (int8_t)PACKET_ARM_ANIMATION << (int32_t)UID <<
-                   (int8_t)2 ;
-      // Hurt animation
-    }
+    // Hurt animation
+    Packet pkt;
+    pkt << (int8_t)PACKET_ARM_ANIMATION << (int32_t)UID << (int8_t)2;
+    Mineserver::get()->entityTracker()->sendToObservers(UID, pkt);
   }
   this->health = health;
   if (this->health <= 0)
@@ -105,43 +105,24 @@ void Mob::spawnToAll()
   {
     health = 10;
   }
-  for (int i = 0; i < Mineserver::get()->users().size(); i++)
-  {
-    User* user = Mineserver::get()->users()[i];
-    if (user->logged)
-    {
-      user->buffer << (int8_t)PACKET_MOB_SPAWN << (int32_t) UID << (int8_t) type
-                   << (int32_t)(x * 32.0) << (int32_t)(y * 32.0) << (int32_t)(z * 32.0) << (int8_t) yaw
-                   << (int8_t) pitch;
-      if (type == MOB_SHEEP)
-      {
-        user->buffer << (int8_t) 0 << (int8_t) meta << (int8_t) 127;
-      }
-      else
-      {
-        user->buffer << (int8_t) 127;
-      }
-    }
-    spawned = true;
-  }
+  spawned = true;
+  // Spawned for the players near only
+  Mineserver::get()->entityTracker()->addMob(this);
 }
 
 void Mob::deSpawnToAll()
 {
-  for (int i = 0; i < Mineserver::get()->users().size(); i++)
-  {
-    User* user = Mineserver::get()->users()[i];
-    if (user->logged)
-    {
-      user->buffer << PACKET_DESTROY_ENTITY << (int32_t) UID;
-    }
-  }
+  Mineserver::get()->entityTracker()->remove(UID);
   spawned = false;
 }
 
 void Mob::relativeMoveToAll()
 {
-
+  if (!spawned)
+  {
+    return;
+  }
+  Mineserver::get()->entityTracker()->move(UID, map, x, y, z, yaw, pitch);
 }
 
 void Mob::teleportToAll()
@@ -150,16 +131,7 @@ void Mob::teleportToAll()
   {
     return;
   }
-  for (int i = 0; i < Mineserver::get()->users().size(); i++)
-  {
-    User* user = Mineserver::get()->users()[i];
-    if (user->logged)
-    {
-      user->buffer << PACKET_ENTITY_TELEPORT << (int32_t) UID
-                   << (int32_t)(x * 32.0) << (int32_t)(y * 32.0) << (int32_t)(z * 32.0)
-                   << (int8_t) yaw << (int8_t) pitch;
-    }
-  }
+  Mineserver::get()->entityTracker()->move(UID, map, x, y, z, yaw, pitch, true);
 }
 
 void Mob::moveTo(double to_x, double to_y, double to_z, int to_map)
@@ -174,15 +146,8 @@ void Mob::moveTo(double to_x, double to_y, double to_z, int to_map)
   {
     map = to_map;
   }
-  //  if(distx < 4 && disty < 4 && distz < 4)
-  //  {
-  //    // Work out how to use the relative move?
-  //    teleportToAll();
-  //  }
-  //  else
-  //  {
-  teleportToAll();
-  //  }
+  // Falls back to a teleport for long moves
+  relativeMoveToAll();
 }
 
 void Mob::look(int16_t yaw, int16_t pitch)
@@ -202,12 +167,7 @@ void Mob::look(int16_t yaw, int16_t pitch)
   int8_t p_byte = (int8_t)((pitch * 1.0) / 360.0 * 256.0);
   this->pitch = p_byte;
   this->yaw = y_byte;
-  Packet pkt;
-  pkt << PACKET_ENTITY_LOOK << (int32_t) UID << (int8_t) y_byte << (int8_t) p_byte;
-  if (User::all().size() > 0)
-  {
-    User::all()[0]->sendAll((uint8_t*)pkt.getWrite(), pkt.getWriteLen());
-  }
+  relativeMoveToAll();
 }
 
 
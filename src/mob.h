@@ -64,7 +64,6 @@ public:
 
   void moveTo(double to_x, double to_y, double to_z, int to_map = -1);
   void look(int16_t yaw, int16_t pitch);
-
 };
 
 class Mobs
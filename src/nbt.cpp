@@ -525,61 +525,45 @@ void NBT_Value::cleanup()
 
 NBT_Value* NBT_Value::LoadFromFile(const std::string& filename)
 {
-  FILE* fp = fopen(filename.c_str(), "rb");
-  if (fp == NULL)
-  {
-    return NULL;
-  }
-  fseek(fp, -4, SEEK_END);
-  uint32_t uncompressedSize = 0;
-  fread(&uncompressedSize, 4, 1, fp);
-  fclose(fp);
+  std::vector<uint8_t> buffer;
+  bool sizeKnown = true;
 
-  //Do endian testing!
-  int32_t endiantestint = 1;
-  int8_t* endiantestchar = (int8_t*)&endiantestint;
-  if (*endiantestchar != 1)
+  if (!readGzipFile(filename, buffer, &sizeKnown))
   {
-    //Swap order
-    int uncompressedSizeOld = uncompressedSize;
-    uint8_t* newpointer = reinterpret_cast<uint8_t*>(&uncompressedSize);
-    uint8_t* oldpointer = reinterpret_cast<uint8_t*>(&uncompressedSizeOld);
-    newpointer[0] = oldpointer[3];
-    newpointer[1] = oldpointer[2];
-    newpointer[2] = oldpointer[1];
-    newpointer[3] = oldpointer[0];
+    return NULL;
   }
 
-  if (uncompressedSize == 0)
+  if (!sizeKnown)
   {
     Mineserver::get()->logger()->log(LogType::LOG_WARNING, "NBT", "Unable to determine uncompressed size of " + filename);
-    uncompressedSize = ALLOCATE_NBTFILE;
   }
 
-  uint8_t* uncompressedData = new uint8_t[uncompressedSize];
-  gzFile nbtFile = gzopen(filename.c_str(), "rb");
-  if (nbtFile == NULL)
+  return LoadFromMemory(buffer);
+}
+
+NBT_Value* NBT_Value::LoadFromMemory(std::vector<uint8_t>& buffer)
+{
+  if (buffer.size() < 3)
   {
-    delete[] uncompressedData;
     return NULL;
   }
-  gzread(nbtFile, uncompressedData, uncompressedSize);
-  gzclose(nbtFile);
-
-  uint8_t* ptr = uncompressedData + 3; // Jump blank compound
-  int remaining = uncompressedSize;
 
-  NBT_Value* root = new NBT_Value(TAG_COMPOUND, &ptr, remaining);
+  uint8_t* ptr = &buffer[0] + 3; // Jump blank compound
+  int remaining = buffer.size();
 
-  delete[] uncompressedData;
-
-  return root;
+  return new NBT_Value(TAG_COMPOUND, &ptr, remaining);
 }
 
 void NBT_Value::SaveToFile(const std::string& filename)
 {
   std::vector<uint8_t> buffer;
 
+  SaveToMemory(buffer);
+  writeGzipFile(filename, buffer);
+}
+
+void NBT_Value::SaveToMemory(std::vector<uint8_t>& buffer)
+{
   // Blank compound tag
   buffer.push_back(TAG_COMPOUND);
   buffer.push_back(0);
@@ -590,10 +574,6 @@ void NBT_Value::SaveToFile(const std::string& filename)
   buffer.push_back(0);
   buffer.push_back(0);
   buffer.push_back(0);
-
-  gzFile nbtFile = gzopen(filename.c_str(), "wb");
-  gzwrite(nbtFile, &buffer[0], buffer.size());
-  gzclose(nbtFile);
 }
 
 void NBT_Value::Write(std::vector<uint8_t> &buffer)
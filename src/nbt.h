@@ -101,6 +101,10 @@ public:
   static NBT_Value* LoadFromFile(const std::string& filename);
   void SaveToFile(const std::string& filename);
 
+  // Uncompressed file contents, safe to use off the main thread
+  static NBT_Value* LoadFromMemory(std::vector<uint8_t>& buffer);
+  void SaveToMemory(std::vector<uint8_t>& buffer);
+
   void Write(std::vector<uint8_t> &buffer);
 
   void Dump(std::string& data, const std::string& name = std::string(""), int tabs = 0);
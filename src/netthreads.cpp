@@ -0,0 +1,667 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef WIN32
+#include <winsock2.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include <errno.h>
+#include <algorithm>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "tools.h"
+#include "logger.h"
+#include "mineserver.h"
+#include "user.h"
+#include "packets.h"
+#include "sockets.h"
+#include "spscqueue.h"
+#include "threads.h"
+#include "netthreads.h"
+
+struct NetConnection
+{
+  int fd;
+  NetWorker* worker;
+
+  // Main thread only, NULL once the user has been deleted
+  User* user;
+  // Main thread only, bytes passed to the network thread
+  uint32_t queued;
+
+  // Bytes written to the socket, counted by the network thread
+  volatile int written;
+
+  // Network thread only
+  struct event readEvent;
+  struct event writeEvent;
+  Packet out;
+  bool closed;
+  bool dirty;
+};
+
+// A recv() straight from the socket, handed to the main thread and back
+struct NetRecvBuffer
+{
+  uint8_t data[RECV_SIZE];
+  int len;
+};
+
+struct NetMessage
+{
+  enum Type
+  {
+    // Main thread to network thread
+    ATTACH,
+    WRITE,
+    DETACH,
+    STOP,
+    // Network thread to main thread
+    DATA,
+    CLOSED,
+    // Last message for a connection, the main thread deletes it
+    RELEASED
+  };
+
+  Type type;
+  NetConnection* conn;
+  SharedBuffer* data;
+  int error;
+  // DATA only
+  NetRecvBuffer* received;
+};
+
+struct NetWorker
+{
+  event_base* base;
+  Thread thread;
+
+  // Main thread to network thread
+  SpscQueue<NetMessage> toNet;
+  evutil_socket_t wakeFds[2];
+  struct event wakeEvent;
+  volatile int wakePending;
+  // Receive buffers the main thread is done with
+  SpscQueue<NetRecvBuffer*> spare;
+
+  // Network thread to main thread
+  SpscQueue<NetMessage> toGame;
+  evutil_socket_t gameWakeFd;
+  volatile int* gameWakePending;
+
+  // Network thread only
+  std::vector<NetConnection*> connections;
+  std::vector<NetConnection*> dirty;
+  NetRecvBuffer* recvBuffer;
+
+  // Main thread only
+  bool needsWake;
+
+  // Bytes written by the thread that the main thread hasn't counted yet
+  volatile int written;
+
+  NetWorker() : base(NULL), wakePending(0), gameWakeFd(-1), gameWakePending(NULL), recvBuffer(NULL), needsWake(false), written(0)
+  {
+    wakeFds[0] = wakeFds[1] = -1;
+  }
+};
+
+namespace
+{
+
+void closeSocket(evutil_socket_t fd)
+{
+#ifdef WIN32
+  closesocket(fd);
+#else
+  close(fd);
+#endif
+}
+
+bool openWakePair(evutil_socket_t fds[2])
+{
+#ifdef WIN32
+  int family = AF_INET;
+#else
+  int family = AF_UNIX;
+#endif
+  if (evutil_socketpair(family, SOCK_STREAM, 0, fds) != 0)
+  {
+    fds[0] = fds[1] = -1;
+    return false;
+  }
+  evutil_make_socket_nonblocking(fds[0]);
+  evutil_make_socket_nonblocking(fds[1]);
+  return true;
+}
+
+void closeWakePair(evutil_socket_t fds[2])
+{
+  if (fds[0] != -1)
+  {
+    closeSocket(fds[0]);
+    closeSocket(fds[1]);
+    fds[0] = fds[1] = -1;
+  }
+}
+
+// Make the other side's wake event fire, once until it has drained it
+void wake(evutil_socket_t fd, volatile int* pending)
+{
+  if (atomicExchange(pending, 1) == 0)
+  {
+    char byte = 0;
+    send(fd, &byte, 1, 0);
+  }
+}
+
+// Has to run before the queue is emptied, so that anything pushed after
+// that wakes us again
+void drainWake(evutil_socket_t fd, volatile int* pending)
+{
+  atomicExchange(pending, 0);
+  char bytes[64];
+  while (recv(fd, bytes, sizeof(bytes), 0) > 0)
+  {
+  }
+}
+
+void toGame(NetConnection* conn, NetMessage::Type type, SharedBuffer* data, int error, NetRecvBuffer* received = NULL)
+{
+  // conn may be gone as soon as it's pushed
+  NetWorker* worker = conn->worker;
+  NetMessage msg = { type, conn, data, error, received };
+  worker->toGame.push(msg);
+  wake(worker->gameWakeFd, worker->gameWakePending);
+}
+
+void closeConnection(NetConnection* conn)
+{
+  if (conn->closed)
+  {
+    return;
+  }
+  event_del(&conn->readEvent);
+  event_del(&conn->writeEvent);
+  closeSocket(conn->fd);
+  conn->out.clearWrite(conn->out.getPendingWriteLen());
+  conn->closed = true;
+}
+
+// The client went away or the socket failed, the main thread deletes the
+// user and answers with DETACH
+void dropConnection(NetConnection* conn, int error)
+{
+  if (!conn->closed)
+  {
+    closeConnection(conn);
+    toGame(conn, NetMessage::CLOSED, NULL, error);
+  }
+}
+
+void writeConnection(NetConnection* conn)
+{
+  if (conn->closed || conn->out.getPendingWriteLen() == 0)
+  {
+    return;
+  }
+  int written = client_write(conn->fd, conn->out);
+  if (written == SOCKET_ERROR)
+  {
+    dropConnection(conn, ERROR_NUMBER);
+    return;
+  }
+  atomicAdd(&conn->written, written);
+  atomicAdd(&conn->worker->written, written);
+  if (conn->out.getPendingWriteLen())
+  {
+    event_add(&conn->writeEvent, NULL);
+  }
+}
+
+void readCallback(int fd, short ev, void* arg)
+{
+  NetConnection* conn = (NetConnection*)arg;
+  NetWorker* worker   = conn->worker;
+
+  // Reuse a buffer the main thread has handed back, once there are enough
+  // of them in flight nothing is allocated per read
+  if (worker->recvBuffer == NULL && !worker->spare.pop(worker->recvBuffer))
+  {
+    worker->recvBuffer = new NetRecvBuffer;
+  }
+  NetRecvBuffer* buffer = worker->recvBuffer;
+
+  int read = recv(fd, (char*)buffer->data, sizeof(buffer->data), 0);
+  if (read == 0)
+  {
+    dropConnection(conn, 0);
+    return;
+  }
+  if (read == SOCKET_ERROR)
+  {
+#ifdef WIN32
+    if (ERROR_NUMBER != WSAEWOULDBLOCK && ERROR_NUMBER != WSAEINTR)
+#else
+    if (errno != EAGAIN && errno != EINTR)
+#endif
+    {
+      dropConnection(conn, ERROR_NUMBER);
+    }
+    return;
+  }
+
+  buffer->len = read;
+  worker->recvBuffer = NULL;
+  toGame(conn, NetMessage::DATA, NULL, 0, buffer);
+}
+
+void writeCallback(int fd, short ev, void* arg)
+{
+  writeConnection((NetConnection*)arg);
+}
+
+void workerWakeCallback(int fd, short ev, void* arg)
+{
+  NetWorker* worker = (NetWorker*)arg;
+
+  drainWake(worker->wakeFds[0], &worker->wakePending);
+
+  bool stopping = false;
+  NetMessage msg;
+  while (worker->toNet.pop(msg))
+  {
+    NetConnection* conn = msg.conn;
+    switch (msg.type)
+    {
+    case NetMessage::ATTACH:
+      event_set(&conn->readEvent, conn->fd, EV_READ | EV_PERSIST, readCallback, conn);
+      event_base_set(worker->base, &conn->readEvent);
+      event_add(&conn->readEvent, NULL);
+      event_set(&conn->writeEvent, conn->fd, EV_WRITE, writeCallback, conn);
+      event_base_set(worker->base, &conn->writeEvent);
+      worker->connections.push_back(conn);
+      break;
+
+    case NetMessage::WRITE:
+      if (!conn->closed)
+      {
+        conn->out.addToWrite(msg.data);
+        if (!conn->dirty)
+        {
+          conn->dirty = true;
+          worker->dirty.push_back(conn);
+        }
+      }
+      msg.data->release();
+      break;
+
+    case NetMessage::DETACH:
+      // Last chance for a kick message to get out
+      writeConnection(conn);
+      closeConnection(conn);
+      if (conn->dirty)
+      {
+        worker->dirty.erase(std::find(worker->dirty.begin(), worker->dirty.end(), conn));
+      }
+      worker->connections.erase(std::find(worker->connections.begin(), worker->connections.end(), conn));
+      // Not to be touched after this
+      toGame(conn, NetMessage::RELEASED, NULL, 0);
+      break;
+
+    case NetMessage::STOP:
+      stopping = true;
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  // One writev() per connection for everything queued in this round
+  for (std::vector<NetConnection*>::size_type i = 0; i < worker->dirty.size(); i++)
+  {
+    worker->dirty[i]->dirty = false;
+    writeConnection(worker->dirty[i]);
+  }
+  worker->dirty.clear();
+
+  if (stopping)
+  {
+    for (std::vector<NetConnection*>::size_type i = 0; i < worker->connections.size(); i++)
+    {
+      closeConnection(worker->connections[i]);
+    }
+    event_base_loopbreak(worker->base);
+  }
+}
+
+void workerMain(void* arg)
+{
+  NetWorker* worker = (NetWorker*)arg;
+  event_base_dispatch(worker->base);
+}
+
+}
+
+NetThreads::NetThreads() : m_next(0), m_wakePending(0), m_received(0), m_written(0)
+{
+  m_wakeFds[0] = m_wakeFds[1] = -1;
+}
+
+NetThreads::~NetThreads()
+{
+  shutdown();
+}
+
+bool NetThreads::init(int threads)
+{
+  if (threads <= 0)
+  {
+    return true;
+  }
+
+  if (!openWakePair(m_wakeFds))
+  {
+    return false;
+  }
+  event_set(&m_wakeEvent, m_wakeFds[0], EV_READ | EV_PERSIST, &NetThreads::wakeCallback, this);
+  event_add(&m_wakeEvent, NULL);
+
+  for (int i = 0; i < threads; i++)
+  {
+    NetWorker* worker = new NetWorker;
+    m_workers.push_back(worker);
+
+    worker->gameWakeFd      = m_wakeFds[1];
+    worker->gameWakePending = &m_wakePending;
+    worker->base            = event_base_new();
+    if (worker->base == NULL || !openWakePair(worker->wakeFds))
+    {
+      return false;
+    }
+    event_set(&worker->wakeEvent, worker->wakeFds[0], EV_READ | EV_PERSIST, workerWakeCallback, worker);
+    event_base_set(worker->base, &worker->wakeEvent);
+    event_add(&worker->wakeEvent, NULL);
+
+    if (!worker->thread.start(workerMain, worker))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void NetThreads::shutdown()
+{
+  for (std::vector<NetWorker*>::size_type i = 0; i < m_workers.size(); i++)
+  {
+    NetWorker* worker = m_workers[i];
+    if (worker->wakeFds[0] != -1)
+    {
+      NetMessage msg = { NetMessage::STOP, NULL, NULL, 0 };
+      worker->toNet.push(msg);
+      wake(worker->wakeFds[1], &worker->wakePending);
+    }
+    worker->thread.join();
+
+    // The thread is gone, whatever it left behind is ours now
+    NetMessage msg;
+    while (worker->toGame.pop(msg))
+    {
+      if (msg.type == NetMessage::DATA)
+      {
+        delete msg.received;
+      }
+      else if (msg.type == NetMessage::RELEASED)
+      {
+        delete msg.conn;
+      }
+    }
+    while (worker->toNet.pop(msg))
+    {
+      if (msg.type == NetMessage::WRITE)
+      {
+        msg.data->release();
+      }
+      else if (msg.type == NetMessage::ATTACH)
+      {
+        closeSocket(msg.conn->fd);
+        worker->connections.push_back(msg.conn);
+      }
+    }
+    for (std::vector<NetConnection*>::size_type j = 0; j < worker->connections.size(); j++)
+    {
+      NetConnection* conn = worker->connections[j];
+      if (conn->user != NULL)
+      {
+        conn->user->netConn = NULL;
+        conn->user->fd      = -1;
+      }
+      delete conn;
+    }
+
+    NetRecvBuffer* buffer;
+    while (worker->spare.pop(buffer))
+    {
+      delete buffer;
+    }
+    delete worker->recvBuffer;
+
+    if (worker->base != NULL)
+    {
+      event_base_free(worker->base);
+    }
+    closeWakePair(worker->wakeFds);
+    delete worker;
+  }
+  m_workers.clear();
+
+  if (m_wakeFds[0] != -1)
+  {
+    event_del(&m_wakeEvent);
+    closeWakePair(m_wakeFds);
+  }
+}
+
+void NetThreads::attach(User* user)
+{
+  NetWorker* worker = m_workers[m_next++ % m_workers.size()];
+
+  NetConnection* conn = new NetConnection;
+  conn->fd     = user->fd;
+  conn->worker = worker;
+  conn->user   = user;
+  conn->closed = false;
+  conn->dirty  = false;
+  conn->queued  = 0;
+  conn->written = 0;
+  user->netConn = conn;
+
+  NetMessage msg = { NetMessage::ATTACH, conn, NULL, 0 };
+  worker->toNet.push(msg);
+  wake(worker->wakeFds[1], &worker->wakePending);
+}
+
+void NetThreads::detach(User* user)
+{
+  NetConnection* conn = user->netConn;
+  if (conn == NULL)
+  {
+    return;
+  }
+
+  queueWrite(user);
+  conn->user    = NULL;
+  user->netConn = NULL;
+
+  NetMessage msg = { NetMessage::DETACH, conn, NULL, 0 };
+  conn->worker->toNet.push(msg);
+  conn->worker->needsWake = false;
+  wake(conn->worker->wakeFds[1], &conn->worker->wakePending);
+}
+
+void NetThreads::queueWrite(User* user)
+{
+  if (user->buffer.getPendingWriteLen() == 0)
+  {
+    return;
+  }
+
+  NetWorker* worker = user->netConn->worker;
+  user->netConn->queued += user->buffer.getPendingWriteLen();
+  m_writes.clear();
+  user->buffer.takeWrite(m_writes);
+  for (std::vector<SharedBuffer*>::size_type i = 0; i < m_writes.size(); i++)
+  {
+    NetMessage msg = { NetMessage::WRITE, user->netConn, m_writes[i], 0 };
+    worker->toNet.push(msg);
+  }
+  worker->needsWake = true;
+}
+
+uint64_t NetThreads::bytesWritten()
+{
+  collectWritten();
+  return m_written;
+}
+
+void NetThreads::collectWritten()
+{
+  for (std::vector<NetWorker*>::size_type i = 0; i < m_workers.size(); i++)
+  {
+    const int written = atomicLoad(&m_workers[i]->written);
+    atomicAdd(&m_workers[i]->written, -written);
+    m_written += (uint32_t)written;
+  }
+}
+
+bool NetThreads::sendState(const User* user, uint32_t& pending, uint32_t& written) const
+{
+  if (user->netConn == NULL)
+  {
+    return false;
+  }
+
+  // Both counters wrap, the difference doesn't
+  written = (uint32_t)atomicLoad(&user->netConn->written);
+  pending = user->netConn->queued - written;
+  return true;
+}
+
+void NetThreads::flush()
+{
+  if (!enabled())
+  {
+    return;
+  }
+
+  for (std::vector<User*>::size_type i = 0; i < User::all().size(); i++)
+  {
+    if (User::all()[i]->netConn != NULL)
+    {
+      queueWrite(User::all()[i]);
+    }
+  }
+
+  for (std::vector<NetWorker*>::size_type i = 0; i < m_workers.size(); i++)
+  {
+    if (m_workers[i]->needsWake)
+    {
+      m_workers[i]->needsWake = false;
+      wake(m_workers[i]->wakeFds[1], &m_workers[i]->wakePending);
+    }
+  }
+
+  // Keep the threads' int counters far from overflowing
+  collectWritten();
+}
+
+void NetThreads::wakeCallback(int fd, short ev, void* arg)
+{
+  ((NetThreads*)arg)->process();
+}
+
+void NetThreads::process()
+{
+  drainWake(m_wakeFds[0], &m_wakePending);
+
+  time_t now = time(NULL);
+  for (std::vector<NetWorker*>::size_type i = 0; i < m_workers.size(); i++)
+  {
+    NetMessage msg;
+    while (m_workers[i]->toGame.pop(msg))
+    {
+      User* user = msg.conn->user;
+      switch (msg.type)
+      {
+      case NetMessage::DATA:
+        if (user != NULL)
+        {
+          user->lastData = now;
+          countReceived((uint32_t)msg.received->len);
+          user->buffer.addToRead(msg.received->data, msg.received->len);
+          client_parse(user);
+        }
+        m_workers[i]->spare.push(msg.received);
+        break;
+
+      case NetMessage::CLOSED:
+        if (user != NULL)
+        {
+          if (msg.error == 0)
+          {
+            LOG(INFO, "Sockets", "Socket closed properly");
+          }
+          else
+          {
+            LOG(INFO, "Sockets", "Socket error, code: " + dtos(msg.error));
+          }
+          delete user;
+        }
+        break;
+
+      case NetMessage::RELEASED:
+        delete msg.conn;
+        break;
+
+      default:
+        break;
+      }
+    }
+  }
+
+  // Answers go out right away rather than with the next main loop iteration
+  Mineserver::get()->flushBlockChanges();
+  flush();
+}
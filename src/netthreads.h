@@ -0,0 +1,118 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _NETTHREADS_H
+#define _NETTHREADS_H
+
+#include <vector>
+#include <stdint.h>
+
+#include <event.h>
+
+class User;
+class SharedBuffer;
+struct NetConnection;
+struct NetWorker;
+
+//
+// Network threads, each running its own event_base over a share of the
+// client sockets. They do the recv() and writev() calls; received bytes are
+// passed to the main thread, which parses and handles them as before, and
+// the main thread passes the users' output back. Both directions go through
+// lock-free single producer / single consumer queues, one pair per thread,
+// with a socket pair to wake the other side's event loop.
+//
+class NetThreads
+{
+public:
+  NetThreads();
+  ~NetThreads();
+
+  // Start the threads, needs the main event base. 0 threads keeps all
+  // socket I/O on the main thread.
+  bool init(int threads);
+  // Closes every client socket the threads own
+  void shutdown();
+
+  bool enabled() const
+  {
+    return !m_workers.empty();
+  }
+
+  // Give a freshly accepted client to the next thread
+  void attach(User* user);
+  // The user is being deleted: send what's still queued and close the socket
+  void detach(User* user);
+
+  // Pass the queued output of every user to the network threads
+  void flush();
+
+  // Bytes passed to the user's thread that aren't written yet, and the
+  // running count of bytes written to its socket. False if no thread owns
+  // the user's socket.
+  bool sendState(const User* user, uint32_t& pending, uint32_t& written) const;
+
+  // Bytes received from and written to all clients so far, with or without
+  // threads. Main thread only.
+  void countReceived(uint32_t bytes)
+  {
+    m_received += bytes;
+  }
+  void countWritten(uint32_t bytes)
+  {
+    m_written += bytes;
+  }
+  uint64_t bytesReceived() const
+  {
+    return m_received;
+  }
+  uint64_t bytesWritten();
+
+private:
+  static void wakeCallback(int fd, short ev, void* arg);
+  // Handle everything the network threads have received
+  void process();
+  void queueWrite(User* user);
+  // Move the bytes the threads have written into m_written
+  void collectWritten();
+
+  std::vector<NetWorker*> m_workers;
+  std::vector<NetWorker*>::size_type m_next;
+  std::vector<SharedBuffer*> m_writes;
+
+  evutil_socket_t m_wakeFds[2];
+  struct event m_wakeEvent;
+  volatile int m_wakePending;
+
+  uint64_t m_received;
+  uint64_t m_written;
+
+  NetThreads(const NetThreads&);
+  NetThreads& operator=(const NetThreads&);
+};
+
+#endif
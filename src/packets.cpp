@@ -55,6 +55,7 @@
 #include "chat.h"
 #include "config.h"
 #include "constants.h"
+#include "entitytracker.h"
 #include "furnaceManager.h"
 #include "inventory.h"
 #include "logger.h"
@@ -399,14 +400,14 @@ int PacketHandler::login_request(User* user)
         LOG(INFO, "Packets","  Verified!");
 
         char* kickMessage = NULL;
-        if ((static_cast<Hook2<bool, const char*, char**>*>(Mineserver::get()->plugin()->getHook("PlayerLoginPre")))->doUntilFalse(player.c_str(), &kickMessage))
+        if ((static_cast<Hook2<bool, const char*, char**>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_LOGIN_PRE)))->doUntilFalse(player.c_str(), &kickMessage))
         {
           user->kick(std::string(kickMessage));
         }
         else
         {
           user->sendLoginInfo();
-          (static_cast<Hook1<bool, const char*>*>(Mineserver::get()->plugin()->getHook("PlayerLoginPost")))->doAll(player.c_str());
+          (static_cast<Hook1<bool, const char*>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_LOGIN_POST)))->doAll(player.c_str());
         }
       }
       else
@@ -426,14 +427,14 @@ int PacketHandler::login_request(User* user)
 
 
   char* kickMessage = NULL;
-  if ((static_cast<Hook2<bool, const char*, char**>*>(Mineserver::get()->plugin()->getHook("PlayerLoginPre")))->doUntilFalse(player.c_str(), &kickMessage))
+  if ((static_cast<Hook2<bool, const char*, char**>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_LOGIN_PRE)))->doUntilFalse(player.c_str(), &kickMessage))
   {
     user->kick(std::string(kickMessage));
   }
   else
   {
     user->sendLoginInfo();
-    (static_cast<Hook1<bool, const char*>*>(Mineserver::get()->plugin()->getHook("PlayerLoginPost")))->doAll(player.c_str());
+    (static_cast<Hook1<bool, const char*>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_LOGIN_POST)))->doAll(player.c_str());
   }
 
   return PACKET_OK;
@@ -565,9 +566,13 @@ int PacketHandler::player_position_and_look(User* user)
     return PACKET_NEED_MORE_DATA;
   }
 
-  //Update user data
-  user->updatePos(x, y, z, stance);
-  user->updateLook(yaw, pitch);
+  //Update user data, the look first so others get one packet for both
+  user->pos.yaw   = yaw;
+  user->pos.pitch = pitch;
+  if (!user->updatePos(x, y, z, stance))
+  {
+    user->updateLook(yaw, pitch);
+  }
 
   user->buffer.removePacket();
 
@@ -614,36 +619,32 @@ int PacketHandler::player_digging(User* user)
   {
   case BLOCK_STATUS_STARTED_DIGGING:
   {
-    (static_cast<Hook5<bool, const char*, int32_t, int8_t, int32_t, int8_t>*>(Mineserver::get()->plugin()->getHook("PlayerDiggingStarted")))->doAll(user->nick.c_str(), x, y, z, direction);
+    (static_cast<Hook5<bool, const char*, int32_t, int8_t, int32_t, int8_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_DIGGING_STARTED)))->doAll(user->nick.c_str(), x, y, z, direction);
 
-    for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+    const std::vector<BlockBasic*>& callbacks = Mineserver::get()->plugin()->getBlockCB(block);
+    for (uint32_t i = 0 ; i < callbacks.size(); i++)
     {
-      blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-      if (blockcb != NULL && blockcb->affectedBlock(block))
-      {
-        blockcb->onStartedDigging(user, status, x, y, z, user->pos.map, direction);
-      }
+      blockcb = callbacks[i];
+      blockcb->onStartedDigging(user, status, x, y, z, user->pos.map, direction);
     }
     break;
   }
   case BLOCK_STATUS_DIGGING:
   {
-    (static_cast<Hook5<bool, const char*, int32_t, int8_t, int32_t, int8_t>*>(Mineserver::get()->plugin()->getHook("PlayerDigging")))->doAll(user->nick.c_str(), x, y, z, direction);
-    (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("PlayerDigging")))->doAll(user->nick.c_str(), x, y, z);
-    for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+    (static_cast<Hook5<bool, const char*, int32_t, int8_t, int32_t, int8_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_DIGGING)))->doAll(user->nick.c_str(), x, y, z, direction);
+    (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_DIGGING)))->doAll(user->nick.c_str(), x, y, z);
+    const std::vector<BlockBasic*>& callbacks = Mineserver::get()->plugin()->getBlockCB(block);
+    for (uint32_t i = 0 ; i < callbacks.size(); i++)
     {
-      blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-      if (blockcb != NULL && blockcb->affectedBlock(block))
-      {
-        blockcb->onDigging(user, status, x, y, z, user->pos.map, direction);
-      }
+      blockcb = callbacks[i];
+      blockcb->onDigging(user, status, x, y, z, user->pos.map, direction);
     }
 
     break;
   }
   /*    case BLOCK_STATUS_STOPPED_DIGGING:
       {
-        (static_cast<Hook5<bool,const char*,int32_t,int8_t,int32_t,int8_t>*>(Mineserver::get()->plugin()->getHook("PlayerDiggingStopped")))->doAll(user->nick.c_str(), x, y, z, direction);
+        (static_cast<Hook5<bool,const char*,int32_t,int8_t,int32_t,int8_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_DIGGING_STOPPED)))->doAll(user->nick.c_str(), x, y, z, direction);
         for(uint32_t i =0 ; i<Mineserver::get()->plugin()->getBlockCB().size(); i++)
         {
           blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
@@ -681,113 +682,100 @@ int PacketHandler::player_digging(User* user)
     }
 #undef itemSlot
 
-    if ((static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("BlockBreakPre")))->doUntilFalse(user->nick.c_str(), x, y, z))
+    if ((static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_BREAK_PRE)))->doUntilFalse(user->nick.c_str(), x, y, z))
     {
       blockD.revertBlock(user, x, y, z, user->pos.map);
       return PACKET_OK;
     }
 
-    (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("BlockBreakPost")))->doAll(user->nick.c_str(), x, y, z);
+    (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_BREAK_POST)))->doAll(user->nick.c_str(), x, y, z);
 
-    for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+    const std::vector<BlockBasic*>& callbacks = Mineserver::get()->plugin()->getBlockCB(block);
+    for (uint32_t i = 0 ; i < callbacks.size(); i++)
     {
-      blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-      if (blockcb != NULL && blockcb->affectedBlock(block))
+      blockcb = callbacks[i];
+      if (blockcb->onBroken(user, status, x, y, z, user->pos.map, direction))
       {
-        if (blockcb->onBroken(user, status, x, y, z, user->pos.map, direction))
-        {
-          // Do not break
-          return PACKET_OK;
-        }
-        else
-        {
-          break;
-        }
+        // Do not break
+        return PACKET_OK;
+      }
+      else
+      {
+        break;
       }
     }
 
     /* notify neighbour blocks of the broken block */
+    std::vector<BlockBasic*> neighbourCallbacks;
     status = block;
     if (Mineserver::get()->map(user->pos.map)->getBlock(x + 1, y, z, &block, &meta) && block != BLOCK_AIR)
     {
-      (static_cast<Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("BlockNeighbourBreak")))->doAll(user->nick.c_str(), x + 1, y, z, x, y, z);
-      for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+      (static_cast<Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_NEIGHBOUR_BREAK)))->doAll(user->nick.c_str(), x + 1, y, z, x, y, z);
+      Mineserver::get()->plugin()->getBlockCB(status, block, neighbourCallbacks);
+      for (uint32_t i = 0 ; i < neighbourCallbacks.size(); i++)
       {
-        blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-        if (blockcb != NULL && (blockcb->affectedBlock(status) || blockcb->affectedBlock(block)))
-        {
-          blockcb->onNeighbourBroken(user, status, x + 1, y, z, user->pos.map, BLOCK_SOUTH);
-        }
+        blockcb = neighbourCallbacks[i];
+        blockcb->onNeighbourBroken(user, status, x + 1, y, z, user->pos.map, BLOCK_SOUTH);
       }
 
     }
 
     if (Mineserver::get()->map(user->pos.map)->getBlock(x - 1, y, z, &block, &meta) && block != BLOCK_AIR)
     {
-      (static_cast<Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("BlockNeighbourBreak")))->doAll(user->nick.c_str(), x - 1, y, z, x, y, z);
-      for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+      (static_cast<Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_NEIGHBOUR_BREAK)))->doAll(user->nick.c_str(), x - 1, y, z, x, y, z);
+      Mineserver::get()->plugin()->getBlockCB(status, block, neighbourCallbacks);
+      for (uint32_t i = 0 ; i < neighbourCallbacks.size(); i++)
       {
-        blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-        if (blockcb != NULL && (blockcb->affectedBlock(status) || blockcb->affectedBlock(block)))
-        {
-          blockcb->onNeighbourBroken(user, status, x - 1, y, z, user->pos.map, BLOCK_NORTH);
-        }
+        blockcb = neighbourCallbacks[i];
+        blockcb->onNeighbourBroken(user, status, x - 1, y, z, user->pos.map, BLOCK_NORTH);
       }
 
     }
 
     if (Mineserver::get()->map(user->pos.map)->getBlock(x, y + 1, z, &block, &meta) && block != BLOCK_AIR)
     {
-      (static_cast<Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("BlockNeighbourBreak")))->doAll(user->nick.c_str(), x, y + 1, z, x, y, z);
-      for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+      (static_cast<Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_NEIGHBOUR_BREAK)))->doAll(user->nick.c_str(), x, y + 1, z, x, y, z);
+      Mineserver::get()->plugin()->getBlockCB(status, block, neighbourCallbacks);
+      for (uint32_t i = 0 ; i < neighbourCallbacks.size(); i++)
       {
-        blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-        if (blockcb != NULL && (blockcb->affectedBlock(status) || blockcb->affectedBlock(block)))
-        {
-          blockcb->onNeighbourBroken(user, status, x, y + 1, z, user->pos.map, BLOCK_TOP);
-        }
+        blockcb = neighbourCallbacks[i];
+        blockcb->onNeighbourBroken(user, status, x, y + 1, z, user->pos.map, BLOCK_TOP);
       }
 
     }
 
     if (Mineserver::get()->map(user->pos.map)->getBlock(x, y - 1, z, &block, &meta) && block != BLOCK_AIR)
     {
-      (static_cast<Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("BlockNeighbourBreak")))->doAll(user->nick.c_str(), x, y - 1, z, x, y, z);
-      for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+      (static_cast<Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_NEIGHBOUR_BREAK)))->doAll(user->nick.c_str(), x, y - 1, z, x, y, z);
+      Mineserver::get()->plugin()->getBlockCB(status, block, neighbourCallbacks);
+      for (uint32_t i = 0 ; i < neighbourCallbacks.size(); i++)
       {
-        blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-        if (blockcb != NULL && (blockcb->affectedBlock(status) || blockcb->affectedBlock(block)))
-        {
-          blockcb->onNeighbourBroken(user, status, x, y - 1, z, user->pos.map, BLOCK_BOTTOM);
-        }
+        blockcb = neighbourCallbacks[i];
+        blockcb->onNeighbourBroken(user, status, x, y - 1, z, user->pos.map, BLOCK_BOTTOM);
       }
 
     }
 
     if (Mineserver::get()->map(user->pos.map)->getBlock(x, y, z + 1, &block, &meta) && block != BLOCK_AIR)
     {
-      (static_cast<Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("BlockNeighbourBreak")))->doAll(user->nick.c_str(), x, y, z + 1, x, y, z);
-      for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+      (static_cast<Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_NEIGHBOUR_BREAK)))->doAll(user->nick.c_str(), x, y, z + 1, x, y, z);
+      Mineserver::get()->plugin()->getBlockCB(status, block, neighbourCallbacks);
+      for (uint32_t i = 0 ; i < neighbourCallbacks.size(); i++)
       {
-        blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-        if (blockcb != NULL && (blockcb->affectedBlock(status) || blockcb->affectedBlock(block)))
-        {
-          blockcb->onNeighbourBroken(user, status, x, y, z + 1, user->pos.map, BLOCK_WEST);
-        }
+        blockcb = neighbourCallbacks[i];
+        blockcb->onNeighbourBroken(user, status, x, y, z + 1, user->pos.map, BLOCK_WEST);
       }
 
     }
 
     if (Mineserver::get()->map(user->pos.map)->getBlock(x, y, z - 1, &block, &meta) && block != BLOCK_AIR)
     {
-      (static_cast<Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("BlockNeighbourBreak")))->doAll(user->nick.c_str(), x, y, z - 1, x, y, z);
-      for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+      (static_cast<Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_NEIGHBOUR_BREAK)))->doAll(user->nick.c_str(), x, y, z - 1, x, y, z);
+      Mineserver::get()->plugin()->getBlockCB(status, block, neighbourCallbacks);
+      for (uint32_t i = 0 ; i < neighbourCallbacks.size(); i++)
       {
-        blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-        if (blockcb != NULL && (blockcb->affectedBlock(status) || blockcb->affectedBlock(block)))
-        {
-          blockcb->onNeighbourBroken(user, status, x, y, z - 1, user->pos.map, BLOCK_EAST);
-        }
+        blockcb = neighbourCallbacks[i];
+        blockcb->onNeighbourBroken(user, status, x, y, z - 1, user->pos.map, BLOCK_EAST);
       }
 
     }
@@ -852,7 +840,7 @@ int PacketHandler::player_block_placement(User* user)
   {
     // Right clicked without pointing at a tile
     Item* item = &(user->inv[user->curItem + 36]);
-    if ((static_cast<Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int8_t>*>(Mineserver::get()->plugin()->getHook("ItemRightClickPre")))->doUntilFalse(user->nick.c_str(), x, y, z, item->getType(), direction))
+    if ((static_cast<Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int8_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_ITEM_RIGHT_CLICK_PRE)))->doUntilFalse(user->nick.c_str(), x, y, z, item->getType(), direction))
     {
       return PACKET_OK;
     }
@@ -878,22 +866,20 @@ int PacketHandler::player_block_placement(User* user)
   /* Protocol docs say this should be what interacting is. */
   if (oldblock != BLOCK_AIR)
   {
-    (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("PlayerBlockInteract")))->doAll(user->nick.c_str(), x, y, z);
-    for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+    (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_BLOCK_INTERACT)))->doAll(user->nick.c_str(), x, y, z);
+    const std::vector<BlockBasic*>& callbacks = Mineserver::get()->plugin()->getBlockCB(oldblock);
+    for (uint32_t i = 0 ; i < callbacks.size(); i++)
     {
-      blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-      if (blockcb != NULL && blockcb->affectedBlock(oldblock))
+      blockcb = callbacks[i];
+      //This should actually make the boolean do something. Maybe.
+      if (blockcb->onInteract(user, x, y, z, user->pos.map))
       {
-        //This should actually make the boolean do something. Maybe.
-        if (blockcb->onInteract(user, x, y, z, user->pos.map))
-        {
-          blockD.revertBlock(user, x, y, z, user->pos.map);
-          return PACKET_OK;
-        }
-        else
-        {
-          break;
-        }
+        blockD.revertBlock(user, x, y, z, user->pos.map);
+        return PACKET_OK;
+      }
+      else
+      {
+        break;
       }
     }
   }
@@ -993,21 +979,19 @@ int PacketHandler::player_block_placement(User* user)
 
       // TODO: Does this require some form of recursion for multiple water/lava blocks?
 
-      for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+      const std::vector<BlockBasic*>& callbacks = Mineserver::get()->plugin()->getBlockCB(newblock);
+      for (uint32_t i = 0 ; i < callbacks.size(); i++)
       {
-        blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-        if (blockcb != NULL && blockcb->affectedBlock(newblock))
-        {
-          blockcb->onReplace(user, newblock, check_x, check_y, check_z, user->pos.map, direction);
-        }
+        blockcb = callbacks[i];
+        blockcb->onReplace(user, newblock, check_x, check_y, check_z, user->pos.map, direction);
       }
 
-      if ((static_cast<Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int16_t>*>(Mineserver::get()->plugin()->getHook("BlockReplacePre")))->doUntilFalse(user->nick.c_str(), check_x, check_y, check_z, oldblock, newblock))
+      if ((static_cast<Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int16_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_REPLACE_PRE)))->doUntilFalse(user->nick.c_str(), check_x, check_y, check_z, oldblock, newblock))
       {
         blockD.revertBlock(user, x, y, z, user->pos.map);
         return PACKET_OK;
       }
-      (static_cast<Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int16_t>*>(Mineserver::get()->plugin()->getHook("BlockReplacePost")))->doAll(user->nick.c_str(), check_x, check_y, check_z, oldblock, newblock);
+      (static_cast<Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int16_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_REPLACE_POST)))->doAll(user->nick.c_str(), check_x, check_y, check_z, oldblock, newblock);
     }
     else
     {
@@ -1020,15 +1004,15 @@ int PacketHandler::player_block_placement(User* user)
               }
             }*/
 
-      if ((static_cast<Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int16_t>*>(Mineserver::get()->plugin()->getHook("BlockReplacePre")))->doUntilFalse(user->nick.c_str(), x, y, z, oldblock, newblock))
+      if ((static_cast<Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int16_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_REPLACE_PRE)))->doUntilFalse(user->nick.c_str(), x, y, z, oldblock, newblock))
       {
         blockD.revertBlock(user, x, y, z, user->pos.map);
         return PACKET_OK;
       }
-      (static_cast<Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int16_t>*>(Mineserver::get()->plugin()->getHook("BlockReplacePost")))->doAll(user->nick.c_str(), x, y, z, oldblock, newblock);
+      (static_cast<Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int16_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_REPLACE_POST)))->doAll(user->nick.c_str(), x, y, z, oldblock, newblock);
     }
 
-    if ((static_cast<Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int8_t>*>(Mineserver::get()->plugin()->getHook("BlockPlacePre")))->doUntilFalse(user->nick.c_str(), x, y, z, newblock, direction))
+    if ((static_cast<Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int8_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_PLACE_PRE)))->doUntilFalse(user->nick.c_str(), x, y, z, newblock, direction))
     {
       blockD.revertBlock(user, x, y, z, user->pos.map);
       return PACKET_OK;
@@ -1038,101 +1022,81 @@ int PacketHandler::player_block_placement(User* user)
     the callback doesn't know what type of block we're placing. Instead
     the callback's job is to describe the behaviour when placing the
     block down, not to place any specifically block itself. */
-    for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+    const std::vector<BlockBasic*>& callbacks = Mineserver::get()->plugin()->getBlockCB(newblock);
+    for (uint32_t i = 0 ; i < callbacks.size(); i++)
     {
-      blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-      if (blockcb != NULL && blockcb->affectedBlock(newblock))
+      blockcb = callbacks[i];
+      if (blockcb->onPlace(user, newblock, x, y, z, user->pos.map, direction))
       {
-        if (blockcb->onPlace(user, newblock, x, y, z, user->pos.map, direction))
-        {
-          return PACKET_OK;
-        }
-        else
-        {
-          break;
-        }
+        return PACKET_OK;
+      }
+      else
+      {
+        break;
       }
     }
-    (static_cast<Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int8_t>*>(Mineserver::get()->plugin()->getHook("BlockPlacePost")))->doAll(user->nick.c_str(), x, y, z, newblock, direction);
+    (static_cast<Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int8_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_PLACE_POST)))->doAll(user->nick.c_str(), x, y, z, newblock, direction);
 
     /* notify neighbour blocks of the placed block */
     if (Mineserver::get()->map(user->pos.map)->getBlock(x + 1, y, z, &block, &meta) && block != BLOCK_AIR)
     {
-      for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+      for (uint32_t i = 0 ; i < callbacks.size(); i++)
       {
-        blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-        if (blockcb != NULL && blockcb->affectedBlock(newblock))
-        {
-          blockcb->onNeighbourPlace(user, newblock, x + 1, y, z, user->pos.map, direction);
-        }
+        blockcb = callbacks[i];
+        blockcb->onNeighbourPlace(user, newblock, x + 1, y, z, user->pos.map, direction);
       }
 
-      (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("BlockNeighbourPlace")))->doAll(user->nick.c_str(), x + 1, y, z);
+      (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_NEIGHBOUR_PLACE)))->doAll(user->nick.c_str(), x + 1, y, z);
     }
 
     if (Mineserver::get()->map(user->pos.map)->getBlock(x - 1, y, z, &block, &meta) && block != BLOCK_AIR)
     {
-      for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+      for (uint32_t i = 0 ; i < callbacks.size(); i++)
       {
-        blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-        if (blockcb != NULL && blockcb->affectedBlock(newblock))
-        {
-          blockcb->onNeighbourPlace(user, newblock, x - 1, y, z, user->pos.map, direction);
-        }
+        blockcb = callbacks[i];
+        blockcb->onNeighbourPlace(user, newblock, x - 1, y, z, user->pos.map, direction);
       }
-      (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("BlockNeighbourPlace")))->doAll(user->nick.c_str(), x - 1, y, z);
+      (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_NEIGHBOUR_PLACE)))->doAll(user->nick.c_str(), x - 1, y, z);
     }
 
     if (Mineserver::get()->map(user->pos.map)->getBlock(x, y + 1, z, &block, &meta) && block != BLOCK_AIR)
     {
-      for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+      for (uint32_t i = 0 ; i < callbacks.size(); i++)
       {
-        blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-        if (blockcb != NULL && blockcb->affectedBlock(newblock))
-        {
-          blockcb->onNeighbourPlace(user, newblock, x, y + 1, z, user->pos.map, direction);
-        }
+        blockcb = callbacks[i];
+        blockcb->onNeighbourPlace(user, newblock, x, y + 1, z, user->pos.map, direction);
       }
-      (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("BlockNeighbourPlace")))->doAll(user->nick.c_str(), x, y + 1, z);
+      (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_NEIGHBOUR_PLACE)))->doAll(user->nick.c_str(), x, y + 1, z);
     }
 
     if (Mineserver::get()->map(user->pos.map)->getBlock(x, y - 1, z, &block, &meta) && block != BLOCK_AIR)
     {
-      for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+      for (uint32_t i = 0 ; i < callbacks.size(); i++)
       {
-        blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-        if (blockcb != NULL && blockcb->affectedBlock(newblock))
-        {
-          blockcb->onNeighbourPlace(user, newblock, x, y - 1, z, user->pos.map, direction);
-        }
+        blockcb = callbacks[i];
+        blockcb->onNeighbourPlace(user, newblock, x, y - 1, z, user->pos.map, direction);
       }
-      (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("BlockNeighbourPlace")))->doAll(user->nick.c_str(), x, y - 1, z);
+      (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_NEIGHBOUR_PLACE)))->doAll(user->nick.c_str(), x, y - 1, z);
     }
 
     if (Mineserver::get()->map(user->pos.map)->getBlock(x, y, z + 1, &block, &meta) && block != BLOCK_AIR)
     {
-      for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+      for (uint32_t i = 0 ; i < callbacks.size(); i++)
       {
-        blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-        if (blockcb != NULL && blockcb->affectedBlock(newblock))
-        {
-          blockcb->onNeighbourPlace(user, newblock, x, y, z + 1, user->pos.map, direction);
-        }
+        blockcb = callbacks[i];
+        blockcb->onNeighbourPlace(user, newblock, x, y, z + 1, user->pos.map, direction);
       }
-      (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("BlockNeighbourPlace")))->doAll(user->nick.c_str(), x, y, z + 1);
+      (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_NEIGHBOUR_PLACE)))->doAll(user->nick.c_str(), x, y, z + 1);
     }
 
     if (Mineserver::get()->map(user->pos.map)->getBlock(x, y, z - 1, &block, &meta) && block != BLOCK_AIR)
     {
-      for (uint32_t i = 0 ; i < Mineserver::get()->plugin()->getBlockCB().size(); i++)
+      for (uint32_t i = 0 ; i < callbacks.size(); i++)
       {
-        blockcb = Mineserver::get()->plugin()->getBlockCB()[i];
-        if (blockcb != NULL && blockcb->affectedBlock(newblock))
-        {
-          blockcb->onNeighbourPlace(user, newblock, x, y, z - 1, user->pos.map, direction);
-        }
+        blockcb = callbacks[i];
+        blockcb->onNeighbourPlace(user, newblock, x, y, z - 1, user->pos.map, direction);
       }
-      (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook("BlockNeighbourPlace")))->doAll(user->nick.c_str(), x, y, z - 1);
+      (static_cast<Hook4<bool, const char*, int32_t, int8_t, int32_t>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_BLOCK_NEIGHBOUR_PLACE)))->doAll(user->nick.c_str(), x, y, z - 1);
     }
   }
   // Now we're sure we're using it, lets remove from inventory!
@@ -1171,7 +1135,7 @@ int PacketHandler::holding_change(User* user)
   //Send holding change to others
   Packet pkt;
   pkt << (int8_t)PACKET_ENTITY_EQUIPMENT << (int32_t)user->UID << (int16_t)0 << (int16_t)user->inv[itemSlot + 36].getType() << (int16_t)user->inv[itemSlot + 36].getHealth();
-  user->sendOthers((uint8_t*)pkt.getWrite(), pkt.getWriteLen());
+  Mineserver::get()->entityTracker()->sendToObservers(user->UID, pkt);
 
   // Set current itemID to user
   user->setCurrentItemSlot(itemSlot);
@@ -1195,9 +1159,9 @@ int PacketHandler::arm_animation(User* user)
 
   Packet pkt;
   pkt << (int8_t)PACKET_ARM_ANIMATION << (int32_t)user->UID << animType;
-  user->sendOthers((uint8_t*)pkt.getWrite(), pkt.getWriteLen());
+  Mineserver::get()->entityTracker()->sendToObservers(user->UID, pkt);
 
-  (static_cast<Hook1<bool, const char*>*>(Mineserver::get()->plugin()->getHook("PlayerArmSwing")))->doAll(user->nick.c_str());
+  (static_cast<Hook1<bool, const char*>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_ARM_SWING)))->doAll(user->nick.c_str());
 
   return PACKET_OK;
 }
@@ -1312,7 +1276,7 @@ int PacketHandler::use_entity(User* user)
         {
           Packet pkt;
           pkt << PACKET_DEATH_ANIMATION << (int32_t)User::all()[i]->UID << (int8_t)3;
-          User::all()[i]->sendOthers((uint8_t*)pkt.getWrite(), pkt.getWriteLen());
+          Mineserver::get()->entityTracker()->sendToObservers(User::all()[i]->UID, pkt);
         }
         break;
       }
@@ -31,6 +31,12 @@
 #include <string.h>
 #include <stdint.h>
 
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "atomic.h"
+
 #define PACKET_NEED_MORE_DATA -3
 #define PACKET_DOES_NOT_EXIST -2
 #define PACKET_VARIABLE_LEN   -1
@@ -104,21 +110,153 @@ enum
   PACKET_ATTACH_ENTITY   = 0x27
 };
 
+//
+// Immutable, reference counted bytes for packets that go to more than one
+// client. Broadcasts serialize once into a SharedBuffer and every
+// recipient's Packet queues a reference to it instead of a copy. The
+// reference count is atomic, network threads release what they've sent.
+//
+class SharedBuffer
+{
+public:
+  // Starts with one reference, owned by the caller
+  static SharedBuffer* create(const void* data, size_t len)
+  {
+    SharedBuffer* buffer = new SharedBuffer;
+    buffer->m_data.assign((const uint8_t*)data, (const uint8_t*)data + len);
+    return buffer;
+  }
+
+  // Takes over the bytes of data without copying, data is left empty
+  static SharedBuffer* adopt(std::vector<uint8_t>& data)
+  {
+    SharedBuffer* buffer = new SharedBuffer;
+    buffer->m_data.swap(data);
+    return buffer;
+  }
+
+  void acquire()
+  {
+    atomicIncrement(&m_refs);
+  }
+
+  void release()
+  {
+    if (atomicDecrement(&m_refs) == 0)
+    {
+      delete this;
+    }
+  }
+
+  const uint8_t* data() const
+  {
+    return m_data.empty() ? NULL : &m_data[0];
+  }
+
+  size_t size() const
+  {
+    return m_data.size();
+  }
+
+private:
+  SharedBuffer() : m_refs(1) {}
+  SharedBuffer(const SharedBuffer&);
+  SharedBuffer& operator=(const SharedBuffer&);
+
+  volatile int m_refs;
+  std::vector<uint8_t> m_data;
+};
+
+// One contiguous piece of queued output, for writev()/WSASend()
+struct WriteSlice
+{
+  const uint8_t* data;
+  size_t len;
+};
+
 class Packet
 {
 private:
   typedef std::vector<uint8_t> BufferVector;
+
+  // Received bytes live in m_readBuffer[m_readStart, m_readEnd), the space
+  // after m_readEnd takes the next recv() directly. Parsed packets only move
+  // m_readStart; the unread rest is moved to the front when the tail runs
+  // out of room, so packets stay contiguous and no per-read allocation or
+  // per-packet erase is needed.
   BufferVector m_readBuffer;
+  BufferVector::size_type m_readStart;
   BufferVector::size_type m_readPos;
+  BufferVector::size_type m_readEnd;
   bool m_isValid;
 
+  struct WriteSegment
+  {
+    SharedBuffer* buffer;
+    size_t offset;
+  };
+
+  // Outgoing bytes: shared segments first, then the bytes written into
+  // this packet directly since the last shared one
+  std::deque<WriteSegment> m_writeQueue;
+  size_t m_writeQueueLen;
   BufferVector m_writeBuffer;
+
+  // Turn the private write buffer into a segment, keeps the output in order
+  void sealWrite()
+  {
+    if (!m_writeBuffer.empty())
+    {
+      WriteSegment segment = { SharedBuffer::adopt(m_writeBuffer), 0 };
+      m_writeQueueLen += segment.buffer->size();
+      m_writeQueue.push_back(segment);
+    }
+  }
+
 public:
-  Packet() : m_readPos(0), m_isValid(true) {}
+  enum { SHARED_WRITE_MIN = 64 };
+
+  Packet() : m_readStart(0), m_readPos(0), m_readEnd(0), m_isValid(true), m_writeQueueLen(0) {}
+
+  Packet(const Packet& other) :
+    m_readBuffer(other.m_readBuffer), m_readStart(other.m_readStart), m_readPos(other.m_readPos),
+    m_readEnd(other.m_readEnd), m_isValid(other.m_isValid),
+    m_writeQueue(other.m_writeQueue), m_writeQueueLen(other.m_writeQueueLen), m_writeBuffer(other.m_writeBuffer)
+  {
+    for (size_t i = 0; i < m_writeQueue.size(); i++)
+    {
+      m_writeQueue[i].buffer->acquire();
+    }
+  }
+
+  Packet& operator=(const Packet& other)
+  {
+    if (this != &other)
+    {
+      Packet copy(other);
+      m_readBuffer.swap(copy.m_readBuffer);
+      m_readStart = copy.m_readStart;
+      m_readPos = copy.m_readPos;
+      m_readEnd = copy.m_readEnd;
+      m_isValid = copy.m_isValid;
+      m_writeQueue.swap(copy.m_writeQueue);
+      std::swap(m_writeQueueLen, copy.m_writeQueueLen);
+      m_writeBuffer.swap(copy.m_writeBuffer);
+    }
+    return *this;
+  }
+
+  ~Packet()
+  {
+    for (size_t i = 0; i < m_writeQueue.size(); i++)
+    {
+      m_writeQueue[i].buffer->release();
+    }
+  }
 
   bool haveData(int requiredBytes)
   {
-    return m_isValid = m_isValid && ((m_readPos + requiredBytes) <= m_readBuffer.size());
+    return m_isValid = m_isValid && ((m_readPos + requiredBytes) <= m_readEnd);
   }
 
   operator bool() const
@@ -128,20 +266,69 @@ public:
 
   void reset()
   {
-    m_readPos = 0;
+    m_readPos = m_readStart;
     m_isValid = true;
   }
 
+  // Room for at least minSize more received bytes, for recv() to write into.
+  // Follow up with commitRead() for the bytes actually received.
+  uint8_t* prepareRead(BufferVector::size_type minSize)
+  {
+    if (m_readBuffer.size() - m_readEnd < minSize)
+    {
+      // Move the unread bytes to the front, grow only if that's not enough
+      if (m_readStart > 0)
+      {
+        memmove(&m_readBuffer[0], &m_readBuffer[m_readStart], m_readEnd - m_readStart);
+        m_readPos  -= m_readStart;
+        m_readEnd  -= m_readStart;
+        m_readStart = 0;
+      }
+      if (m_readBuffer.size() - m_readEnd < minSize)
+      {
+        m_readBuffer.resize(m_readEnd + minSize);
+      }
+    }
+    return &m_readBuffer[0] + m_readEnd;
+  }
+
+  BufferVector::size_type readSpace() const
+  {
+    return m_readBuffer.size() - m_readEnd;
+  }
+
+  void commitRead(BufferVector::size_type dataSize)
+  {
+    m_readEnd += dataSize;
+  }
+
   void addToRead(std::vector<uint8_t> &buffer)
   {
-    m_readBuffer.insert(m_readBuffer.end(), buffer.begin(), buffer.end());
+    if (!buffer.empty())
+    {
+      addToRead(&buffer[0], buffer.size());
+    }
   }
 
   void addToRead(const void* data, BufferVector::size_type dataSize)
   {
-    BufferVector::size_type start = m_readBuffer.size();
-    m_readBuffer.resize(start + dataSize);
-    memcpy(&m_readBuffer[start], data, dataSize);
+    if (dataSize == 0)
+    {
+      return;
+    }
+    memcpy(prepareRead(dataSize), data, dataSize);
+    commitRead(dataSize);
+  }
+
+  // Contiguous view of the bytes not parsed yet
+  const uint8_t* readData() const
+  {
+    return m_readBuffer.empty() ? NULL : &m_readBuffer[0] + m_readPos;
+  }
+
+  BufferVector::size_type readAvailable() const
+  {
+    return m_readEnd - m_readPos;
   }
 
   void addToWrite(const void* data, BufferVector::size_type dataSize)
@@ -155,10 +342,29 @@ public:
     memcpy(&m_writeBuffer[start], data, dataSize);
   }
 
+  // Queue a shared buffer for writing, without copying it. Tiny buffers
+  // are cheaper to copy than to track as their own segment.
+  void addToWrite(SharedBuffer* buffer)
+  {
+    if (buffer->size() < SHARED_WRITE_MIN)
+    {
+      addToWrite(buffer->data(), buffer->size());
+      return;
+    }
+    sealWrite();
+    buffer->acquire();
+    WriteSegment segment = { buffer, 0 };
+    m_writeQueueLen += buffer->size();
+    m_writeQueue.push_back(segment);
+  }
+
   void removePacket()
   {
-    m_readBuffer.erase(m_readBuffer.begin(), m_readBuffer.begin() + m_readPos);
-    m_readPos = 0;
+    m_readStart = m_readPos;
+    if (m_readStart == m_readEnd)
+    {
+      m_readStart = m_readPos = m_readEnd = 0;
+    }
   }
 
   Packet& operator<<(int8_t val);
@@ -186,6 +392,8 @@ public:
     }
   }
 
+  // Bytes written into this packet itself, for packets being built.
+  // Shared buffers queued with addToWrite(SharedBuffer*) are not included.
   void* getWrite()
   {
     return &m_writeBuffer[0];
@@ -201,9 +409,68 @@ public:
     return m_writeBuffer.size();
   }
 
-  void clearWrite(int count)
+  // Everything waiting to be sent, shared buffers included
+  size_t getPendingWriteLen() const
+  {
+    return m_writeQueueLen + m_writeBuffer.size();
+  }
+
+  // Fill slices with the pending output in order, returns how many were used
+  int getWriteSlices(WriteSlice* slices, int maxSlices)
+  {
+    sealWrite();
+
+    int count = 0;
+    for (size_t i = 0; i < m_writeQueue.size() && count < maxSlices; i++, count++)
+    {
+      slices[count].data = m_writeQueue[i].buffer->data() + m_writeQueue[i].offset;
+      slices[count].len  = m_writeQueue[i].buffer->size() - m_writeQueue[i].offset;
+    }
+    return count;
+  }
+
+  // Move the pending output to out in order, the caller gets one reference
+  // to each buffer
+  void takeWrite(std::vector<SharedBuffer*>& out)
   {
-    m_writeBuffer.erase(m_writeBuffer.begin(), m_writeBuffer.begin() + count);
+    sealWrite();
+
+    for (size_t i = 0; i < m_writeQueue.size(); i++)
+    {
+      WriteSegment& segment = m_writeQueue[i];
+      if (segment.offset == 0)
+      {
+        out.push_back(segment.buffer);
+        continue;
+      }
+      out.push_back(SharedBuffer::create(segment.buffer->data() + segment.offset,
+                                         segment.buffer->size() - segment.offset));
+      segment.buffer->release();
+    }
+    m_writeQueue.clear();
+    m_writeQueueLen = 0;
+  }
+
+  // Drop count bytes that were sent from the front of the pending output
+  void clearWrite(size_t count)
+  {
+    sealWrite();
+
+    while (count > 0 && !m_writeQueue.empty())
+    {
+      WriteSegment& front = m_writeQueue.front();
+      size_t left = front.buffer->size() - front.offset;
+      if (count < left)
+      {
+        front.offset    += count;
+        m_writeQueueLen -= count;
+        return;
+      }
+      count           -= left;
+      m_writeQueueLen -= left;
+      front.buffer->release();
+      m_writeQueue.pop_front();
+    }
   }
 };
 
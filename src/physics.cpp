@@ -50,6 +50,7 @@ typedef  int socklen_t;
 #include <fstream>
 #include <sstream>
 #include <ctime>
+#include <algorithm>
 
 #include "logger.h"
 #include "constants.h"
@@ -57,6 +58,8 @@ typedef  int socklen_t;
 #include "vec.h"
 #include "mineserver.h"
 #include "tools.h"
+#include "physicsthreads.h"
+#include "profiler.h"
 
 #include "physics.h"
 
@@ -78,242 +81,398 @@ bool isLiquidBlock(int id)
   return ((id == BLOCK_LAVA) || (id == BLOCK_STATIONARY_LAVA) || (id == BLOCK_WATER) || (id == BLOCK_STATIONARY_WATER));
 }
 
-bool mayFallThrough(int id)
+}
+
+const Physics::Liquid Physics::WATER = { BLOCK_WATER, BLOCK_STATIONARY_WATER, 1 };
+const Physics::Liquid Physics::LAVA  = { BLOCK_LAVA, BLOCK_STATIONARY_LAVA, 2 };
+
+namespace
+{
+
+const vec around[6] = { vec(0, 1, 0), vec(1, 0, 0), vec(-1, 0, 0), vec(0, 0, 1), vec(0, 0, -1), vec(0, -1, 0) };
+
+uint64_t blockKey(const vec& pos)
+{
+  return BlockSchedule::key(pos.x(), pos.y(), pos.z());
+}
+
+// Orders block keys by chunk
+struct ChunkOrder
 {
-  return ((id == BLOCK_AIR) || (id == BLOCK_WATER) || (id == BLOCK_STATIONARY_WATER) || (id == BLOCK_SNOW));
+  bool operator()(uint64_t a, uint64_t b) const
+  {
+    const int ax = blockToChunk(BlockSchedule::keyX(a)), bx = blockToChunk(BlockSchedule::keyX(b));
+    if (ax != bx)
+    {
+      return ax < bx;
+    }
+    return blockToChunk(BlockSchedule::keyZ(a)) < blockToChunk(BlockSchedule::keyZ(b));
+  }
+};
+
+// Reads a block the batch can see, its own changes first. A block in a
+// chunk that isn't loaded marks the batch as missing one.
+bool readBlock(PhysicsBatch& batch, const vec& pos, uint8_t* type, uint8_t* meta)
+{
+  if (pos.y() < 0 || pos.y() > 127)
+  {
+    return false;
+  }
+
+  std::map<uint64_t, uint16_t>::const_iterator it = batch.overlay.find(blockKey(pos));
+  if (it != batch.overlay.end())
+  {
+    *type = it->second >> 8;
+    *meta = it->second & 0xff;
+    return true;
+  }
+
+  const sChunk* chunk = batch.chunks[(blockToChunk(pos.z()) - batch.z + 1) * 3 + blockToChunk(pos.x()) - batch.x + 1];
+  if (chunk == NULL)
+  {
+    batch.missed = true;
+    return false;
+  }
+
+  const int index = pos.y() + (blockToChunkBlock(pos.z()) << 7) + (blockToChunkBlock(pos.x()) << 11);
+  *type = chunk->blocks[index];
+  *meta = (pos.y() & 1) ? (chunk->data[index >> 1] >> 4) : (chunk->data[index >> 1] & 0x0f);
+  return true;
+}
+
+void writeBlock(PhysicsBatch& batch, const vec& pos, uint8_t type, uint8_t meta)
+{
+  const PhysicsBatch::Change change = { blockKey(pos), type, meta };
+  batch.changes.push_back(change);
+  batch.overlay[change.key] = (uint16_t)(type << 8 | meta);
+}
+
+}
+
+Physics::Physics()
+  : enabled(false),
+    map(0),
+    m_waterDelay(5),
+    m_lavaDelay(30),
+    m_budget(500),
+    m_perMs(100),
+    m_updates(0),
+    m_rate(0),
+    m_secondUpdates(0),
+    m_second(0)
+{
+}
+
+Physics::~Physics()
+{
+  for (size_t i = 0; i < m_batches.size(); i++)
+  {
+    delete m_batches[i];
+  }
 }
 
+void Physics::configure(int waterDelay, int lavaDelay, int budget)
+{
+  m_waterDelay = waterDelay;
+  m_lavaDelay  = lavaDelay;
+  m_budget     = (budget > 0) ? (size_t)budget : (size_t)-1;
 }
 
 // Physics loop
-bool Physics::update()
+bool Physics::update(uint32_t timeBudgetMs)
 {
   if (!enabled)
   {
     return true;
   }
 
-  // Check if needs to be updated
-  if (simList.empty())
+  if (tickTime != m_second)
+  {
+    m_rate = (m_second == 0) ? m_secondUpdates : (uint32_t)(m_secondUpdates / (tickTime - m_second));
+    m_second        = tickTime;
+    m_secondUpdates = 0;
+  }
+
+  // As many blocks as the last ticks managed in the time budget
+  size_t limit = m_budget;
+  if (timeBudgetMs > 0)
+  {
+    limit = std::min(limit, std::max((size_t)MIN_BLOCKS, (size_t)(m_perMs * timeBudgetMs)));
+  }
+  const uint32_t start = clockMs();
+
+  m_due.clear();
+  m_schedule.takeDue(limit, m_due);
+  if (m_due.empty())
   {
     return true;
   }
+  PROFILE(Profiler::PHYSICS);
 
-  clock_t starttime = clock();
+  // One batch per chunk
+  std::sort(m_due.begin(), m_due.end(), ChunkOrder());
+  Map* world = Mineserver::get()->map(map);
+  size_t batches = 0;
+  for (size_t i = 0; i < m_due.size(); batches++)
+  {
+    if (batches == m_batches.size())
+    {
+      m_batches.push_back(new PhysicsBatch);
+    }
+    PhysicsBatch& batch = *m_batches[batches];
+    batch.physics = this;
+    batch.x       = blockToChunk(BlockSchedule::keyX(m_due[i]));
+    batch.z       = blockToChunk(BlockSchedule::keyZ(m_due[i]));
+    for (int n = 0; n < 9; n++)
+    {
+      batch.chunks[n] = world->chunks.getChunk(batch.x + n % 3 - 1, batch.z + n / 3 - 1);
+    }
 
-  std::vector<int32_t> toRemove;
-  std::vector<vec> toAdd;
+    batch.keys.clear();
+    do
+    {
+      batch.keys.push_back(m_due[i++]);
+    }
+    while (i < m_due.size() && blockToChunk(BlockSchedule::keyX(m_due[i])) == batch.x &&
+           blockToChunk(BlockSchedule::keyZ(m_due[i])) == batch.z);
+  }
 
-  LOG(INFO, "Physics", "Simulating " + dtos(simList.size()) + " items!");
+  // Chunks in a round are at least two apart, their batches never touch
+  // the same block. The next round sees the changes of this one.
+  for (int round = 0; round < 4; round++)
+  {
+    m_round.clear();
+    for (size_t i = 0; i < batches; i++)
+    {
+      if (((m_batches[i]->x & 1) | (m_batches[i]->z & 1) << 1) == round)
+      {
+        m_round.push_back(m_batches[i]);
+      }
+    }
+    if (m_round.empty())
+    {
+      continue;
+    }
+
+    Mineserver::get()->physicsThreads()->run(m_round);
+    for (size_t i = 0; i < m_round.size(); i++)
+    {
+      apply(*m_round[i]);
+    }
+  }
+
+  m_updates       += m_due.size();
+  m_secondUpdates += m_due.size();
 
-  uint32_t listSize = simList.size();
-  // Iterate each simulation
-  for (uint32_t simIt = 0; simIt < listSize; simIt++)
+  // Under a ms only says something if the limit held it back
+  const uint32_t took = clockMs() - start;
+  if (took > 0 || m_due.size() == limit)
   {
-    vec pos = simList[simIt].blocks[0].pos;
-    // Blocks
+    m_perMs += ((double)m_due.size() / (took > 0 ? took : 1) - m_perMs) / 8;
+  }
+  return true;
+}
+
+void Physics::simulate(PhysicsBatch& batch) const
+{
+  batch.changes.clear();
+  batch.wake.clear();
+  batch.missing.clear();
+  batch.overlay.clear();
+
+  for (size_t i = 0; i < batch.keys.size(); i++)
+  {
+    vec pos(BlockSchedule::keyX(batch.keys[i]), BlockSchedule::keyY(batch.keys[i]), BlockSchedule::keyZ(batch.keys[i]));
+
     uint8_t block, meta;
-    Mineserver::get()->map(map)->getBlock(pos, &block, &meta);
+    batch.missed = false;
+    if (!readBlock(batch, pos, &block, &meta))
+    {
+      continue;
+    }
 
-    simList[simIt].blocks[0].id   = block;
-    simList[simIt].blocks[0].meta = meta;
+    const size_t changes = batch.changes.size();
+    const size_t wake    = batch.wake.size();
+    if (isWaterBlock(block))
+    {
+      simulate(batch, pos, block, meta, WATER);
+    }
+    else if (isLavaBlock(block))
+    {
+      simulate(batch, pos, block, meta, LAVA);
+    }
 
-    // Water simulation
-    if (simList[simIt].type == TYPE_WATER)
+    // Took a look outside the loaded chunks, drop what it did and let the
+    // main thread load them first
+    if (batch.missed)
     {
-      if (isWaterBlock(block))
+      for (size_t n = changes; n < batch.changes.size(); n++)
+      {
+        batch.overlay.erase(batch.changes[n].key);
+      }
+      batch.changes.resize(changes);
+      batch.wake.resize(wake);
+      for (size_t n = 0; n < changes; n++)
       {
-        int32_t it = 0;
+        batch.overlay[batch.changes[n].key] = (uint16_t)(batch.changes[n].type << 8 | batch.changes[n].meta);
+      }
+      batch.missing.push_back(batch.keys[i]);
+    }
+  }
+}
+
+void Physics::simulate(PhysicsBatch& batch, const vec& pos, uint8_t block, uint8_t meta, const Liquid& liquid) const
+{
+  const uint8_t level = meta & 0x07;
+  uint8_t nblock, nmeta;
+
+  bool havesource = false;
+  vec toAdd[6];
+  int added = 0;
 
-        //for(int32_t it=simList[simIt].blocks.size()-1; it>=0; it--)
+  // Search for a source if this is not the source
+  if (block != liquid.still)
+  {
+    for (int i = 0; i < 6; i++)
+    {
+      vec local(pos + around[i]);
+      if (readBlock(batch, local, &nblock, &nmeta) && (nblock == liquid.flowing || nblock == liquid.still))
+      {
+        // Above, a source or a higher level feeds this block
+        if (i != 5 && (nblock == liquid.still || (nmeta & 0x07) < level || i == 0))
         {
-          bool havesource = false;
-
-          // Search for water source if this is not the source
-          if (simList[simIt].blocks[it].id != BLOCK_STATIONARY_WATER)
-          {
-            for (int i = 0; i < 6; i++)
-            {
-              vec local(pos);
-
-              switch (i)
-              {
-              case 0:
-                local += vec(0,  1,  0);
-                break; //y++
-              case 1:
-                local += vec(1,  0,  0);
-                break; //x++
-              case 2:
-                local += vec(-1,  0,  0);
-                break; //x--
-              case 3:
-                local += vec(0,  0,  1);
-                break; //z++
-              case 4:
-                local += vec(0,  0, -1);
-                break; //z--
-              case 5:
-                local += vec(0, -1,  0);
-                break; //y--
-              }
-
-              // Search neighboring water blocks for source current
-              if (Mineserver::get()->map(map)->getBlock(local, &block, &meta) && isWaterBlock(block))
-              {
-                // is this the source block
-                if (i != 5 && (block == BLOCK_STATIONARY_WATER || (meta & 0x07) < (simList[simIt].blocks[it].meta & 0x07) || i == 0))
-                {
-                  havesource = true;
-                }
-                //Else we have to search for source to this block also
-                else if (i == 5 || (meta & 0x07) > (simList[simIt].blocks[it].meta & 0x07))
-                {
-                  toAdd.push_back(local);
-                }
-              }
-            }
-          }
-          //Stationary water block is the source
-          else
-          {
-            havesource = true;
-          }
-
-          //If no source, dry block away
-          if (!havesource)
-          {
-            //This block will change so add surrounding blocks to simulation
-            for (uint32_t i = 0; i < toAdd.size(); i++)
-            {
-              addSimulation(toAdd[i]);
-            }
-            //If not dried out yet
-            if (!(simList[simIt].blocks[it].meta & 0x8) && (simList[simIt].blocks[it].meta & 0x07) < M7)
-            {
-              // Set new water level
-              block = BLOCK_WATER;
-              meta  = simList[simIt].blocks[it].meta + 1;
-              Mineserver::get()->map(map)->setBlock(pos, block, meta);
-              Mineserver::get()->map(map)->sendBlockChange(pos, block, meta);
-
-              toRemove.push_back(simIt);
-              addSimulation(pos);
-              // Update simulation meta information
-              // simList[simIt].blocks[it].meta = meta;
-            }
-            //Else this block has dried out
-            else
-            {
-              //Clear and remove simulation
-              Mineserver::get()->map(map)->setBlock(pos, BLOCK_AIR, 0);
-              Mineserver::get()->map(map)->sendBlockChange(pos, BLOCK_AIR, 0);
-              toRemove.push_back(simIt);
-
-              //If below this block has another waterblock, simulate it also
-              if (Mineserver::get()->map(map)->getBlock(pos - vec(0, 1, 0), &block, &meta) &&
-                  isWaterBlock(block))
-              {
-                addSimulation(pos - vec(0, 1, 0));
-              }
-
-            }
-          }
-          //Have source!
-          else
-          {
-            toAdd.clear();
-            vec belowPos(pos - vec(0, 1, 0));
-            // If below is free to fall
-            if (Mineserver::get()->map(map)->getBlock(belowPos, &block, &meta) &&
-                mayFallThrough(block))
-            {
-              // Set new fallblock there
-              block = BLOCK_WATER;
-              meta  = M_FALLING;
-              Mineserver::get()->map(map)->setBlock(belowPos, block, meta);
-              Mineserver::get()->map(map)->sendBlockChange(belowPos, block, meta);
-              // Change simulation-block to current block
-              toRemove.push_back(simIt);
-              addSimulation(belowPos);
-            }
-            //Else if spreading to sides
-            //If water level is at minimum, dont simulate anymore
-            else if ((simList[simIt].blocks[it].meta & M7) != M7)
-            {
-              for (int i = 0; i < 4; i++)
-              {
-                vec local(pos);
-                switch (i)
-                {
-                case 0:
-                  local += vec(1,  0,  0);
-                  break;
-
-                case 1:
-                  local += vec(-1,  0,  0);
-                  break;
-
-                case 2:
-                  local += vec(0,  0,  1);
-                  break;
-
-                case 3:
-                  local += vec(0,  0, -1);
-                  break;
-                }
-
-                if (Mineserver::get()->map(map)->getBlock(local, &block, &meta) &&
-                    mayFallThrough(block))
-                {
-                  //Decrease water level each turn
-                  if (!isWaterBlock(block) || meta > (simList[simIt].blocks[it].meta & 0x07) + 1)
-                  {
-                    meta = (simList[simIt].blocks[it].meta & 0x07) + 1;
-                    Mineserver::get()->map(map)->setBlock(local, BLOCK_WATER, meta);
-                    Mineserver::get()->map(map)->sendBlockChange(local, BLOCK_WATER, meta);
-                    addSimulation(local);
-                  }
-                }
-              } // End for i=0:3
-
-              //Remove this block from simulation
-              toRemove.push_back(simIt);
-            }
-            //Water level at minimum
-            else
-            {
-              //Remove this block from simulation
-              toRemove.push_back(simIt);
-            }
-          }
+          havesource = true;
+        }
+        // Else we have to search for source to this block also
+        else if (i == 5 || (nmeta & 0x07) > level)
+        {
+          toAdd[added++] = local;
         }
-      }
-      //Block has changes
-      else
-      {
-        //Remove this block from simulation
-        toRemove.push_back(simIt);
       }
     }
+  }
+  else
+  {
+    havesource = true;
+  }
+
+  // If no source, dry block away
+  if (!havesource)
+  {
+    // This block will change so add surrounding blocks to simulation
+    for (int i = 0; i < added; i++)
+    {
+      batch.wake.push_back(blockKey(toAdd[i]));
+    }
+
+    if (!(meta & 0x08) && level + liquid.step <= M7)
+    {
+      writeBlock(batch, pos, liquid.flowing, level + liquid.step);
+      batch.wake.push_back(blockKey(pos));
+    }
     else
     {
-      //Remove this block from simulation
-      toRemove.push_back(simIt);
+      writeBlock(batch, pos, BLOCK_AIR, 0);
+    }
+    return;
+  }
+
+  // Falls if it can, and only spreads if it can't
+  const vec below(pos - vec(0, 1, 0));
+  if (readBlock(batch, below, &nblock, &nmeta) && flowInto(batch, below, nblock, nmeta, liquid, M_FALLING))
+  {
+    return;
+  }
+
+  // Spreading to the sides loses level, falling liquid spreads like a source
+  const int next = ((meta & 0x08) ? 0 : level) + liquid.step;
+  if (next > M7)
+  {
+    return;
+  }
+  for (int i = 1; i < 5; i++)
+  {
+    const vec local(pos + around[i]);
+    if (readBlock(batch, local, &nblock, &nmeta))
+    {
+      flowInto(batch, local, nblock, nmeta, liquid, next);
     }
   }
+}
+
+bool Physics::flowInto(PhysicsBatch& batch, const vec& pos, uint8_t block, uint8_t meta, const Liquid& liquid, uint8_t level) const
+{
+  if (block == liquid.still)
+  {
+    return false;
+  }
 
-  std::vector<int>::reverse_iterator rit;
-  for (rit = toRemove.rbegin() ; rit < toRemove.rend(); ++rit)
+  if (block == liquid.flowing)
+  {
+    if (level == M_FALLING)
+    {
+      // Already falling there
+      if (meta == M_FALLING)
+      {
+        return true;
+      }
+    }
+    // Only where the level is lower than what flows in
+    else if ((meta & 0x08) || (meta & 0x07) <= level)
+    {
+      return false;
+    }
+  }
+  // Lava and water meeting, water on a lava source makes obsidian
+  else if (isLiquidBlock(block))
+  {
+    writeBlock(batch, pos, (block == BLOCK_STATIONARY_LAVA) ? BLOCK_OBSIDIAN : BLOCK_COBBLESTONE, 0);
+    for (int i = 0; i < 6; i++)
+    {
+      batch.wake.push_back(blockKey(pos + around[i]));
+    }
+    return true;
+  }
+  else if (block != BLOCK_AIR && block != BLOCK_SNOW)
   {
-    simList.erase(simList.begin() + *rit);
+    return false;
   }
 
-  clock_t endtime = clock() - starttime;
-  LOG(INFO, "Physics", "Exit simulation, took " + dtos(endtime * 1000 / CLOCKS_PER_SEC) + " ms, " + dtos(simList.size()) + " items left");
+  writeBlock(batch, pos, liquid.flowing, level);
+  batch.wake.push_back(blockKey(pos));
   return true;
 }
 
+void Physics::apply(PhysicsBatch& batch)
+{
+  Map* world = Mineserver::get()->map(map);
+
+  for (size_t i = 0; i < batch.changes.size(); i++)
+  {
+    const PhysicsBatch::Change& change = batch.changes[i];
+    const vec pos(BlockSchedule::keyX(change.key), BlockSchedule::keyY(change.key), BlockSchedule::keyZ(change.key));
+    world->setBlock(pos, change.type, change.meta);
+    world->sendBlockChange(pos, change.type, change.meta);
+  }
+
+  for (size_t i = 0; i < batch.wake.size(); i++)
+  {
+    addSimulation(vec(BlockSchedule::keyX(batch.wake[i]), BlockSchedule::keyY(batch.wake[i]), BlockSchedule::keyZ(batch.wake[i])));
+  }
+
+  // Load what they looked at and try again next tick
+  for (size_t i = 0; i < batch.missing.size(); i++)
+  {
+    const vec pos(BlockSchedule::keyX(batch.missing[i]), BlockSchedule::keyY(batch.missing[i]), BlockSchedule::keyZ(batch.missing[i]));
+    uint8_t block, meta;
+    for (int n = 0; n < 6; n++)
+    {
+      world->getBlock(pos + around[n], &block, &meta);
+    }
+    m_schedule.schedule(batch.missing[i], 1);
+  }
+}
+
 // Add world simulation
 bool Physics::addSimulation(vec pos)
 {
@@ -325,18 +484,17 @@ bool Physics::addSimulation(vec pos)
   uint8_t block;
   uint8_t meta;
   Mineserver::get()->map(map)->getBlock(pos, &block, &meta);
-  SimBlock simulationBlock(block, pos, meta);
 
   // Simulating water
   if (isWaterBlock(block))
   {
-    simList.push_back(Sim(TYPE_WATER, simulationBlock));
+    m_schedule.schedule(BlockSchedule::key(pos.x(), pos.y(), pos.z()), m_waterDelay);
     return true;
   }
   // Simulating lava
   else if (isLavaBlock(block))
   {
-    simList.push_back(Sim(TYPE_LAVA, simulationBlock));
+    m_schedule.schedule(BlockSchedule::key(pos.x(), pos.y(), pos.z()), m_lavaDelay);
     return true;
   }
 
@@ -350,20 +508,9 @@ bool Physics::removeSimulation(vec pos)
     return true;
   }
 
-  // Iterate each simulation
-  for (std::vector<Sim>::iterator simIt = simList.begin(); simIt != simList.end(); simIt++)
-  {
-    vec itpos = simIt->blocks[0].pos;
-    if (itpos.x() == pos.x() && itpos.y() == pos.y() && itpos.z() == pos.z())
-    {
-      simList.erase(simIt);
-      return true;
-    }
-  }
-  return false;
+  return m_schedule.cancel(BlockSchedule::key(pos.x(), pos.y(), pos.z()));
 }
 
-
 bool Physics::checkSurrounding(vec pos)
 {
   if (!enabled)
@@ -28,43 +28,135 @@
 #ifndef _PHYSICS_H
 #define _PHYSICS_H
 
+#include <map>
+#include <vector>
+#include <ctime>
+
+#include "vec.h"
+#include "blockschedule.h"
+
+class Physics;
+struct sChunk;
+
+//
+// The due blocks of one chunk. They are simulated against the chunk and
+// its neighbours without going through Map, so batches of chunks that
+// don't touch can run on different threads; the changes are collected and
+// applied on the main thread.
+//
+struct PhysicsBatch
+{
+  struct Change
+  {
+    uint64_t key;
+    uint8_t type;
+    uint8_t meta;
+  };
+
+  Physics* physics;
+  int x;
+  int z;
+  // The chunks around x, z by (dz + 1) * 3 + dx + 1, NULL if not loaded
+  sChunk* chunks[9];
+  std::vector<uint64_t> keys;
+
+  std::vector<Change> changes;
+  // Blocks to schedule once the changes are in
+  std::vector<uint64_t> wake;
+  // Blocks that need a chunk that isn't loaded
+  std::vector<uint64_t> missing;
+
+  // The changes so far by block, type << 8 | meta, read back while simulating
+  std::map<uint64_t, uint16_t> overlay;
+  bool missed;
+};
+
+//
+// Liquid flow for one map. Liquid blocks that may have to change are
+// scheduled for a later tick, water and lava each with their own delay,
+// and update() runs the ones that are due, at most the budget per tick and
+// as many as fit in the time it is given. What doesn't fit is carried over
+// to the next tick.
+//
+// The due blocks are split up by chunk and run in four rounds, a chunk
+// only in a round with chunks at least two apart, over the physics threads.
+//
 class Physics
 {
 public:
+  Physics();
+  ~Physics();
+
   bool enabled;
   int map; // Which map are we affecting?
 
-  bool update();
+  // Delays in ticks, and how many blocks a tick may update at most
+  void configure(int waterDelay, int lavaDelay, int budget);
+
+  // Called every tick, with the ms it may take or 0 for no limit
+  bool update(uint32_t timeBudgetMs = 0);
+  // Runs the due blocks of a batch, on any thread
+  void simulate(PhysicsBatch& batch) const;
   bool addSimulation(vec pos);
   bool removeSimulation(vec pos);
   bool checkSurrounding(vec pos);
 
+  // Blocks waiting to be updated
+  size_t pending() const
+  {
+    return m_schedule.size();
+  }
+  // Due but left for the next tick
+  size_t carried() const
+  {
+    return m_schedule.carried();
+  }
+  // Blocks updated over the last second
+  uint32_t updatesPerSecond() const
+  {
+    return m_rate;
+  }
+  uint64_t updates() const
+  {
+    return m_updates;
+  }
+
 private:
-  enum { TYPE_WATER, TYPE_LAVA } SimType;
-  enum { M0, M1, M2, M3, M4, M5, M6, M7, M_FALLING } SimState;
+  enum { M0, M1, M2, M3, M4, M5, M6, M7, M_FALLING };
+  // Blocks a tick updates even if the time budget looks too small
+  enum { MIN_BLOCKS = 64 };
 
-  struct SimBlock
+  struct Liquid
   {
-    uint8_t id;
-    vec pos;
-    uint8_t meta;
-    SimBlock() {}
-    SimBlock(uint8_t id, vec pos, uint8_t meta)
-    {
-      this->id   = id;
-      this->pos  = pos;
-      this->meta = meta;
-    }
+    uint8_t flowing;
+    uint8_t still;
+    // Level lost per block spread sideways
+    uint8_t step;
   };
+  static const Liquid WATER;
+  static const Liquid LAVA;
 
-  struct Sim
-  {
-    char type;
-    std::vector<SimBlock> blocks;
-    Sim(char stype, SimBlock initblock) : type(stype), blocks(1, initblock) {}
-  };
+  void simulate(PhysicsBatch& batch, const vec& pos, uint8_t block, uint8_t meta, const Liquid& liquid) const;
+  // Liquid flowing into the block at pos, returns true if it changed
+  bool flowInto(PhysicsBatch& batch, const vec& pos, uint8_t block, uint8_t meta, const Liquid& liquid, uint8_t level) const;
+  // Changes made by a batch to the map, and what it woke up to the schedule
+  void apply(PhysicsBatch& batch);
+
+  BlockSchedule m_schedule;
+  std::vector<uint64_t> m_due;
+  std::vector<PhysicsBatch*> m_batches;
+  std::vector<PhysicsBatch*> m_round;
+
+  int m_waterDelay;
+  int m_lavaDelay;
+  size_t m_budget;
+  // Blocks updated per ms, averaged over the last ticks
+  double m_perMs;
 
-  std::vector<Sim> simList;
+  uint64_t m_updates;
+  uint32_t m_rate;
+  uint32_t m_secondUpdates;
+  time_t m_second;
 };
 
 #endif
@@ -0,0 +1,134 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "physics.h"
+#include "physicsthreads.h"
+
+PhysicsThreads::PhysicsThreads() : m_stopping(false), m_batches(NULL), m_next(0), m_running(0)
+{
+}
+
+PhysicsThreads::~PhysicsThreads()
+{
+  shutdown();
+}
+
+bool PhysicsThreads::init(int threads)
+{
+  for (int i = 0; i < threads; i++)
+  {
+    Thread* thread = new Thread;
+    if (!thread->start(&PhysicsThreads::worker, this))
+    {
+      delete thread;
+      return false;
+    }
+    m_workers.push_back(thread);
+  }
+
+  return true;
+}
+
+void PhysicsThreads::shutdown()
+{
+  {
+    MutexLock lock(m_mutex);
+    m_stopping = true;
+    m_wakeup.broadcast();
+  }
+
+  for (std::vector<Thread*>::size_type i = 0; i < m_workers.size(); i++)
+  {
+    m_workers[i]->join();
+    delete m_workers[i];
+  }
+  m_workers.clear();
+}
+
+void PhysicsThreads::run(const std::vector<PhysicsBatch*>& batches)
+{
+  // Not worth waking anyone for
+  if (!enabled() || batches.size() == 1)
+  {
+    for (std::vector<PhysicsBatch*>::size_type i = 0; i < batches.size(); i++)
+    {
+      batches[i]->physics->simulate(*batches[i]);
+    }
+    return;
+  }
+
+  MutexLock lock(m_mutex);
+  m_batches = &batches;
+  m_next    = 0;
+  m_running = 0;
+  m_wakeup.broadcast();
+
+  work();
+
+  while (m_running > 0)
+  {
+    m_finished.wait(m_mutex);
+  }
+  m_batches = NULL;
+}
+
+void PhysicsThreads::work()
+{
+  while (m_batches != NULL && m_next < m_batches->size())
+  {
+    PhysicsBatch* batch = (*m_batches)[m_next++];
+    m_running++;
+
+    m_mutex.unlock();
+    batch->physics->simulate(*batch);
+    m_mutex.lock();
+
+    if (--m_running == 0 && m_next == m_batches->size())
+    {
+      m_finished.signal();
+    }
+  }
+}
+
+void PhysicsThreads::worker(void* arg)
+{
+  PhysicsThreads* self = static_cast<PhysicsThreads*>(arg);
+
+  MutexLock lock(self->m_mutex);
+  for (;;)
+  {
+    while (!self->m_stopping && (self->m_batches == NULL || self->m_next == self->m_batches->size()))
+    {
+      self->m_wakeup.wait(self->m_mutex);
+    }
+    if (self->m_stopping)
+    {
+      return;
+    }
+    self->work();
+  }
+}
@@ -0,0 +1,80 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _PHYSICSTHREADS_H
+#define _PHYSICSTHREADS_H
+
+#include <vector>
+
+#include "threads.h"
+
+struct PhysicsBatch;
+
+//
+// Worker pool for physics. run() hands a round of batches to the workers,
+// takes its share on the calling thread and returns once all of them are
+// done, so the map is never changed while a batch reads it.
+//
+class PhysicsThreads
+{
+public:
+  PhysicsThreads();
+  ~PhysicsThreads();
+
+  // Start the workers, 0 threads runs every batch on the main thread
+  bool init(int threads);
+  void shutdown();
+
+  bool enabled() const
+  {
+    return !m_workers.empty();
+  }
+
+  void run(const std::vector<PhysicsBatch*>& batches);
+
+private:
+  static void worker(void* arg);
+  // Runs batches until there are none left to take, m_mutex is held on
+  // entry and exit
+  void work();
+
+  Mutex m_mutex;
+  Condition m_wakeup;
+  Condition m_finished;
+  bool m_stopping;
+
+  const std::vector<PhysicsBatch*>* m_batches;
+  size_t m_next;
+  size_t m_running;
+
+  std::vector<Thread*> m_workers;
+
+  PhysicsThreads(const PhysicsThreads&);
+  PhysicsThreads& operator=(const PhysicsThreads&);
+};
+
+#endif
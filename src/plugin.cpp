@@ -26,6 +26,7 @@
 */
 
 #include "sys/stat.h"
+#include <algorithm>
 
 #include "mineserver.h"
 #ifdef WIN32
@@ -36,6 +37,7 @@
 
 #include "constants.h"
 #include "logger.h"
+#include "profiler.h"
 
 #include "plugin.h"
 #include "blocks/default.h"
@@ -102,7 +104,19 @@ void Plugin::init()
   BlockCB.push_back(workbenchblock);
   BlockDefault* defaultblock = new BlockDefault();
   BlockCB.push_back(defaultblock);
-  
+
+  // Ask every callback once per id instead of on every block event
+  for (int type = 0; type < BLOCKCB_TYPES; type++)
+  {
+    m_blockCBByType[type].clear();
+    for (size_t i = 0; i < BlockCB.size(); i++)
+    {
+      if (BlockCB[i]->affectedBlock(type))
+      {
+        m_blockCBByType[type].push_back(BlockCB[i]);
+      }
+    }
+  }
 
   ItemFood* fooditem = new ItemFood();
   ItemCB.push_back(fooditem);
@@ -113,11 +127,32 @@ void Plugin::init()
 
 void Plugin::free()
 {
+  for (int type = 0; type < BLOCKCB_TYPES; type++)
+  {
+    m_blockCBByType[type].clear();
+  }
+
   std::vector<BlockBasic*>::iterator it = BlockCB.begin();
   for (; it != BlockCB.end(); ++it)
   {
     delete *it;
   }
+  BlockCB.clear();
+}
+
+void Plugin::getBlockCB(int type1, int type2, std::vector<BlockBasic*>& out) const
+{
+  const std::vector<BlockBasic*>& first  = getBlockCB(type1);
+  const std::vector<BlockBasic*>& second = getBlockCB(type2);
+
+  out.assign(first.begin(), first.end());
+  for (size_t i = 0; i < second.size(); i++)
+  {
+    if (std::find(first.begin(), first.end(), second[i]) == first.end())
+    {
+      out.push_back(second[i]);
+    }
+  }
 }
 
 bool Plugin::loadPlugin(const std::string name, const std::string file)
@@ -219,31 +254,62 @@ void Plugin::unloadPlugin(const std::string name)
 
 bool Plugin::hasHook(const std::string& name) const
 {
-  return m_hooks.find(name) != m_hooks.end();
+  return getHook(getHookID(name)) != NULL;
 }
 
 Hook* Plugin::getHook(const std::string& name) const
 {
-  std::map<const std::string, Hook*>::const_iterator hook = m_hooks.find(name);
+  return getHook(getHookID(name));
+}
+
+int Plugin::getHookID(const std::string& name) const
+{
+  std::map<const std::string, int>::const_iterator id = m_hookIDs.find(name);
 
-  if (hook == m_hooks.end())
+  if (id == m_hookIDs.end())
   {
-    return NULL;
+    return -1;
   }
 
-  return hook->second;
+  return id->second;
 }
 
 void Plugin::setHook(const std::string& name, Hook* hook)
 {
-  m_hooks[name] = hook;
+  int id = getHookID(name);
+
+  if (id == -1)
+  {
+    id = m_hookList.size();
+  }
+
+  setHook(id, name, hook);
+}
+
+void Plugin::setHook(int id, const std::string& name, Hook* hook)
+{
+  if (id >= (int)m_hookList.size())
+  {
+    m_hookList.resize(id + 1, NULL);
+  }
+
+  m_hookIDs[name] = id;
+  m_hookList[id]  = hook;
+
+  if (hook != NULL)
+  {
+    hook->setTimer(Mineserver::get()->profiler()->hookTimer(id, name));
+  }
 }
 
 void Plugin::remHook(const std::string& name)
 {
-  if (hasHook(name))
+  int id = getHookID(name);
+
+  // Keep the ID, callers may have resolved it already
+  if (id != -1)
   {
-    m_hooks.erase(name);
+    m_hookList[id] = NULL;
   }
 }
 
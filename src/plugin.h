@@ -84,11 +84,60 @@
 class Plugin
 {
 public:
+  // IDs of the built-in hooks, fixed at construction so the core can fire
+  // them without looking the name up every time
+  enum
+  {
+    HOOK_TIMER200,
+    HOOK_TIMER1000,
+    HOOK_TIMER10000,
+    HOOK_PLAYER_LOGIN_PRE,
+    HOOK_PLAYER_LOGIN_POST,
+    HOOK_PLAYER_NICK_POST,
+    HOOK_PLAYER_KICK_POST,
+    HOOK_PLAYER_QUIT_POST,
+    HOOK_PLAYER_CHAT_PRE,
+    HOOK_PLAYER_CHAT_POST,
+    HOOK_PLAYER_ARM_SWING,
+    HOOK_PLAYER_DAMAGE_PRE,
+    HOOK_PLAYER_DAMAGE_POST,
+    HOOK_PLAYER_DISCONNECT,
+    HOOK_PLAYER_DIGGING_STARTED,
+    HOOK_PLAYER_DIGGING,
+    HOOK_PLAYER_DIGGING_STOPPED,
+    HOOK_PLAYER_BLOCK_INTERACT,
+    HOOK_BLOCK_BREAK_PRE,
+    HOOK_BLOCK_BREAK_POST,
+    HOOK_BLOCK_NEIGHBOUR_BREAK,
+    HOOK_BLOCK_PLACE_PRE,
+    HOOK_ITEM_RIGHT_CLICK_PRE,
+    HOOK_BLOCK_PLACE_POST,
+    HOOK_BLOCK_NEIGHBOUR_PLACE,
+    HOOK_BLOCK_REPLACE_PRE,
+    HOOK_BLOCK_REPLACE_POST,
+    HOOK_BLOCK_NEIGHBOUR_REPLACE,
+    HOOK_LOG_POST,
+    HOOK_PLAYER_CHAT_COMMAND,
+    HOOK_PLAYER_RESPAWN,
+    HOOK_BUILTIN_COUNT
+  };
+
   // Hook registry stuff
   bool  hasHook(const std::string& name) const;
   Hook* getHook(const std::string& name) const;
   void  setHook(const std::string& name, Hook* hook);
   void  remHook(const std::string& name);
+  // Hook IDs stay valid for the lifetime of the server, even across
+  // remHook()/setHook() of the same name. -1 if the name was never set.
+  int   getHookID(const std::string& name) const;
+  Hook* getHook(int id) const
+  {
+    if (id < 0 || id >= (int)m_hookList.size())
+    {
+      return NULL;
+    }
+    return m_hookList[id];
+  }
   // Load/Unload plugins
   bool loadPlugin(const std::string name, const std::string file = "");
   void unloadPlugin(const std::string name);
@@ -105,59 +154,72 @@ public:
   // Create default hooks
   Plugin()
   {
-    setHook("Timer200", new Hook0<bool>);
-    setHook("Timer1000", new Hook0<bool>);
-    setHook("Timer10000", new Hook0<bool>);
-    setHook("PlayerLoginPre", new Hook2<bool, const char*, char***>);
-    setHook("PlayerLoginPost", new Hook1<bool, const char*>);
-    setHook("PlayerNickPost", new Hook2<bool, const char*, const char*>);
-    setHook("PlayerKickPost", new Hook2<bool, const char*, const char*>);
-    setHook("PlayerQuitPost", new Hook1<bool, const char*>);
-    setHook("PlayerChatPre", new Hook3<bool, const char*, time_t, const char*>);
-    setHook("PlayerChatPost", new Hook3<bool, const char*, time_t, const char*>);
-    setHook("PlayerArmSwing", new Hook1<bool, const char*>);
-    setHook("PlayerDamagePre", new Hook3<bool, const char*, const char*, int>);
-    setHook("PlayerDamagePost", new Hook3<bool, const char*, const char*, int>);
-    setHook("PlayerDisconnect", new Hook3<bool, const char*, uint32_t, uint16_t>);
-    setHook("PlayerDiggingStarted", new Hook5<bool, const char*, int32_t, int8_t, int32_t, int8_t>);
-    setHook("PlayerDigging", new Hook5<bool, const char*, int32_t, int8_t, int32_t, int8_t>);
-    setHook("PlayerDiggingStopped", new Hook5<bool, const char*, int32_t, int8_t, int32_t, int8_t>);
-    setHook("PlayerBlockInteract", new Hook4<bool, const char*, int32_t, int8_t, int32_t>);
-    setHook("BlockBreakPre", new Hook4<bool, const char*, int32_t, int8_t, int32_t>);
-    setHook("BlockBreakPost", new Hook4<bool, const char*, int32_t, int8_t, int32_t>);
-    setHook("BlockNeighbourBreak", new Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>);
-    setHook("BlockPlacePre", new Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int8_t>);
-    setHook("ItemRightClickPre", new Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int8_t>);
-    setHook("BlockPlacePost", new Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int8_t>);
-    setHook("BlockNeighbourPlace", new Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>);
-    setHook("BlockReplacePre", new Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int16_t>);
-    setHook("BlockReplacePost", new Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int16_t>);
-    setHook("BlockNeighbourReplace", new Hook9<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t, int16_t, int16_t>);
-    setHook("LogPost", new Hook3<bool, int, const char*, const char*>);
-    setHook("PlayerChatCommand", new Hook4<bool, const char*, const char*, int, const char**>);
-    setHook("PlayerRespawn", new Hook1<bool, const char*>);
+    setHook(HOOK_TIMER200, "Timer200", new Hook0<bool>);
+    setHook(HOOK_TIMER1000, "Timer1000", new Hook0<bool>);
+    setHook(HOOK_TIMER10000, "Timer10000", new Hook0<bool>);
+    setHook(HOOK_PLAYER_LOGIN_PRE, "PlayerLoginPre", new Hook2<bool, const char*, char***>);
+    setHook(HOOK_PLAYER_LOGIN_POST, "PlayerLoginPost", new Hook1<bool, const char*>);
+    setHook(HOOK_PLAYER_NICK_POST, "PlayerNickPost", new Hook2<bool, const char*, const char*>);
+    setHook(HOOK_PLAYER_KICK_POST, "PlayerKickPost", new Hook2<bool, const char*, const char*>);
+    setHook(HOOK_PLAYER_QUIT_POST, "PlayerQuitPost", new Hook1<bool, const char*>);
+    setHook(HOOK_PLAYER_CHAT_PRE, "PlayerChatPre", new Hook3<bool, const char*, time_t, const char*>);
+    setHook(HOOK_PLAYER_CHAT_POST, "PlayerChatPost", new Hook3<bool, const char*, time_t, const char*>);
+    setHook(HOOK_PLAYER_ARM_SWING, "PlayerArmSwing", new Hook1<bool, const char*>);
+    setHook(HOOK_PLAYER_DAMAGE_PRE, "PlayerDamagePre", new Hook3<bool, const char*, const char*, int>);
+    setHook(HOOK_PLAYER_DAMAGE_POST, "PlayerDamagePost", new Hook3<bool, const char*, const char*, int>);
+    setHook(HOOK_PLAYER_DISCONNECT, "PlayerDisconnect", new Hook3<bool, const char*, uint32_t, uint16_t>);
+    setHook(HOOK_PLAYER_DIGGING_STARTED, "PlayerDiggingStarted", new Hook5<bool, const char*, int32_t, int8_t, int32_t, int8_t>);
+    setHook(HOOK_PLAYER_DIGGING, "PlayerDigging", new Hook5<bool, const char*, int32_t, int8_t, int32_t, int8_t>);
+    setHook(HOOK_PLAYER_DIGGING_STOPPED, "PlayerDiggingStopped", new Hook5<bool, const char*, int32_t, int8_t, int32_t, int8_t>);
+    setHook(HOOK_PLAYER_BLOCK_INTERACT, "PlayerBlockInteract", new Hook4<bool, const char*, int32_t, int8_t, int32_t>);
+    setHook(HOOK_BLOCK_BREAK_PRE, "BlockBreakPre", new Hook4<bool, const char*, int32_t, int8_t, int32_t>);
+    setHook(HOOK_BLOCK_BREAK_POST, "BlockBreakPost", new Hook4<bool, const char*, int32_t, int8_t, int32_t>);
+    setHook(HOOK_BLOCK_NEIGHBOUR_BREAK, "BlockNeighbourBreak", new Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>);
+    setHook(HOOK_BLOCK_PLACE_PRE, "BlockPlacePre", new Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int8_t>);
+    setHook(HOOK_ITEM_RIGHT_CLICK_PRE, "ItemRightClickPre", new Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int8_t>);
+    setHook(HOOK_BLOCK_PLACE_POST, "BlockPlacePost", new Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int8_t>);
+    setHook(HOOK_BLOCK_NEIGHBOUR_PLACE, "BlockNeighbourPlace", new Hook7<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t>);
+    setHook(HOOK_BLOCK_REPLACE_PRE, "BlockReplacePre", new Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int16_t>);
+    setHook(HOOK_BLOCK_REPLACE_POST, "BlockReplacePost", new Hook6<bool, const char*, int32_t, int8_t, int32_t, int16_t, int16_t>);
+    setHook(HOOK_BLOCK_NEIGHBOUR_REPLACE, "BlockNeighbourReplace", new Hook9<bool, const char*, int32_t, int8_t, int32_t, int32_t, int8_t, int32_t, int16_t, int16_t>);
+    setHook(HOOK_LOG_POST, "LogPost", new Hook3<bool, int, const char*, const char*>);
+    setHook(HOOK_PLAYER_CHAT_COMMAND, "PlayerChatCommand", new Hook4<bool, const char*, const char*, int, const char**>);
+    setHook(HOOK_PLAYER_RESPAWN, "PlayerRespawn", new Hook1<bool, const char*>);
 
     init();
   }
   // Remove existing hooks
   ~Plugin()
   {
-    std::map<const std::string, Hook*>::iterator it = m_hooks.begin();
-    for (; it != m_hooks.end(); ++it)
+    std::vector<Hook*>::iterator it = m_hookList.begin();
+    for (; it != m_hookList.end(); ++it)
     {
-      delete it->second;
+      delete *it;
     }
-    m_hooks.clear();
+    m_hookList.clear();
+    m_hookIDs.clear();
 
     free();
   }
 
   void init();
   void free();
-  std::vector<BlockBasic*> getBlockCB()
+  const std::vector<BlockBasic*>& getBlockCB() const
   {
     return BlockCB;
   }
+  // Block callbacks whose affectedBlock() accepts this block or item id,
+  // in the order they were registered
+  const std::vector<BlockBasic*>& getBlockCB(int type) const
+  {
+    if (type < 0 || type >= BLOCKCB_TYPES)
+    {
+      return m_noBlockCB;
+    }
+    return m_blockCBByType[type];
+  }
+  // Block callbacks for either of two ids, each callback once
+  void getBlockCB(int type1, int type2, std::vector<BlockBasic*>& out) const;
   std::vector<ItemBasic*> getItemCB()
   {
     return ItemCB;
@@ -166,13 +228,21 @@ public:
 
 
 private:
-  std::map<const std::string, Hook*> m_hooks;
+  void setHook(int id, const std::string& name, Hook* hook);
+
+  std::vector<Hook*> m_hookList;
+  std::map<const std::string, int> m_hookIDs;
   std::map<const std::string, LIBRARY_HANDLE> m_libraryHandles;
   std::map<const std::string, void*> m_pointers;
   std::map<const std::string, float> m_pluginVersions;
 
   std::vector<BlockBasic*> BlockCB;
   std::vector<ItemBasic*> ItemCB;
+
+  // Dispatch table for getBlockCB(type), covers all block and item ids
+  enum { BLOCKCB_TYPES = ITEM_GREEN_RECORD + 1 };
+  std::vector<BlockBasic*> m_blockCBByType[BLOCKCB_TYPES];
+  std::vector<BlockBasic*> m_noBlockCB;
 };
 
 #endif
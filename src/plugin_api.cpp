@@ -194,6 +194,50 @@ void hook_doAll(const char* hookID, ...)
   va_end(argList);
 }
 
+// Same as above, with an ID from plugin.getHookID() instead of the name
+int plugin_getHookID(const char* hookID)
+{
+  return Mineserver::get()->plugin()->getHookID(hookID);
+}
+
+void hook_addCallbackID(int hookID, void* function)
+{
+  Mineserver::get()->plugin()->getHook(hookID)->addCallback(function);
+}
+
+void hook_remCallbackID(int hookID, void* function)
+{
+  Mineserver::get()->plugin()->getHook(hookID)->remCallback(function);
+}
+
+bool hook_doUntilTrueID(int hookID, ...)
+{
+  bool result = false;
+  va_list argList;
+  va_start(argList, hookID);
+  result = Mineserver::get()->plugin()->getHook(hookID)->doUntilTrueVA(argList);
+  va_end(argList);
+  return result;
+}
+
+bool hook_doUntilFalseID(int hookID, ...)
+{
+  bool result = false;
+  va_list argList;
+  va_start(argList, hookID);
+  result = Mineserver::get()->plugin()->getHook(hookID)->doUntilFalseVA(argList);
+  va_end(argList);
+  return result;
+}
+
+void hook_doAllID(int hookID, ...)
+{
+  va_list argList;
+  va_start(argList, hookID);
+  Mineserver::get()->plugin()->getHook(hookID)->doAllVA(argList);
+  va_end(argList);
+}
+
 // LOGGER WRAPPER FUNCTIONS
 void logger_log(int type, const char* source, const char* message)
 {
@@ -1034,6 +1078,12 @@ void init_plugin_api(void)
   plugin_api_pointers.plugin.doUntilTrue           = &hook_doUntilTrue;
   plugin_api_pointers.plugin.doUntilFalse          = &hook_doUntilFalse;
   plugin_api_pointers.plugin.doAll                 = &hook_doAll;
+  plugin_api_pointers.plugin.getHookID             = &plugin_getHookID;
+  plugin_api_pointers.plugin.addCallbackID         = &hook_addCallbackID;
+  plugin_api_pointers.plugin.remCallbackID         = &hook_remCallbackID;
+  plugin_api_pointers.plugin.doUntilTrueID         = &hook_doUntilTrueID;
+  plugin_api_pointers.plugin.doUntilFalseID        = &hook_doUntilFalseID;
+  plugin_api_pointers.plugin.doAllID               = &hook_doAllID;
 
   plugin_api_pointers.map.setTime                  = &map_setTime;
   plugin_api_pointers.map.createPickupSpawn        = &map_createPickupSpawn;
@@ -80,7 +80,16 @@ struct plugin_pointer_struct
   bool (*doUntilFalse)(const char* hookID, ...);
   void (*doAll)(const char* hookID, ...);
 
-  void* temp[10];
+  // Resolve a hook name once with getHookID() and fire it by ID afterwards,
+  // IDs stay valid for as long as the server runs
+  int (*getHookID)(const char* hookID);
+  void (*addCallbackID)(int hookID, void* function);
+  void (*remCallbackID)(int hookID, void* function);
+  bool (*doUntilTrueID)(int hookID, ...);
+  bool (*doUntilFalseID)(int hookID, ...);
+  void (*doAllID)(int hookID, ...);
+
+  void* temp[4];
 };
 
 struct user_pointer_struct
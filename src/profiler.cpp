@@ -0,0 +1,334 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "profiler.h"
+
+void Histogram::reset()
+{
+  memset(m_counts, 0, sizeof(m_counts));
+  m_count = 0;
+  m_total = 0;
+  m_max   = 0;
+}
+
+void Histogram::add(const Histogram& other)
+{
+  for (int i = 0; i < BUCKETS; i++)
+  {
+    m_counts[i] += other.m_counts[i];
+  }
+  m_count += other.m_count;
+  m_total += other.m_total;
+  m_max    = std::max(m_max, other.m_max);
+}
+
+int Histogram::bucket(uint32_t us)
+{
+  if (us < SUB_BUCKETS)
+  {
+    return us;
+  }
+
+#ifdef __GNUC__
+  const int top = 31 - __builtin_clz(us);
+#else
+  int top = 31;
+  while (!(us >> top))
+  {
+    top--;
+  }
+#endif
+  const int shift = top - SUB_BITS;
+  return (shift + 1) * SUB_BUCKETS + (int)(us >> shift) - SUB_BUCKETS;
+}
+
+uint32_t Histogram::bucketTop(int bucket)
+{
+  if (bucket < SUB_BUCKETS)
+  {
+    return bucket;
+  }
+
+  const int shift = bucket / SUB_BUCKETS - 1;
+  const uint32_t low = (uint32_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+  return low + ((1U << shift) - 1);
+}
+
+uint32_t Histogram::percentile(double percent) const
+{
+  if (m_count == 0)
+  {
+    return 0;
+  }
+
+  uint64_t wanted = (uint64_t)(m_count * percent / 100.0 + 0.5);
+  if (wanted < 1)
+  {
+    wanted = 1;
+  }
+
+  uint64_t seen = 0;
+  for (int i = 0; i < BUCKETS; i++)
+  {
+    seen += m_counts[i];
+    if (seen >= wanted)
+    {
+      return std::min(bucketTop(i), m_max);
+    }
+  }
+  return m_max;
+}
+
+// Records the calls of one hook
+class Profiler::ProbeTimer : public HookTimer
+{
+public:
+  ProbeTimer(Profiler* profiler, int probe)
+    : m_profiler(profiler),
+      m_probe(probe)
+  {
+  }
+
+  uint64_t start()
+  {
+    return m_profiler->enabled() ? Profiler::now() : 0;
+  }
+  void stop(uint64_t started)
+  {
+    // Not started while profiling was off, even if it is on by now
+    if (started != 0)
+    {
+      m_profiler->record(m_probe, (uint32_t)(Profiler::now() - started));
+    }
+  }
+
+private:
+  Profiler* m_profiler;
+  int m_probe;
+};
+
+namespace
+{
+
+const char* const PROBE_NAMES[] =
+{
+  "tick", "chunk send", "chunk gen", "chunk load", "chunk save", "light", "compress", "physics", "map save"
+};
+
+std::string formatUs(uint64_t us)
+{
+  std::ostringstream out;
+  if (us < 1000)
+  {
+    out << us << "us";
+  }
+  else if (us < 1000000)
+  {
+    out << std::fixed << std::setprecision(1) << us / 1000.0 << "ms";
+  }
+  else
+  {
+    out << std::fixed << std::setprecision(2) << us / 1000000.0 << "s";
+  }
+  return out.str();
+}
+
+struct ByTotal
+{
+  const std::vector<Histogram*>& probes;
+  explicit ByTotal(const std::vector<Histogram*>& p) : probes(p) {}
+  bool operator()(int a, int b) const
+  {
+    return probes[a]->total() > probes[b]->total();
+  }
+};
+
+}
+
+Profiler::Profiler()
+  : m_enabled(false),
+    m_probes(PROBE_COUNT, (Histogram*)NULL),
+    m_hookNames(HOOK_PROBES),
+    m_hookTimers(HOOK_PROBES, (ProbeTimer*)NULL),
+    m_since(now())
+{
+}
+
+Profiler::~Profiler()
+{
+  for (size_t i = 0; i < m_probes.size(); i++)
+  {
+    delete m_probes[i];
+  }
+  for (size_t i = 0; i < m_hookTimers.size(); i++)
+  {
+    delete m_hookTimers[i];
+  }
+}
+
+uint64_t Profiler::now()
+{
+#ifdef WIN32
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (uint64_t)(count.QuadPart / frequency.QuadPart) * 1000000 +
+         (uint64_t)(count.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+void Profiler::record(int probe, uint32_t us)
+{
+  if (!m_enabled || probe < 0 || probe >= PROBE_COUNT)
+  {
+    return;
+  }
+  if (m_probes[probe] == NULL)
+  {
+    m_probes[probe] = new Histogram;
+  }
+  m_probes[probe]->record(us);
+}
+
+HookTimer* Profiler::hookTimer(int id, const std::string& name)
+{
+  if (id < 0 || id >= HOOK_PROBES)
+  {
+    return NULL;
+  }
+
+  m_hookNames[id] = name;
+  if (m_hookTimers[id] == NULL)
+  {
+    m_hookTimers[id] = new ProbeTimer(this, HOOK + id);
+  }
+  return m_hookTimers[id];
+}
+
+void Profiler::reset()
+{
+  for (size_t i = 0; i < m_probes.size(); i++)
+  {
+    if (m_probes[i] != NULL)
+    {
+      m_probes[i]->reset();
+    }
+  }
+  m_since = now();
+}
+
+std::string Profiler::probeName(int probe) const
+{
+  std::ostringstream out;
+  if (probe >= HOOK)
+  {
+    out << "hook " << m_hookNames[probe - HOOK];
+  }
+  else if (probe >= PACKET)
+  {
+    out << "packet 0x" << std::hex << std::setw(2) << std::setfill('0') << probe - PACKET;
+  }
+  else if (probe < (int)(sizeof(PROBE_NAMES) / sizeof(PROBE_NAMES[0])))
+  {
+    out << PROBE_NAMES[probe];
+  }
+  else
+  {
+    out << "probe " << probe;
+  }
+  return out.str();
+}
+
+void Profiler::report(std::vector<std::string>& lines, size_t limit) const
+{
+  std::vector<int> used;
+  for (int i = 0; i < PROBE_COUNT; i++)
+  {
+    if (m_probes[i] != NULL && m_probes[i]->count() > 0)
+    {
+      used.push_back(i);
+    }
+  }
+  std::sort(used.begin(), used.end(), ByTotal(m_probes));
+  if (limit != 0 && used.size() > limit)
+  {
+    used.resize(limit);
+  }
+
+  for (size_t i = 0; i < used.size(); i++)
+  {
+    const Histogram& h = *m_probes[used[i]];
+    std::ostringstream line;
+    line << probeName(used[i]) << ": " << h.count() << " calls, " << formatUs(h.total()) << " total, p50 "
+         << formatUs(h.percentile(50)) << " p90 " << formatUs(h.percentile(90)) << " p99 "
+         << formatUs(h.percentile(99)) << " max " << formatUs(h.max());
+    lines.push_back(line.str());
+  }
+}
+
+bool Profiler::dump(const std::string& filename) const
+{
+  std::ofstream out(filename.c_str(), std::ios_base::out | std::ios_base::trunc);
+  if (!out.is_open())
+  {
+    return false;
+  }
+
+  time_t rawTime = time(NULL);
+  char stamp[32];
+  strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&rawTime));
+  out << "Mineserver profile at " << stamp << ", over the last " << formatUs(now() - m_since) << "\n";
+
+  std::vector<std::string> lines;
+  report(lines);
+  for (size_t i = 0; i < lines.size(); i++)
+  {
+    out << lines[i] << "\n";
+  }
+  return out.good();
+}
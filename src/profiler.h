@@ -0,0 +1,191 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "hook.h"
+
+//
+// Durations in microseconds, counted in buckets that split every power of
+// two into SUB_BUCKETS, HDR histogram style. Every value lands in a bucket
+// within about 6% of it, from 1us to over an hour, in under 2KB.
+//
+class Histogram
+{
+public:
+  enum
+  {
+    SUB_BITS    = 4,
+    SUB_BUCKETS = 1 << SUB_BITS,
+    BUCKETS     = (33 - SUB_BITS) * SUB_BUCKETS
+  };
+
+  Histogram()
+  {
+    reset();
+  }
+
+  void record(uint32_t us)
+  {
+    m_counts[bucket(us)]++;
+    m_count++;
+    m_total += us;
+    if (us > m_max)
+    {
+      m_max = us;
+    }
+  }
+  void reset();
+  // Add the samples of another histogram
+  void add(const Histogram& other);
+
+  uint64_t count() const
+  {
+    return m_count;
+  }
+  uint64_t total() const
+  {
+    return m_total;
+  }
+  uint32_t max() const
+  {
+    return m_max;
+  }
+  // Value no more than percent of the samples are above, to bucket accuracy
+  uint32_t percentile(double percent) const;
+
+private:
+  static int bucket(uint32_t us);
+  // Highest value in a bucket
+  static uint32_t bucketTop(int bucket);
+
+  uint32_t m_counts[BUCKETS];
+  uint64_t m_count;
+  uint64_t m_total;
+  uint32_t m_max;
+};
+
+//
+// Latency histograms for where the time of a tick goes, one per probe:
+// each subsystem, each packet opcode and each plugin hook. Recording
+// happens on the main thread only, work done by the worker threads is
+// timed there and recorded when the main thread picks it up.
+//
+// While disabled a probe costs a branch. Use PROFILE() for a scope.
+//
+class Profiler
+{
+public:
+  enum Probe
+  {
+    TICK,
+    CHUNK_SEND,
+    CHUNK_GEN,
+    CHUNK_LOAD,
+    CHUNK_SAVE,
+    LIGHT,
+    COMPRESS,
+    PHYSICS,
+    SAVE,
+    // One per opcode
+    PACKET = 16,
+    // One per hook ID
+    HOOK = PACKET + 256,
+    HOOK_PROBES = 128,
+    PROBE_COUNT = HOOK + HOOK_PROBES
+  };
+
+  Profiler();
+  ~Profiler();
+
+  bool enabled() const
+  {
+    return m_enabled;
+  }
+  void setEnabled(bool enabled)
+  {
+    m_enabled = enabled;
+  }
+
+  // Microseconds on a monotonic clock
+  static uint64_t now();
+
+  // Ignored while disabled
+  void record(int probe, uint32_t us);
+  // Timer for the hook with the given ID, owned by the profiler
+  HookTimer* hookTimer(int id, const std::string& name);
+
+  // Drop what was recorded so far
+  void reset();
+  // One line per probe that has samples, the most time spent first
+  void report(std::vector<std::string>& lines, size_t limit = 0) const;
+  // Write the report to a file, replacing what was there
+  bool dump(const std::string& filename) const;
+
+private:
+  class ProbeTimer;
+
+  std::string probeName(int probe) const;
+
+  bool m_enabled;
+  std::vector<Histogram*> m_probes;
+  std::vector<std::string> m_hookNames;
+  std::vector<ProbeTimer*> m_hookTimers;
+  uint64_t m_since;
+};
+
+class ProfileScope
+{
+public:
+  ProfileScope(Profiler* profiler, int probe)
+    : m_profiler(profiler->enabled() ? profiler : NULL),
+      m_probe(probe),
+      m_start(m_profiler != NULL ? Profiler::now() : 0)
+  {
+  }
+  ~ProfileScope()
+  {
+    if (m_profiler != NULL)
+    {
+      m_profiler->record(m_probe, (uint32_t)(Profiler::now() - m_start));
+    }
+  }
+
+private:
+  Profiler* m_profiler;
+  int m_probe;
+  uint64_t m_start;
+};
+
+#define PROFILE(probe) ProfileScope profileScope(Mineserver::get()->profiler(), probe)
+
+#endif
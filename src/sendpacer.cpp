@@ -0,0 +1,183 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tools.h"
+#include "sendpacer.h"
+
+namespace
+{
+
+// Chunks sent in a round may not have reached the output yet when it ends,
+// so rounds don't get any shorter than this
+const uint32_t ROUND_MS = 100;
+// Output to keep waiting: this much of the drain rate, but at least
+// MIN_BACKLOG so a fresh connection gets going
+const uint32_t BACKLOG_MS  = 500;
+const uint32_t MIN_BACKLOG = 32 * 1024;
+// What a chunk is taken to cost until some have been sent
+const uint32_t CHUNK_BYTES     = 8 * 1024;
+const uint32_t MIN_CHUNK_BYTES = 512;
+const uint32_t MAX_CHUNK_BYTES = 96 * 1024;
+
+}
+
+uint32_t SendPacer::s_maxBacklog = 512 * 1024;
+int SendPacer::s_maxChunks       = 32;
+uint32_t SendPacer::s_rateLimit  = 0;
+
+void SendPacer::configure(uint32_t maxBacklog, int maxChunks, uint32_t rateLimit)
+{
+  s_maxBacklog = maxBacklog;
+  s_maxChunks  = (maxChunks < 1) ? 1 : maxChunks;
+  s_rateLimit  = rateLimit;
+}
+
+SendPacer::SendPacer()
+  : m_rateLimit(s_rateLimit),
+    m_roundStart(0),
+    m_started(false),
+    m_left(0),
+    m_roundChunks(0),
+    m_lastBacklog(0),
+    m_lastWritten(0),
+    m_rate(0),
+    m_chunkBytes(CHUNK_BYTES),
+    m_tokens(0),
+    m_chunksSent(0),
+    m_bytesWritten(0),
+    m_throttled(0)
+{
+}
+
+int SendPacer::budget(uint32_t backlog, uint32_t written)
+{
+  const uint32_t now = clockMs();
+
+  if (!m_started)
+  {
+    m_started = true;
+    m_tokens  = (m_rateLimit > m_chunkBytes) ? m_rateLimit : m_chunkBytes;
+  }
+  else
+  {
+    const uint32_t elapsed = now - m_roundStart;
+    if (elapsed < ROUND_MS)
+    {
+      return m_left;
+    }
+
+    const uint32_t drained = written - m_lastWritten;
+    m_bytesWritten += drained;
+
+    // The drain only tells what the link takes while output was waiting
+    // all along, or if it's more than we thought
+    const uint32_t sample = (uint32_t)((uint64_t)drained * 1000 / elapsed);
+    if ((m_lastBacklog > 0 && backlog > 0) || sample > m_rate)
+    {
+      m_rate = (m_rate == 0) ? sample : (uint32_t)(((uint64_t)m_rate * 3 + sample) / 4);
+    }
+
+    // What the chunks of the last round added to the output
+    if (m_roundChunks > 0)
+    {
+      const int64_t produced = (int64_t)drained + backlog - m_lastBacklog;
+      if (produced > 0)
+      {
+        uint32_t size = (uint32_t)(produced / m_roundChunks);
+        size = (size < MIN_CHUNK_BYTES) ? MIN_CHUNK_BYTES : (size > MAX_CHUNK_BYTES) ? MAX_CHUNK_BYTES : size;
+        m_chunkBytes = (m_chunkBytes * 3 + size) / 4;
+      }
+    }
+
+    if (m_rateLimit)
+    {
+      // Up to a second's worth saved up
+      const uint32_t burst  = (m_rateLimit > m_chunkBytes) ? m_rateLimit : m_chunkBytes;
+      const uint64_t tokens = m_tokens + (uint64_t)m_rateLimit * elapsed / 1000;
+      m_tokens = (tokens > burst) ? burst : (uint32_t)tokens;
+    }
+  }
+
+  m_roundStart  = now;
+  m_lastBacklog = backlog;
+  m_lastWritten = written;
+  m_roundChunks = 0;
+
+  m_left = roundBudget(backlog);
+  if (m_left == 0)
+  {
+    m_throttled++;
+  }
+  return m_left;
+}
+
+void SendPacer::sent(int count)
+{
+  m_left = (count < m_left) ? m_left - count : 0;
+  m_roundChunks += count;
+  m_chunksSent  += count;
+
+  if (m_rateLimit)
+  {
+    const uint64_t cost = (uint64_t)count * m_chunkBytes;
+    m_tokens = (cost > m_tokens) ? 0 : m_tokens - (uint32_t)cost;
+  }
+}
+
+int SendPacer::roundBudget(uint32_t backlog) const
+{
+  uint64_t target = (uint64_t)m_rate * BACKLOG_MS / 1000;
+  if (target < MIN_BACKLOG)
+  {
+    target = MIN_BACKLOG;
+  }
+  if (target > s_maxBacklog)
+  {
+    target = s_maxBacklog;
+  }
+  if (backlog >= target)
+  {
+    return 0;
+  }
+
+  // Rather a chunk too many than none while there's room
+  uint64_t count = (target - backlog) / m_chunkBytes;
+  if (count == 0)
+  {
+    count = 1;
+  }
+
+  if (m_rateLimit && count > m_tokens / m_chunkBytes)
+  {
+    count = m_tokens / m_chunkBytes;
+  }
+  if (count > (uint64_t)s_maxChunks)
+  {
+    count = s_maxChunks;
+  }
+  return (int)count;
+}
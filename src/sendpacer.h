@@ -0,0 +1,120 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SENDPACER_H
+#define _SENDPACER_H
+
+#include <stdint.h>
+
+//
+// Decides how many queued chunks to send a player at a time. It keeps about
+// half a second of output waiting on the connection: the drain rate is
+// measured from the bytes written while output was waiting, the size of a
+// chunk from what the last chunks added to the output. Slow links get a
+// chunk or two once they catch up, fast ones get as many as max_chunks per
+// round. An optional bandwidth cap per player limits it further.
+//
+class SendPacer
+{
+public:
+  SendPacer();
+
+  // Limits shared by every player: the most output to keep waiting, the
+  // most chunks per round, and the default bandwidth cap in bytes per
+  // second, 0 for none
+  static void configure(uint32_t maxBacklog, int maxChunks, uint32_t rateLimit);
+
+  // How many chunks may be sent now. backlog is the output still waiting,
+  // written the running count of bytes written to the socket.
+  int budget(uint32_t backlog, uint32_t written);
+  // count chunks out of the budget were sent
+  void sent(int count);
+
+  // Bandwidth cap for this player in bytes per second, 0 for none
+  void setRateLimit(uint32_t bytesPerSecond)
+  {
+    m_rateLimit = bytesPerSecond;
+  }
+  uint32_t rateLimit() const
+  {
+    return m_rateLimit;
+  }
+
+  // Bytes per second the connection takes
+  uint32_t drainRate() const
+  {
+    return m_rate;
+  }
+  uint32_t chunkBytes() const
+  {
+    return m_chunkBytes;
+  }
+  uint32_t backlog() const
+  {
+    return m_lastBacklog;
+  }
+  uint64_t chunksSent() const
+  {
+    return m_chunksSent;
+  }
+  uint64_t bytesWritten() const
+  {
+    return m_bytesWritten;
+  }
+  // Rounds where nothing could be sent
+  uint64_t throttled() const
+  {
+    return m_throttled;
+  }
+
+private:
+  int roundBudget(uint32_t backlog) const;
+
+  static uint32_t s_maxBacklog;
+  static int s_maxChunks;
+  static uint32_t s_rateLimit;
+
+  uint32_t m_rateLimit;
+
+  // Start of the current round
+  uint32_t m_roundStart;
+  bool m_started;
+  int m_left;
+  int m_roundChunks;
+
+  uint32_t m_lastBacklog;
+  uint32_t m_lastWritten;
+  uint32_t m_rate;
+  uint32_t m_chunkBytes;
+  uint32_t m_tokens;
+
+  uint64_t m_chunksSent;
+  uint64_t m_bytesWritten;
+  uint64_t m_throttled;
+};
+
+#endif
@@ -0,0 +1,242 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "skylight.h"
+
+#ifdef SKYLIGHT_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef SKYLIGHT_AVX2
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+inline int columnHeight(int y)
+{
+  return (y == 127) ? y : y + 1;
+}
+
+#ifdef SKYLIGHT_SSE2
+
+#ifdef WIN32
+#define SKYLIGHT_ALIGN(decl) __declspec(align(32)) decl
+#else
+#define SKYLIGHT_ALIGN(decl) decl __attribute__((aligned(32)))
+#endif
+
+// Light for 128 stopLight values of one column, eight vectors from the top.
+// Each vector is turned into a running sum of everything above it with
+// saturating adds, which also covers the clamp at 0 once it passes 15.
+inline void columnLight(const uint8_t* stop, uint8_t* skylight)
+{
+  const __m128i fifteen = _mm_set1_epi8(15);
+  const __m128i lowByte = _mm_set1_epi16(0x00ff);
+  __m128i above = _mm_setzero_si128();
+
+  for (int v = 7; v >= 0; v--)
+  {
+    __m128i sum = _mm_load_si128(reinterpret_cast<const __m128i*>(stop + (v << 4)));
+    sum = _mm_adds_epu8(sum, _mm_srli_si128(sum, 1));
+    sum = _mm_adds_epu8(sum, _mm_srli_si128(sum, 2));
+    sum = _mm_adds_epu8(sum, _mm_srli_si128(sum, 4));
+    sum = _mm_adds_epu8(sum, _mm_srli_si128(sum, 8));
+    sum = _mm_adds_epu8(sum, above);
+    above = _mm_set1_epi8(static_cast<char>(_mm_cvtsi128_si32(sum)));
+
+    // Odd y goes to the high nibble
+    __m128i light = _mm_subs_epu8(fifteen, sum);
+    light = _mm_and_si128(_mm_or_si128(light, _mm_srli_epi16(light, 4)), lowByte);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(skylight + (v << 3)), _mm_packus_epi16(light, light));
+  }
+}
+
+// Highest non-air block from a 16 bit mask per vector of 16 blocks
+inline int topBlock(const unsigned* masks, int count)
+{
+  for (int v = count - 1; v >= 0; v--)
+  {
+    if (masks[v])
+    {
+      int bit = 31;
+      while (!(masks[v] & (1u << bit)))
+      {
+        bit--;
+      }
+      return v * (128 / count) + bit;
+    }
+  }
+  return -1;
+}
+
+#endif
+
+}
+
+void SkyLight::scalar(const uint8_t* blocks, const int* stopLight, uint8_t* skylight, uint8_t* heightmap)
+{
+  for (int block_x = 0; block_x < 16; block_x++)
+  {
+    for (int block_z = 0; block_z < 16; block_z++)
+    {
+      const int column = (block_z << 7) + (block_x << 11);
+      int light = 15;
+      int height = 0;
+
+      for (int block_y = 127; block_y >= 0; block_y--)
+      {
+        const int index = column + block_y;
+        const uint8_t block = blocks[index];
+
+        if (block != 0 && height == 0)
+        {
+          height = columnHeight(block_y);
+        }
+
+        light -= stopLight[block];
+        if (light < 0)
+        {
+          light = 0;
+        }
+
+        if (block_y & 1)
+        {
+          skylight[index >> 1] = (skylight[index >> 1] & 0x0f) | (light << 4);
+        }
+        else
+        {
+          skylight[index >> 1] = (skylight[index >> 1] & 0xf0) | light;
+        }
+      }
+
+      heightmap[block_z + (block_x << 4)] = height;
+    }
+  }
+}
+
+#ifdef SKYLIGHT_SSE2
+
+void SkyLight::sse2(const uint8_t* blocks, const int* stopLight, uint8_t* skylight, uint8_t* heightmap)
+{
+  SKYLIGHT_ALIGN(uint8_t stop[128]);
+  const __m128i zero = _mm_setzero_si128();
+
+  for (int block_x = 0; block_x < 16; block_x++)
+  {
+    for (int block_z = 0; block_z < 16; block_z++)
+    {
+      const int column = (block_z << 7) + (block_x << 11);
+      const uint8_t* columnBlocks = blocks + column;
+
+      // stopLight is at most 16, so it fits the byte lanes
+      for (int block_y = 0; block_y < 128; block_y++)
+      {
+        stop[block_y] = stopLight[columnBlocks[block_y]];
+      }
+
+      unsigned masks[8];
+      for (int v = 0; v < 8; v++)
+      {
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columnBlocks + (v << 4)));
+        masks[v] = ~_mm_movemask_epi8(_mm_cmpeq_epi8(b, zero)) & 0xffff;
+      }
+      const int top = topBlock(masks, 8);
+      heightmap[block_z + (block_x << 4)] = (top < 0) ? 0 : columnHeight(top);
+
+      columnLight(stop, skylight + (column >> 1));
+    }
+  }
+}
+
+#endif
+
+#ifdef SKYLIGHT_AVX2
+
+// Looks the stopLight values up with gathers and finds the height with
+// 32 byte compares; the running sum itself stays on 16 byte vectors since
+// AVX2 byte shifts don't cross the two 128 bit lanes
+__attribute__((target("avx2")))
+void SkyLight::avx2(const uint8_t* blocks, const int* stopLight, uint8_t* skylight, uint8_t* heightmap)
+{
+  SKYLIGHT_ALIGN(uint8_t stop[128]);
+  const __m256i zero = _mm256_setzero_si256();
+  // packs leaves the dwords of the two lanes interleaved
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+  for (int block_x = 0; block_x < 16; block_x++)
+  {
+    for (int block_z = 0; block_z < 16; block_z++)
+    {
+      const int column = (block_z << 7) + (block_x << 11);
+      const uint8_t* columnBlocks = blocks + column;
+
+      unsigned masks[4];
+      for (int v = 0; v < 4; v++)
+      {
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columnBlocks + (v << 5)));
+        masks[v] = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, zero)));
+
+        const __m128i lo = _mm256_castsi256_si128(b);
+        const __m128i hi = _mm256_extracti128_si256(b, 1);
+        const __m256i s0 = _mm256_i32gather_epi32(stopLight, _mm256_cvtepu8_epi32(lo), 4);
+        const __m256i s1 = _mm256_i32gather_epi32(stopLight, _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)), 4);
+        const __m256i s2 = _mm256_i32gather_epi32(stopLight, _mm256_cvtepu8_epi32(hi), 4);
+        const __m256i s3 = _mm256_i32gather_epi32(stopLight, _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)), 4);
+        const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(s0, s1), _mm256_packs_epi32(s2, s3));
+        _mm256_store_si256(reinterpret_cast<__m256i*>(stop + (v << 5)), _mm256_permutevar8x32_epi32(packed, order));
+      }
+      const int top = topBlock(masks, 4);
+      heightmap[block_z + (block_x << 4)] = (top < 0) ? 0 : columnHeight(top);
+
+      columnLight(stop, skylight + (column >> 1));
+    }
+  }
+}
+
+bool SkyLight::haveAVX2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+SkyLight::Kernel SkyLight::best()
+{
+#ifdef SKYLIGHT_AVX2
+  if (haveAVX2())
+  {
+    return avx2;
+  }
+#endif
+#ifdef SKYLIGHT_SSE2
+  return sse2;
+#else
+  return scalar;
+#endif
+}
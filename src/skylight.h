@@ -0,0 +1,76 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SKYLIGHT_H
+#define _SKYLIGHT_H
+
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SKYLIGHT_SSE2
+#endif
+
+// AVX2 is built with a target attribute and picked at runtime
+#if defined(SKYLIGHT_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+  ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__clang__))
+#define SKYLIGHT_AVX2
+#endif
+
+//
+// Sky light and heightmap for a whole 16x128x16 chunk, worked out per column
+// from the top down. Each voxel gets 15 minus the stopLight of itself and
+// everything above it, clamped at 0. The heightmap gets the highest non-air
+// y + 1 (127 for the top layer, 0 for an empty column).
+//
+// blocks is in chunk order, y + (z << 7) + (x << 11), skylight is written as
+// packed nibbles for every voxel and heightmap is indexed z + (x << 4).
+//
+namespace SkyLight
+{
+  typedef void (*Kernel)(const uint8_t* blocks, const int* stopLight, uint8_t* skylight, uint8_t* heightmap);
+
+  // Reference implementation, one voxel at a time
+  void scalar(const uint8_t* blocks, const int* stopLight, uint8_t* skylight, uint8_t* heightmap);
+#ifdef SKYLIGHT_SSE2
+  void sse2(const uint8_t* blocks, const int* stopLight, uint8_t* skylight, uint8_t* heightmap);
+#endif
+#ifdef SKYLIGHT_AVX2
+  void avx2(const uint8_t* blocks, const int* stopLight, uint8_t* skylight, uint8_t* heightmap);
+  bool haveAVX2();
+#endif
+
+  // Fastest kernel the CPU supports
+  Kernel best();
+
+  inline void generate(const uint8_t* blocks, const int* stopLight, uint8_t* skylight, uint8_t* heightmap)
+  {
+    static const Kernel kernel = best();
+    kernel(blocks, stopLight, skylight, heightmap);
+  }
+}
+
+#endif
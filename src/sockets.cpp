@@ -40,6 +40,7 @@ typedef  int socklen_t;
 #include <stdio.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/uio.h>
 #endif
 #include <errno.h>
 #include <iostream>
@@ -62,13 +63,115 @@ typedef  int socklen_t;
 #include "mineserver.h"
 
 #include "packets.h"
+#include "netthreads.h"
+#include "profiler.h"
+#include "sockets.h"
 #include <algorithm>
 
 extern int setnonblock(int fd);
 
-#ifndef WIN32
-#define SOCKET_ERROR -1
+// Most slices handed to one writev() call, IOV_MAX is at least 16
+#define WRITE_SLICES 64
+
+// Runs the packet handlers on everything buffered for the user. Returns
+// false if the user was disconnected and deleted on the way.
+bool client_parse(User* user)
+{
+  user->buffer.reset();
+
+  while (user->buffer >> (int8_t&)user->action)
+  {
+    //Variable len package
+    if (Mineserver::get()->packetHandler()->packets[user->action].len == PACKET_VARIABLE_LEN)
+    {
+      //Call specific function
+      int (PacketHandler::*function)(User*) =
+        Mineserver::get()->packetHandler()->packets[user->action].function;
+      bool disconnecting = user->action == 0xFF;
+      int curpos;
+      {
+        PROFILE(Profiler::PACKET + (uint8_t)user->action);
+        curpos = (Mineserver::get()->packetHandler()->*function)(user);
+      }
+      if (curpos == PACKET_NEED_MORE_DATA)
+      {
+        user->waitForData = true;
+        return true;
+      }
+
+      if (disconnecting) // disconnect -- player gone
+      {
+        delete user;
+        return false;
+      }
+    }
+    else if (Mineserver::get()->packetHandler()->packets[user->action].len == PACKET_DOES_NOT_EXIST)
+    {
+      printf("Unknown action: 0x%x\n", user->action);
+
+      delete user;
+      return false;
+    }
+    else
+    {
+      if (!user->buffer.haveData(Mineserver::get()->packetHandler()->packets[user->action].len))
+      {
+        user->waitForData = true;
+        return true;
+      }
+
+      //Call specific function
+      int (PacketHandler::*function)(User*) = Mineserver::get()->packetHandler()->packets[user->action].function;
+      PROFILE(Profiler::PACKET + (uint8_t)user->action);
+      (Mineserver::get()->packetHandler()->*function)(user);
+    }
+  } //End while
+
+  return true;
+}
+
+// Hands as much of the queued output to the socket as it takes and drops
+// that from the buffer. Returns the bytes written, 0 if the socket is full,
+// or SOCKET_ERROR.
+int client_write(int fd, Packet& buffer)
+{
+  // Hand all queued slices to the kernel in one call
+  WriteSlice slices[WRITE_SLICES];
+  int sliceCount = buffer.getWriteSlices(slices, WRITE_SLICES);
+#ifdef WIN32
+  WSABUF vec[WRITE_SLICES];
+  for (int i = 0; i < sliceCount; i++)
+  {
+    vec[i].buf = (char*)slices[i].data;
+    vec[i].len = (ULONG)slices[i].len;
+  }
+  DWORD sent = 0;
+  int written = (WSASend(fd, vec, sliceCount, &sent, 0, NULL, NULL) == 0) ? (int)sent : SOCKET_ERROR;
+#else
+  struct iovec vec[WRITE_SLICES];
+  for (int i = 0; i < sliceCount; i++)
+  {
+    vec[i].iov_base = (void*)slices[i].data;
+    vec[i].iov_len  = slices[i].len;
+  }
+  int written = writev(fd, vec, sliceCount);
+#endif
+  if (written == SOCKET_ERROR)
+  {
+#ifdef WIN32
+    if ((ERROR_NUMBER != WSATRY_AGAIN && ERROR_NUMBER != WSAEINTR && ERROR_NUMBER != WSAEWOULDBLOCK))
+#else
+    if ((errno != EAGAIN && errno != EINTR))
 #endif
+    {
+      return SOCKET_ERROR;
+    }
+    return 0;
+  }
+
+  buffer.clearWrite(written);
+  return written;
+}
 
 void client_callback(int fd,
                      short ev,
@@ -89,16 +192,16 @@ void client_callback(int fd,
 
     int read   = 1;
 
-    uint8_t* buf = new uint8_t[2048];
+    // Receive straight into the user's read buffer
+    uint8_t* buf = user->buffer.prepareRead(RECV_SIZE);
 
-    read = recv(fd, (char*)buf, 2048, 0);
+    read = recv(fd, (char*)buf, user->buffer.readSpace(), 0);
     if (read == 0)
     {
       Mineserver::get()->logger()->log(LogType::LOG_INFO, "Sockets", "Socket closed properly");
 
       delete user;
       user = (User*)1;
-      delete[] buf;
       return;
     }
 
@@ -108,101 +211,38 @@ void client_callback(int fd,
 
       delete user;
       user = (User*)2;
-      delete[] buf;
       return;
     }
 
     user->lastData = time(NULL);
 
-    user->buffer.addToRead(buf, read);
-
-    delete[] buf;
-
-    user->buffer.reset();
+    user->buffer.commitRead(read);
+    Mineserver::get()->netThreads()->countReceived(read);
 
-    while (user->buffer >> (int8_t&)user->action)
+    if (!client_parse(user))
     {
-      //Variable len package
-      if (Mineserver::get()->packetHandler()->packets[user->action].len == PACKET_VARIABLE_LEN)
-      {
-        //Call specific function
-        int (PacketHandler::*function)(User*) =
-          Mineserver::get()->packetHandler()->packets[user->action].function;
-        bool disconnecting = user->action == 0xFF;
-        int curpos = (Mineserver::get()->packetHandler()->*function)(user);
-        if (curpos == PACKET_NEED_MORE_DATA)
-        {
-          user->waitForData = true;
-          event_set(user->GetEvent(), fd, EV_READ, client_callback, user);
-          event_add(user->GetEvent(), NULL);
-          return;
-        }
-
-        if (disconnecting) // disconnect -- player gone
-        {
-          delete user;
-          user = (User*)4;
-          return;
-        }
-      }
-      else if (Mineserver::get()->packetHandler()->packets[user->action].len == PACKET_DOES_NOT_EXIST)
-      {
-        printf("Unknown action: 0x%x\n", user->action);
+      return;
+    }
 
-        delete user;
-        user = (User*)3;
-        return;
-      }
-      else
-      {
-        if (!user->buffer.haveData(Mineserver::get()->packetHandler()->packets[user->action].len))
-        {
-          user->waitForData = true;
-          event_set(user->GetEvent(), fd, EV_READ, client_callback, user);
-          event_add(user->GetEvent(), NULL);
-          return;
-        }
-
-        //Call specific function
-        int (PacketHandler::*function)(User*) = Mineserver::get()->packetHandler()->packets[user->action].function;
-        (Mineserver::get()->packetHandler()->*function)(user);
-      }
-    } //End while
+    Mineserver::get()->flushBlockChanges();
   }
 
-  int writeLen = user->buffer.getWriteLen();
+  int writeLen = user->buffer.getPendingWriteLen();
   if (writeLen)
   {
-    int written = send(fd, (char*)user->buffer.getWrite(), writeLen, 0);
+    int written = client_write(fd, user->buffer);
     if (written == SOCKET_ERROR)
     {
-#ifdef WIN32
-#define ERROR_NUMBER WSAGetLastError()
-      if ((ERROR_NUMBER != WSATRY_AGAIN && ERROR_NUMBER != WSAEINTR && ERROR_NUMBER != WSAEWOULDBLOCK))
-#else
-#define ERROR_NUMBER errno
-      if ((errno != EAGAIN && errno != EINTR))
-#endif
-      {
-        Mineserver::get()->logger()->log(LogType::LOG_ERROR, "Socket", "Error writing to client, tried to write " + dtos(writeLen) + " bytes, code: " + dtos(ERROR_NUMBER));
-
-        delete user;
-        user = (User*)5;
-        return;
-      }
-      else
-      {
-        //user->write_err_count++;
-      }
+      Mineserver::get()->logger()->log(LogType::LOG_ERROR, "Socket", "Error writing to client, tried to write " + dtos(writeLen) + " bytes, code: " + dtos(ERROR_NUMBER));
 
+      delete user;
+      user = (User*)5;
+      return;
     }
-    else
-    {
-      user->buffer.clearWrite(written);
-      //user->write_err_count=0;
-    }
+    user->bytesWritten += written;
+    Mineserver::get()->netThreads()->countWritten(written);
 
-    if (user->buffer.getWriteLen())
+    if (user->buffer.getPendingWriteLen())
     {
       event_set(user->GetEvent(), fd, EV_WRITE | EV_READ, client_callback, user);
       event_add(user->GetEvent(), NULL);
@@ -234,6 +274,13 @@ void accept_callback(int fd,
   User* client = new User(client_fd, generateEID());
   setnonblock(client_fd);
 
+  // The socket belongs to one of the network threads from here on
+  if (Mineserver::get()->netThreads()->enabled())
+  {
+    Mineserver::get()->netThreads()->attach(client);
+    return;
+  }
+
   event_set(client->GetEvent(), client_fd, EV_WRITE | EV_READ, client_callback, client);
   event_add(client->GetEvent(), NULL);
 
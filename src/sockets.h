@@ -25,4 +25,24 @@
   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#ifndef _SOCKETS_H
+#define _SOCKETS_H
+
+#ifdef WIN32
+#define ERROR_NUMBER WSAGetLastError()
+#else
+#define SOCKET_ERROR -1
+#define ERROR_NUMBER errno
+#endif
+
+// Least free space offered to one recv() call
+#define RECV_SIZE 16384
+
+class User;
+class Packet;
+
 void accept_callback(int fd, short ev, void* arg);
+bool client_parse(User* user);
+int client_write(int fd, Packet& buffer);
+
+#endif
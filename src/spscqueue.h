@@ -0,0 +1,126 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SPSCQUEUE_H
+#define _SPSCQUEUE_H
+
+#include <stddef.h>
+
+#include "atomic.h"
+
+//
+// Unbounded lock-free queue between exactly one producer thread, calling
+// push(), and one consumer thread, calling pop(). Neither side ever waits.
+// Nodes the consumer has passed are reused by the producer, so once a queue
+// has grown to its working size it stops allocating.
+//
+template <class T>
+class SpscQueue
+{
+public:
+  SpscQueue()
+  {
+    Node* dummy = new Node;
+    dummy->next = NULL;
+    m_head      = dummy;
+    m_tail      = dummy;
+    m_first     = dummy;
+    m_headCopy  = dummy;
+  }
+
+  // Values still queued are dropped without further notice
+  ~SpscQueue()
+  {
+    Node* node = m_first;
+    while (node != NULL)
+    {
+      Node* next = node->next;
+      delete node;
+      node = next;
+    }
+  }
+
+  void push(const T& value)
+  {
+    Node* node  = allocNode();
+    node->next  = NULL;
+    node->value = value;
+    atomicStoreRelease(&m_tail->next, node);
+    m_tail = node;
+  }
+
+  // False if the queue is empty
+  bool pop(T& value)
+  {
+    Node* next = atomicLoadAcquire(&m_head->next);
+    if (next == NULL)
+    {
+      return false;
+    }
+    value = next->value;
+    // The old head is free for the producer from here on
+    atomicStoreRelease(&m_head, next);
+    return true;
+  }
+
+private:
+  struct Node
+  {
+    Node* volatile next;
+    T value;
+  };
+
+  // Producer side: recycle nodes in [m_first, m_head) before allocating
+  Node* allocNode()
+  {
+    if (m_first == m_headCopy)
+    {
+      m_headCopy = atomicLoadAcquire(&m_head);
+    }
+    if (m_first != m_headCopy)
+    {
+      Node* node = m_first;
+      m_first = m_first->next;
+      return node;
+    }
+    return new Node;
+  }
+
+  // Consumer, the node before the first queued value
+  Node* volatile m_head;
+  // Keep the two sides on separate cache lines
+  char m_pad[64];
+  // Producer
+  Node* m_tail;
+  Node* m_first;
+  Node* m_headCopy;
+
+  SpscQueue(const SpscQueue&);
+  SpscQueue& operator=(const SpscQueue&);
+};
+
+#endif
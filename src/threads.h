@@ -0,0 +1,234 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _THREADS_H
+#define _THREADS_H
+
+#ifdef WIN32
+#include <winsock2.h>
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+
+//
+// Minimal portable mutex / condition / thread wrappers
+//
+
+class Mutex
+{
+public:
+#ifdef WIN32
+  Mutex()
+  {
+    InitializeCriticalSection(&m_cs);
+  }
+  ~Mutex()
+  {
+    DeleteCriticalSection(&m_cs);
+  }
+  void lock()
+  {
+    EnterCriticalSection(&m_cs);
+  }
+  void unlock()
+  {
+    LeaveCriticalSection(&m_cs);
+  }
+#else
+  Mutex()
+  {
+    pthread_mutex_init(&m_mutex, NULL);
+  }
+  ~Mutex()
+  {
+    pthread_mutex_destroy(&m_mutex);
+  }
+  void lock()
+  {
+    pthread_mutex_lock(&m_mutex);
+  }
+  void unlock()
+  {
+    pthread_mutex_unlock(&m_mutex);
+  }
+#endif
+
+private:
+  friend class Condition;
+#ifdef WIN32
+  CRITICAL_SECTION m_cs;
+#else
+  pthread_mutex_t m_mutex;
+#endif
+
+  Mutex(const Mutex&);
+  Mutex& operator=(const Mutex&);
+};
+
+// Holds a mutex for the lifetime of the scope
+class MutexLock
+{
+public:
+  explicit MutexLock(Mutex& mutex) : m_mutex(mutex)
+  {
+    m_mutex.lock();
+  }
+  ~MutexLock()
+  {
+    m_mutex.unlock();
+  }
+
+private:
+  Mutex& m_mutex;
+
+  MutexLock(const MutexLock&);
+  MutexLock& operator=(const MutexLock&);
+};
+
+class Condition
+{
+public:
+#ifdef WIN32
+  Condition()
+  {
+    InitializeConditionVariable(&m_cond);
+  }
+  ~Condition()
+  {
+  }
+  void wait(Mutex& mutex)
+  {
+    SleepConditionVariableCS(&m_cond, &mutex.m_cs, INFINITE);
+  }
+  void signal()
+  {
+    WakeConditionVariable(&m_cond);
+  }
+  void broadcast()
+  {
+    WakeAllConditionVariable(&m_cond);
+  }
+#else
+  Condition()
+  {
+    pthread_cond_init(&m_cond, NULL);
+  }
+  ~Condition()
+  {
+    pthread_cond_destroy(&m_cond);
+  }
+  void wait(Mutex& mutex)
+  {
+    pthread_cond_wait(&m_cond, &mutex.m_mutex);
+  }
+  void signal()
+  {
+    pthread_cond_signal(&m_cond);
+  }
+  void broadcast()
+  {
+    pthread_cond_broadcast(&m_cond);
+  }
+#endif
+
+private:
+#ifdef WIN32
+  CONDITION_VARIABLE m_cond;
+#else
+  pthread_cond_t m_cond;
+#endif
+
+  Condition(const Condition&);
+  Condition& operator=(const Condition&);
+};
+
+class Thread
+{
+public:
+  typedef void (*Function)(void* arg);
+
+  Thread() : m_function(NULL), m_arg(NULL), m_running(false)
+  {
+  }
+
+  // Returns false if the thread could not be created
+  bool start(Function function, void* arg)
+  {
+    m_function = function;
+    m_arg      = arg;
+#ifdef WIN32
+    m_handle = (HANDLE)_beginthreadex(NULL, 0, &Thread::entry, this, 0, NULL);
+    m_running = (m_handle != 0);
+#else
+    m_running = (pthread_create(&m_thread, NULL, &Thread::entry, this) == 0);
+#endif
+    return m_running;
+  }
+
+  void join()
+  {
+    if (!m_running)
+    {
+      return;
+    }
+#ifdef WIN32
+    WaitForSingleObject(m_handle, INFINITE);
+    CloseHandle(m_handle);
+#else
+    pthread_join(m_thread, NULL);
+#endif
+    m_running = false;
+  }
+
+private:
+#ifdef WIN32
+  static unsigned __stdcall entry(void* self)
+  {
+    static_cast<Thread*>(self)->m_function(static_cast<Thread*>(self)->m_arg);
+    return 0;
+  }
+  HANDLE m_handle;
+#else
+  static void* entry(void* self)
+  {
+    static_cast<Thread*>(self)->m_function(static_cast<Thread*>(self)->m_arg);
+    return NULL;
+  }
+  pthread_t m_thread;
+#endif
+
+  Function m_function;
+  void* m_arg;
+  bool m_running;
+
+  Thread(const Thread&);
+  Thread& operator=(const Thread&);
+};
+
+#endif
@@ -0,0 +1,143 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tools.h"
+#include "tickscheduler.h"
+
+TickScheduler::TickScheduler(uint32_t tickMs, int maxCatchUp)
+  : m_tickMs(tickMs > 0 ? tickMs : 1),
+    m_maxCatchUp(maxCatchUp > 0 ? maxCatchUp : 1),
+    m_next(clockMs()),
+    m_tickStart(m_next),
+    m_ticks(0)
+{
+  for (int i = 0; i < TASK_COUNT; i++)
+  {
+    m_budget[i] = 0;
+  }
+  resetStats();
+}
+
+void TickScheduler::start()
+{
+  m_next = clockMs();
+}
+
+uint32_t TickScheduler::untilNext() const
+{
+  const int32_t left = (int32_t)(m_next - clockMs());
+  return (left > 0) ? (uint32_t)left : 0;
+}
+
+int TickScheduler::due()
+{
+  const int32_t behind = (int32_t)(clockMs() - m_next);
+  if (behind < 0)
+  {
+    return 0;
+  }
+
+  uint32_t count = (uint32_t)behind / m_tickMs + 1;
+  if (count > (uint32_t)m_maxCatchUp)
+  {
+    // Give up on the rest, the game runs slower for a moment instead
+    m_skipped += count - m_maxCatchUp;
+    m_next    += (count - m_maxCatchUp) * m_tickMs;
+    count      = m_maxCatchUp;
+  }
+  return (int)count;
+}
+
+void TickScheduler::begin()
+{
+  m_tickStart = clockMs();
+}
+
+void TickScheduler::end()
+{
+  const uint32_t took = clockMs() - m_tickStart;
+  m_next += m_tickMs;
+  m_ticks++;
+
+  m_statTicks++;
+  m_tickTotal += took;
+  if (took > m_tickMax)
+  {
+    m_tickMax = took;
+  }
+  if (took > m_tickMs)
+  {
+    m_overruns++;
+  }
+}
+
+bool TickScheduler::every(uint32_t periodMs, uint32_t offsetMs) const
+{
+  const uint32_t period = (periodMs > m_tickMs) ? periodMs / m_tickMs : 1;
+  return m_ticks % period == (offsetMs / m_tickMs) % period;
+}
+
+double TickScheduler::tickAverage() const
+{
+  return m_statTicks ? (double)m_tickTotal / m_statTicks : 0;
+}
+
+double TickScheduler::taskAverage(Task task) const
+{
+  return m_statTicks ? (double)m_spent[task] / m_statTicks : 0;
+}
+
+void TickScheduler::resetStats()
+{
+  m_statTicks = 0;
+  m_tickTotal = 0;
+  m_tickMax   = 0;
+  m_overruns  = 0;
+  m_skipped   = 0;
+  for (int i = 0; i < TASK_COUNT; i++)
+  {
+    m_spent[i] = 0;
+  }
+}
+
+TickScheduler::Slice::Slice(TickScheduler& scheduler, Task task)
+  : m_scheduler(scheduler),
+    m_task(task),
+    m_start(clockMs())
+{
+}
+
+TickScheduler::Slice::~Slice()
+{
+  m_scheduler.m_spent[m_task] += clockMs() - m_start;
+}
+
+bool TickScheduler::Slice::left() const
+{
+  const uint32_t budget = m_scheduler.m_budget[m_task];
+  return budget == 0 || clockMs() - m_start < budget;
+}
@@ -0,0 +1,154 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _TICKSCHEDULER_H
+#define _TICKSCHEDULER_H
+
+#include <stdint.h>
+
+//
+// Runs the server at a fixed tick rate on the monotonic clock. The main
+// loop waits in the event loop until the next tick is due, then runs as
+// many ticks as it fell behind by, at most the catch-up limit; beyond that
+// the ticks are skipped so a stall doesn't turn into a burst.
+//
+// Work that can be spread out gets a time budget per tick. A Slice times
+// one task and tells it when its budget is used up, and the task carries
+// what is left over to the next tick.
+//
+class TickScheduler
+{
+public:
+  enum Task
+  {
+    TASK_CHUNKS,
+    TASK_PHYSICS,
+    TASK_LIGHTING,
+    TASK_PLUGINS,
+    TASK_COUNT
+  };
+
+  TickScheduler(uint32_t tickMs, int maxCatchUp);
+
+  uint32_t tickMs() const
+  {
+    return m_tickMs;
+  }
+
+  // Budget of a task in ms per tick, 0 for no limit
+  void setBudget(Task task, uint32_t ms)
+  {
+    m_budget[task] = ms;
+  }
+  uint32_t budget(Task task) const
+  {
+    return m_budget[task];
+  }
+
+  // The first tick is due now
+  void start();
+  // Milliseconds until the next tick is due, 0 if it is due now
+  uint32_t untilNext() const;
+  // How many ticks to run now, skipping those beyond the catch-up limit
+  int due();
+
+  // Wrap each tick in begin() and end()
+  void begin();
+  void end();
+
+  // Ticks run so far
+  uint64_t ticks() const
+  {
+    return m_ticks;
+  }
+  // Start of the current tick, from clockMs()
+  uint32_t tickStart() const
+  {
+    return m_tickStart;
+  }
+  // True on the ticks a job that runs every periodMs should run on. Jobs
+  // with the same period are spread over different ticks by their offset.
+  bool every(uint32_t periodMs, uint32_t offsetMs = 0) const;
+
+  class Slice
+  {
+  public:
+    Slice(TickScheduler& scheduler, Task task);
+    ~Slice();
+
+    // Still within the budget of the task
+    bool left() const;
+
+  private:
+    TickScheduler& m_scheduler;
+    Task m_task;
+    uint32_t m_start;
+  };
+  friend class Slice;
+
+  // Statistics since the last resetStats()
+  uint32_t statTicks() const
+  {
+    return m_statTicks;
+  }
+  double tickAverage() const;
+  uint32_t tickMax() const
+  {
+    return m_tickMax;
+  }
+  // Average ms per tick spent on a task
+  double taskAverage(Task task) const;
+  // Ticks that took longer than a tick
+  uint32_t overruns() const
+  {
+    return m_overruns;
+  }
+  uint32_t skipped() const
+  {
+    return m_skipped;
+  }
+  void resetStats();
+
+private:
+  uint32_t m_tickMs;
+  int m_maxCatchUp;
+  uint32_t m_budget[TASK_COUNT];
+
+  // When the next tick is due, from clockMs()
+  uint32_t m_next;
+  uint32_t m_tickStart;
+  uint64_t m_ticks;
+
+  uint32_t m_statTicks;
+  uint64_t m_tickTotal;
+  uint32_t m_tickMax;
+  uint64_t m_spent[TASK_COUNT];
+  uint32_t m_overruns;
+  uint32_t m_skipped;
+};
+
+#endif
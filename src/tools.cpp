@@ -30,6 +30,7 @@
 #include <WinSock2.h>
 #else
 #include <netinet/in.h>
+#include <sys/time.h>
 #endif
 
 #include <cstdlib>
@@ -44,8 +45,34 @@
 #include <string>
 #include <cctype>
 
+#include <zlib.h>
+
+#include "constants.h"
 #include "tools.h"
 
+time_t tickTime = time(NULL);
+
+void updateTickTime()
+{
+  tickTime = time(NULL);
+}
+
+uint32_t clockMs()
+{
+#ifdef WIN32
+  return (uint32_t)GetTickCount();
+#elif defined(CLOCK_MONOTONIC)
+  // Doesn't jump when the wall clock is set
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (uint32_t)((uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000);
+#endif
+}
+
 void putSint64(uint8_t* buf, int64_t value)
 {
   uint64_t nval = ntohll(value);
@@ -185,3 +212,66 @@ std::string hash(std::string value)
 
   return hashString.str();
 }
+
+bool readGzipFile(const std::string& filename, std::vector<uint8_t>& buffer, bool* sizeKnown)
+{
+  FILE* fp = fopen(filename.c_str(), "rb");
+  if (fp == NULL)
+  {
+    return false;
+  }
+  fseek(fp, -4, SEEK_END);
+  uint32_t uncompressedSize = 0;
+  fread(&uncompressedSize, 4, 1, fp);
+  fclose(fp);
+
+  //Do endian testing!
+  int32_t endiantestint = 1;
+  int8_t* endiantestchar = (int8_t*)&endiantestint;
+  if (*endiantestchar != 1)
+  {
+    //Swap order
+    int uncompressedSizeOld = uncompressedSize;
+    uint8_t* newpointer = reinterpret_cast<uint8_t*>(&uncompressedSize);
+    uint8_t* oldpointer = reinterpret_cast<uint8_t*>(&uncompressedSizeOld);
+    newpointer[0] = oldpointer[3];
+    newpointer[1] = oldpointer[2];
+    newpointer[2] = oldpointer[1];
+    newpointer[3] = oldpointer[0];
+  }
+
+  if (sizeKnown != NULL)
+  {
+    *sizeKnown = (uncompressedSize != 0);
+  }
+
+  if (uncompressedSize == 0)
+  {
+    uncompressedSize = ALLOCATE_NBTFILE;
+  }
+
+  buffer.resize(uncompressedSize);
+  gzFile nbtFile = gzopen(filename.c_str(), "rb");
+  if (nbtFile == NULL)
+  {
+    buffer.clear();
+    return false;
+  }
+  gzread(nbtFile, &buffer[0], uncompressedSize);
+  gzclose(nbtFile);
+
+  return true;
+}
+
+bool writeGzipFile(const std::string& filename, const std::vector<uint8_t>& buffer)
+{
+  gzFile nbtFile = gzopen(filename.c_str(), "wb");
+  if (nbtFile == NULL)
+  {
+    return false;
+  }
+  int written = gzwrite(nbtFile, &buffer[0], buffer.size());
+  gzclose(nbtFile);
+
+  return written == (int)buffer.size();
+}
@@ -31,6 +31,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string>
+#include <vector>
+#include <ctime>
 
 #ifdef WIN32
 #include <Winsock2.h>
@@ -56,10 +58,22 @@ std::string strToLower(std::string temp);
 
 std::string dtos(double n);
 std::string hash(std::string value);
+
+// Read/write a whole gzip file, sizeKnown is false if the size trailer was empty
+bool readGzipFile(const std::string& filename, std::vector<uint8_t>& buffer, bool* sizeKnown = NULL);
+bool writeGzipFile(const std::string& filename, const std::vector<uint8_t>& buffer);
 #ifndef WIN32
 int kbhit();
 #endif
 
+// Coarse server clock, refreshed once per tick. Use this
+// instead of time() on hot paths.
+extern time_t tickTime;
+void updateTickTime();
+// Milliseconds from an arbitrary start on a monotonic clock where there is
+// one, wraps around; for measuring intervals
+uint32_t clockMs();
+
 inline uint64_t ntohll(uint64_t v)
 {
   if (htons(1) == 1) // check if already big-endian
@@ -41,6 +41,7 @@
 #include <direct.h>
 #else
 #include <netinet/in.h>
+#include <sys/ioctl.h>
 #include <string.h>
 #endif
 #include <zlib.h>
@@ -58,7 +59,10 @@
 #include "config.h"
 #include "permissions.h"
 #include "mob.h"
+#include "netthreads.h"
 #include "inventory.h"
+#include "entitytracker.h"
+#include "viewdistance.h"
 
 // Generate "unique" entity ID
 
@@ -69,6 +73,9 @@ User::User(int sock, uint32_t EID)
   this->dnd             = false;
   this->waitForData     = false;
   this->fd              = sock;
+  this->netConn         = NULL;
+  this->bytesWritten    = 0;
+  this->viewDistance    = Mineserver::get()->viewDistance()->distance();
   this->UID             = EID;
   this->logged          = false;
   this->serverAdmin     = false;
@@ -105,7 +112,7 @@ User::User(int sock, uint32_t EID)
 
 bool User::changeNick(std::string _nick)
 {
-  (static_cast<Hook2<bool, const char*, const char*>*>(Mineserver::get()->plugin()->getHook("PlayerNickPost")))->doAll(nick.c_str(), _nick.c_str());
+  (static_cast<Hook2<bool, const char*, const char*>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_NICK_POST)))->doAll(nick.c_str(), _nick.c_str());
 
   nick = _nick;
 
@@ -114,26 +121,35 @@ bool User::changeNick(std::string _nick)
 
 User::~User()
 {
-  if (this->UID != SERVER_CONSOLE_UID && event_del(GetEvent()) == -1)
+  if (netConn != NULL)
   {
-    Mineserver::get()->logger()->log(LogType::LOG_WARNING, "User", this->nick + " event del failed!");
+    // The network thread sends what's left and closes the socket
+    Mineserver::get()->netThreads()->detach(this);
   }
-
-  if (fd != -1)
+  else
   {
+    if (this->UID != SERVER_CONSOLE_UID && event_del(GetEvent()) == -1)
+    {
+      Mineserver::get()->logger()->log(LogType::LOG_WARNING, "User", this->nick + " event del failed!");
+    }
+
+    if (fd != -1)
+    {
 #ifdef WIN32
-    closesocket(fd);
+      closesocket(fd);
 #else
-    close(fd);
+      close(fd);
 #endif
+    }
   }
 
   this->buffer.reset();
 
   // Remove all known chunks
-  for (uint32_t i = 0; i < mapKnown.size(); i++)
+  const std::vector<uint64_t> known = mapKnown.keys();
+  for (size_t i = 0; i < known.size(); i++)
   {
-    delKnown(mapKnown[i].x(), mapKnown[i].z());
+    delKnown(ChunkSet::keyX(known[i]), ChunkSet::keyZ(known[i]));
   }
 
   std::vector<User*>::iterator it_a = Mineserver::get()->users().begin();
@@ -170,24 +186,17 @@ User::~User()
     //Mineserver::get()->logger()->log(LogType::LOG_WARNING, "User", this->nick + " removed!");
     this->saveData();
 
-    // Send signal to everyone that the entity is destroyed
-    uint8_t entityData[5];
-    entityData[0] = 0x1d; // Destroy entity;
-    putSint32(&entityData[1], this->UID);
-    this->sendOthers(&entityData[0], 5);
+    // Destroyed for everyone that saw this player
+    Mineserver::get()->entityTracker()->remove(UID);
 
     //Loop every chunk loaded to make sure no user pointers are left!
-    for (int i = 0; i < 441; ++i)
+    std::vector<sChunk*> loaded = Mineserver::get()->map(pos.map)->chunks.getChunks();
+    for (std::vector<sChunk*>::iterator it = loaded.begin(); it != loaded.end(); ++it)
     {
-      sChunkNode* nextnode = NULL;;
-      for (sChunkNode* node = Mineserver::get()->map(pos.map)->chunks.getBuckets()[i]; node != NULL; node = nextnode)
+      (*it)->users.erase(this);
+      if ((*it)->users.size() == 0)
       {
-        nextnode = node->next;
-        node->chunk->users.erase(this);
-        if (node->chunk->users.size() == 0)
-        {
-          Mineserver::get()->map(pos.map)->releaseMap(node->chunk->x, node->chunk->z);
-        }
+        Mineserver::get()->map(pos.map)->releaseMap((*it)->x, (*it)->z);
       }
     }
 
@@ -212,7 +221,7 @@ User::~User()
 
   if (fd != -1 && logged)
   {
-    (static_cast<Hook1<bool, const char*>*>(Mineserver::get()->plugin()->getHook("PlayerQuitPost")))->doAll(nick.c_str());
+    (static_cast<Hook1<bool, const char*>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_QUIT_POST)))->doAll(nick.c_str());
   }
 }
 
@@ -224,7 +233,6 @@ bool User::sendLoginInfo()
   // Login OK package
   buffer << (int8_t)PACKET_LOGIN_RESPONSE << (int32_t)UID << std::string("") << std::string("") << (int64_t)0 << (int8_t)0;
 
-  spawnOthers();
   // Put nearby chunks to queue
   for (int x = -viewDistance; x <= viewDistance; x++)
   {
@@ -235,25 +243,6 @@ bool User::sendLoginInfo()
   }
   // Push chunks to user
   pushMap(true);
-  std::vector<Mob*> mob = Mineserver::get()->mobs()->getAll();
-  std::vector<Mob*>::iterator i = mob.begin();
-  for (; i != mob.end(); i++)
-  {
-    if (pos.map == (*i)->map && (*i)->spawned)
-    {
-      loginBuffer << PACKET_MOB_SPAWN << (int32_t)(*i)->UID << (int8_t)(*i)->type
-                  << (int32_t)(*i)->x << (int32_t)(*i)->y << (int32_t)(*i)->z
-                  << (int8_t)(*i)->yaw << (int8_t)(*i)->pitch;
-      if ((*i)->type == MOB_SHEEP)
-      {
-        loginBuffer << (int8_t) 0 << (int8_t)(*i)->meta << (int8_t) 127;
-      }
-      else
-      {
-        loginBuffer << (int8_t) 127;
-      }
-    }
-  }
 
 
   // Send spawn position
@@ -268,7 +257,8 @@ bool User::sendLoginInfo()
   loginBuffer.reset();
 
   logged = true;
-  spawnUser((int32_t)pos.x * 32, (int32_t)((pos.y + 2) * 32), (int32_t)pos.z * 32);
+  // Spawns this player for those near, and those near for this player
+  Mineserver::get()->entityTracker()->addUser(this);
 
   for (int i = 1; i < 45; i++)
   {
@@ -293,7 +283,7 @@ bool User::kick(std::string kickMsg)
 {
   buffer << (int8_t)PACKET_KICK << kickMsg;
 
-  (static_cast<Hook2<bool, const char*, const char*>*>(Mineserver::get()->plugin()->getHook("PlayerKickPost")))->doAll(nick.c_str(), kickMsg.c_str());
+  (static_cast<Hook2<bool, const char*, const char*>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_KICK_POST)))->doAll(nick.c_str(), kickMsg.c_str());
 
   Mineserver::get()->logger()->log(LogType::LOG_WARNING, "User", nick + " kicked. Reason: " + kickMsg);
 
@@ -553,31 +543,24 @@ bool User::updatePosM(double x, double y, double z, int map, double stance)
   {
 
     //Loop every chunk loaded to make sure no user pointers are left!
-    for (int i = 0; i < 441; ++i)
+    std::vector<sChunk*> loaded = Mineserver::get()->map(pos.map)->chunks.getChunks();
+    for (std::vector<sChunk*>::iterator it = loaded.begin(); it != loaded.end(); ++it)
     {
-      sChunkNode* nextnode = NULL;
-      ChunkMap* cmap = &Mineserver::get()->map(pos.map)->chunks;
-      for (sChunkNode* node = cmap->m_buckets[i]; node != NULL; node = nextnode)
+      (*it)->users.erase(this);
+      if ((*it)->users.size() == 0)
       {
-        nextnode = node->next;
-        node->chunk->users.erase(this);
-        if (node->chunk->users.size() == 0)
-        {
-          Mineserver::get()->map(pos.map)->releaseMap(node->chunk->x, node->chunk->z);
-          //break;
-        }
+        Mineserver::get()->map(pos.map)->releaseMap((*it)->x, (*it)->z);
       }
     }
 
-    // TODO despawn players who are no longer in view
-    // TODO despawn self to players on last world
     pos.map = map;
     pos.x = x;
     pos.y = y;
     pos.z = z;
     Mineserver::get()->logger()->log(LogType::LOG_INFO, "User", "World changing");
-    // TODO spawn self to nearby players
-    // TODO spawn players who are NOW in view
+    // Destroys us on the last world and the players there for us, and
+    // spawns what is near on the new one
+    Mineserver::get()->entityTracker()->move(UID, map, x, y, z, angleToByte(pos.yaw), angleToByte(pos.pitch));
     return false;
   }
   updatePos(x, y, z, stance);
@@ -606,180 +589,60 @@ bool User::updatePos(double x, double y, double z, double stance)
       return false;
     }
 
-    if (newChunk == oldChunk)
-    {
-      Packet telePacket;
-      telePacket << (int8_t)PACKET_ENTITY_TELEPORT
-                 << (int32_t)UID << (int32_t)(x * 32) << (int32_t)(y * 32)
-                 << (int32_t)(z * 32) << angleToByte(pos.yaw) << angleToByte(pos.pitch);
-      newChunk->sendPacket(telePacket, this);
-    }
-    else if (abs(newChunk->x - oldChunk->x) <= 1  && abs(newChunk->z - oldChunk->z) <= 1)
+    if (newChunk != oldChunk)
     {
-
-      std::list<User*> toremove;
-      std::list<User*> toadd;
-
-      sChunk::userBoundary(oldChunk, toremove, newChunk, toadd);
-
-      if (toremove.size())
-      {
-        Packet pkt;
-        pkt << (int8_t)PACKET_DESTROY_ENTITY << (int32_t)UID;
-        std::list<User*>::iterator iter = toremove.begin(), end = toremove.end();
-        for (; iter != end ; iter++)
-        {
-          (*iter)->buffer.addToWrite(pkt.getWrite(), pkt.getWriteLen());
-        }
-      }
-
-      if (toadd.size())
+      if (abs(newChunk->x - oldChunk->x) <= 1  && abs(newChunk->z - oldChunk->z) <= 1)
       {
-        Packet pkt;
-        pkt << (int8_t)PACKET_NAMED_ENTITY_SPAWN << (int32_t)UID << nick
-            << (int32_t)(x * 32) << (int32_t)(y * 32) << (int32_t)(z * 32)
-            << angleToByte(pos.yaw) << angleToByte(pos.pitch) << (int16_t)curItem;
+        int chunkDiffX = newChunk->x - oldChunk->x;
+        int chunkDiffZ = newChunk->z - oldChunk->z;
 
-        std::list<User*>::iterator iter = toadd.begin(), end = toadd.end();
-        for (; iter != end ; iter++)
+        // Send new chunk and clear old chunks
+        for (int mapx = newChunk->x - viewDistance; mapx <= newChunk->x + viewDistance; mapx++)
         {
-          if ((*iter) != this)
+          for (int mapz = newChunk->z - viewDistance; mapz <= newChunk->z + viewDistance; mapz++)
           {
-            (*iter)->buffer.addToWrite(pkt.getWrite(), pkt.getWriteLen());
-          }
-        }
-      }
-
-      // TODO: Determine those who where present for both.
-      Packet telePacket;
-      telePacket << (int8_t)PACKET_ENTITY_TELEPORT
-                 << (int32_t)UID << (int32_t)(x * 32) << (int32_t)(y * 32) << (int32_t)(z * 32)
-                 << angleToByte(pos.yaw) << angleToByte(pos.pitch);
-      newChunk->sendPacket(telePacket, this);
-
-      int chunkDiffX = newChunk->x - oldChunk->x;
-      int chunkDiffZ = newChunk->z - oldChunk->z;
-
-      // Send new chunk and clear old chunks
-      for (int mapx = newChunk->x - viewDistance; mapx <= newChunk->x + viewDistance; mapx++)
-      {
-        for (int mapz = newChunk->z - viewDistance; mapz <= newChunk->z + viewDistance; mapz++)
-        {
-          if (!withinViewDistance((mapx - chunkDiffX), newChunk->x) || !withinViewDistance((mapz - chunkDiffZ), newChunk->z))
-          {
-            addRemoveQueue(mapx - chunkDiffX, mapz - chunkDiffZ);
-          }
+            if (!withinViewDistance((mapx - chunkDiffX), newChunk->x) || !withinViewDistance((mapz - chunkDiffZ), newChunk->z))
+            {
+              addRemoveQueue(mapx - chunkDiffX, mapz - chunkDiffZ);
+            }
 
-          // If this chunk wasn't in the view distance before
-          // if (!withinViewDistance(chunkDiffX, oldChunk->x) || !withinViewDistance(chunkDiffZ, oldChunk->z))
-          //{
+            // If this chunk wasn't in the view distance before
+            // if (!withinViewDistance(chunkDiffX, oldChunk->x) || !withinViewDistance(chunkDiffZ, oldChunk->z))
+            //{
 
-          // This will remove the chunks from being removed if they were put to the remove queue.
-          addQueue(mapx, mapz);
+            // This will remove the chunks from being removed if they were put to the remove queue.
+            addQueue(mapx, mapz);
 
 
-          //}
+            //}
+          }
         }
       }
-    }
-    else
-    {
-      std::set<User*> toRemove;
-      std::set<User*> toAdd;
-
-      int chunkDiffX = newChunk->x - oldChunk->x;
-      int chunkDiffZ = newChunk->z - oldChunk->z;
-      for (int mapx = newChunk->x - viewDistance; mapx <= newChunk->x + viewDistance; mapx++)
+      else
       {
-        for (int mapz = newChunk->z - viewDistance; mapz <= newChunk->z + viewDistance; mapz++)
+        int chunkDiffX = newChunk->x - oldChunk->x;
+        int chunkDiffZ = newChunk->z - oldChunk->z;
+        for (int mapx = newChunk->x - viewDistance; mapx <= newChunk->x + viewDistance; mapx++)
         {
-          if (!withinViewDistance(chunkDiffX, oldChunk->x) || !withinViewDistance(chunkDiffZ, oldChunk->z))
+          for (int mapz = newChunk->z - viewDistance; mapz <= newChunk->z + viewDistance; mapz++)
           {
-            addQueue(mapx, mapz);
-            sChunk* chunk = Mineserver::get()->map(pos.map)->chunks.getChunk(mapx, mapz);
-
-            if (chunk != NULL)
+            if (!withinViewDistance(chunkDiffX, oldChunk->x) || !withinViewDistance(chunkDiffZ, oldChunk->z))
             {
-              toAdd.insert(chunk->users.begin(), chunk->users.end());
+              addQueue(mapx, mapz);
             }
-          }
-
-          if (!withinViewDistance((mapx - chunkDiffX), newChunk->x) || !withinViewDistance((mapz - chunkDiffZ), newChunk->z))
-          {
-            addRemoveQueue(mapx - chunkDiffX, mapz - chunkDiffZ);
-
-            sChunk* chunk = Mineserver::get()->map(pos.map)->chunks.getChunk((mapx - chunkDiffX), (mapz - chunkDiffZ));
 
-            if (chunk != NULL)
+            if (!withinViewDistance((mapx - chunkDiffX), newChunk->x) || !withinViewDistance((mapz - chunkDiffZ), newChunk->z))
             {
-              toRemove.insert(chunk->users.begin(), chunk->users.end());
+              addRemoveQueue(mapx - chunkDiffX, mapz - chunkDiffZ);
             }
           }
         }
       }
-
-      std::set<User*> toTeleport;
-      std::set<User*>::iterator iter = toRemove.begin(), end = toRemove.end();
-      for (; iter != end ; iter++)
-      {
-        std::set<User*>::iterator result = toAdd.find(*iter);
-        if (result != toAdd.end())
-        {
-          toTeleport.insert(*iter);
-          toAdd.erase(result);
-
-#ifdef _MSC_VER
-          iter = toRemove.erase(iter);
-#else
-          // TODO: Optimise
-          toRemove.erase(iter);
-          iter = toRemove.begin();
-#endif
-          end = toRemove.end();
-          if (iter == end)
-          {
-            break;
-          }
-        }
-      }
-
-      Packet destroyPkt;
-      destroyPkt << (int8_t)PACKET_DESTROY_ENTITY << (int32_t)UID;
-
-      Packet spawnPkt;
-      spawnPkt << (int8_t)PACKET_NAMED_ENTITY_SPAWN << (int32_t)UID << nick
-               << (int32_t)(x * 32) << (int32_t)(y * 32) << (int32_t)(z * 32) << angleToByte(pos.yaw) << angleToByte(pos.pitch) << (int16_t)curItem;
-
-      Packet telePacket;
-      telePacket << (int8_t)PACKET_ENTITY_TELEPORT
-                 << (int32_t)UID << (int32_t)(x * 32) << (int32_t)(y * 32) << (int32_t)(z * 32) << angleToByte(pos.yaw) << angleToByte(pos.pitch);
-
-      toTeleport.erase(this);
-      toAdd.erase(this);
-      toRemove.erase(this);
-
-      iter = toRemove.begin();
-      end = toRemove.end();
-      for (; iter != end ; iter++)
-      {
-        (*iter)->buffer.addToWrite(destroyPkt.getWrite(), destroyPkt.getWriteLen());
-      }
-
-      iter = toAdd.begin();
-      end = toAdd.end();
-      for (; iter != end ; iter++)
-      {
-        (*iter)->buffer.addToWrite(spawnPkt.getWrite(), spawnPkt.getWriteLen());
-      }
-
-      iter = toTeleport.begin();
-      end = toTeleport.end();
-      for (; iter != end ; iter++)
-      {
-        (*iter)->buffer.addToWrite(telePacket.getWrite(), telePacket.getWriteLen());
-      }
     }
 
+    // Moves us for the players near, spawning or destroying us for those
+    // that got in or out of range
+    Mineserver::get()->entityTracker()->move(UID, pos.map, x, y, z, angleToByte(pos.yaw), angleToByte(pos.pitch));
 
     if (newChunk->items.size())
     {
@@ -900,22 +763,16 @@ bool User::checkOnBlock(int32_t x, int8_t y, int32_t z)
 
 bool User::updateLook(float yaw, float pitch)
 {
-  Packet pkt;
-  pkt << (int8_t)PACKET_ENTITY_LOOK << (int32_t)UID << angleToByte(yaw) << angleToByte(pitch);
-
-  sChunk* chunk = Mineserver::get()->map(pos.map)->chunks.getChunk(blockToChunk((int32_t)pos.x), blockToChunk((int32_t)pos.z));
-  if (chunk != NULL)
-  {
-    chunk->sendPacket(pkt, this);
-  }
-
   this->pos.yaw   = yaw;
   this->pos.pitch = pitch;
+
+  Mineserver::get()->entityTracker()->move(UID, pos.map, pos.x, pos.y, pos.z, angleToByte(yaw), angleToByte(pitch));
   return true;
 }
 
 bool User::sendOthers(uint8_t* data, uint32_t len)
 {
+  SharedBuffer* shared = SharedBuffer::create(data, len);
   for (unsigned int i = 0; i < Mineserver::get()->users().size(); i++)
   {
     if (Mineserver::get()->users()[i]->fd != this->fd && Mineserver::get()->users()[i]->logged)
@@ -923,10 +780,11 @@ bool User::sendOthers(uint8_t* data, uint32_t len)
       // Don't send to his user if he is DND and the message is a chat message
       if (!(Mineserver::get()->users()[i]->dnd && data[0] == PACKET_CHAT_MESSAGE))
       {
-        Mineserver::get()->users()[i]->buffer.addToWrite(data, len);
+        Mineserver::get()->users()[i]->buffer.addToWrite(shared);
       }
     }
   }
+  shared->release();
   return true;
 }
 
@@ -966,6 +824,7 @@ int8_t User::relativeToBlock(const int32_t x, const int8_t y, const int32_t z)
 
 bool User::sendAll(uint8_t* data, uint32_t len)
 {
+  SharedBuffer* shared = SharedBuffer::create(data, len);
   for (unsigned int i = 0; i < Mineserver::get()->users().size(); i++)
   {
     if (Mineserver::get()->users()[i]->fd && Mineserver::get()->users()[i]->logged)
@@ -973,101 +832,84 @@ bool User::sendAll(uint8_t* data, uint32_t len)
       // Don't send to his user if he is DND and the message is a chat message
       if (!(Mineserver::get()->users()[i]->dnd && data[0] == PACKET_CHAT_MESSAGE))
       {
-        Mineserver::get()->users()[i]->buffer.addToWrite(data, len);
+        Mineserver::get()->users()[i]->buffer.addToWrite(shared);
       }
     }
   }
+  shared->release();
   return true;
 }
 
 bool User::sendAdmins(uint8_t* data, uint32_t len)
 {
+  SharedBuffer* shared = SharedBuffer::create(data, len);
   for (unsigned int i = 0; i < Mineserver::get()->users().size(); i++)
   {
     if (Mineserver::get()->users()[i]->fd && Mineserver::get()->users()[i]->logged && IS_ADMIN(Mineserver::get()->users()[i]->permissions))
     {
-      Mineserver::get()->users()[i]->buffer.addToWrite(data, len);
+      Mineserver::get()->users()[i]->buffer.addToWrite(shared);
     }
   }
+  shared->release();
   return true;
 }
 
 bool User::sendOps(uint8_t* data, uint32_t len)
 {
+  SharedBuffer* shared = SharedBuffer::create(data, len);
   for (unsigned int i = 0; i < Mineserver::get()->users().size(); i++)
   {
     if (Mineserver::get()->users()[i]->fd && Mineserver::get()->users()[i]->logged && IS_ADMIN(Mineserver::get()->users()[i]->permissions))
     {
-      Mineserver::get()->users()[i]->buffer.addToWrite(data, len);
+      Mineserver::get()->users()[i]->buffer.addToWrite(shared);
     }
   }
+  shared->release();
   return true;
 }
 
 bool User::sendGuests(uint8_t* data, uint32_t len)
 {
+  SharedBuffer* shared = SharedBuffer::create(data, len);
   for (unsigned int i = 0; i < Mineserver::get()->users().size(); i++)
   {
     if (Mineserver::get()->users()[i]->fd && Mineserver::get()->users()[i]->logged && IS_ADMIN(Mineserver::get()->users()[i]->permissions))
     {
-      Mineserver::get()->users()[i]->buffer.addToWrite(data, len);
+      Mineserver::get()->users()[i]->buffer.addToWrite(shared);
     }
   }
+  shared->release();
   return true;
 }
 
 bool User::addQueue(int x, int z)
 {
-  vec newMap(x, 0, z);
-
   // Make sure this chunk is not being removed, if it is, delete it from remove queue
-  for (unsigned int i = 0; i < mapRemoveQueue.size(); i++)
-  {
-    if (mapRemoveQueue[i].x() == newMap.x() && mapRemoveQueue[i].z() == newMap.z())
-    {
-      mapRemoveQueue.erase(mapRemoveQueue.begin() + i);
-      break;
-    }
-  }
-
-  for (unsigned int i = 0; i < mapQueue.size(); i++)
-  {
-    // Check for duplicates
-    if (mapQueue[i].x() == newMap.x() && mapQueue[i].z() == newMap.z())
-    {
-      return false;
-    }
-  }
+  mapRemoveQueue.erase(x, z);
 
-  for (unsigned int i = 0; i < mapKnown.size(); i++)
+  // Check for duplicates
+  if (mapQueue.contains(x, z) || mapKnown.contains(x, z))
   {
-    // Check for duplicates
-    if (mapKnown[i].x() == newMap.x() && mapKnown[i].z() == newMap.z())
-    {
-      return false;
-    }
+    return false;
   }
 
   // Pre chunk
   buffer << (int8_t)PACKET_PRE_CHUNK << x << z << (int8_t)1;
 
-  this->mapQueue.push_back(newMap);
+  this->mapQueue.insert(x, z);
 
   return true;
 }
 
 bool User::addRemoveQueue(int x, int z)
 {
-  vec newMap(x, 0, z);
-
-  this->mapRemoveQueue.push_back(newMap);
+  this->mapRemoveQueue.insert(x, z);
 
   return true;
 }
 
 bool User::addKnown(int x, int z)
 {
-  vec newMap(x, 0, z);
   sChunk* chunk = Mineserver::get()->map(pos.map)->chunks.getChunk(x, z);
   if (chunk == NULL)
   {
@@ -1075,7 +917,7 @@ bool User::addKnown(int x, int z)
   }
 
   chunk->users.insert(this);
-  this->mapKnown.push_back(newMap);
+  this->mapKnown.insert(x, z);
 
   return true;
 }
@@ -1093,87 +935,160 @@ bool User::delKnown(int x, int z)
     }
   }
 
-  for (unsigned int i = 0; i < mapKnown.size(); i++)
+  return mapKnown.erase(x, z);
+}
+
+void User::setViewDistance(int distance)
+{
+  const int old = viewDistance;
+  viewDistance  = distance;
+  if (!logged || distance == old)
+  {
+    return;
+  }
+
+  const int cx = blockToChunk((int32_t)pos.x);
+  const int cz = blockToChunk((int32_t)pos.z);
+
+  if (distance > old)
   {
-    if (mapKnown[i].x() == x && mapKnown[i].z() == z)
+    for (int x = cx - distance; x <= cx + distance; x++)
     {
-      mapKnown.erase(mapKnown.begin() + i);
-      return true;
+      for (int z = cz - distance; z <= cz + distance; z++)
+      {
+        addQueue(x, z);
+      }
     }
+    return;
   }
 
-  return false;
+  // Queued chunks already got their pre chunk, so they're unloaded too
+  std::vector<uint64_t> outside;
+  for (int set = 0; set < 2; set++)
+  {
+    const std::vector<uint64_t>& keys = set ? mapKnown.keys() : mapQueue.keys();
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+      if (abs(ChunkSet::keyX(keys[i]) - cx) > distance || abs(ChunkSet::keyZ(keys[i]) - cz) > distance)
+      {
+        outside.push_back(keys[i]);
+      }
+    }
+  }
+  for (size_t i = 0; i < outside.size(); i++)
+  {
+    mapQueue.erase(ChunkSet::keyX(outside[i]), ChunkSet::keyZ(outside[i]));
+    addRemoveQueue(ChunkSet::keyX(outside[i]), ChunkSet::keyZ(outside[i]));
+  }
 }
 
 bool User::popMap()
 {
   // If map in queue, push it to client
-  while (this->mapRemoveQueue.size())
+  for (size_t i = 0; i < mapRemoveQueue.size(); i++)
   {
     // Pre chunk
-    buffer << (int8_t)PACKET_PRE_CHUNK << (int32_t)mapRemoveQueue[0].x() << (int32_t)mapRemoveQueue[0].z() << (int8_t)0;
+    buffer << (int8_t)PACKET_PRE_CHUNK << (int32_t)mapRemoveQueue.x(i) << (int32_t)mapRemoveQueue.z(i) << (int8_t)0;
 
     // Delete from known list
-    delKnown(mapRemoveQueue[0].x(), mapRemoveQueue[0].z());
-
-    // Remove from queue
-    mapRemoveQueue.erase(mapRemoveQueue.begin());
-
-    // return true;
+    delKnown(mapRemoveQueue.x(i), mapRemoveQueue.z(i));
   }
+  mapRemoveQueue.clear();
 
   return false;
 }
 
-namespace
-{
-
-class DistanceComparator
+bool User::pushMap(bool login)
 {
-private:
-  vec target;
-public:
-  DistanceComparator(vec tgt) : target(tgt)
+  if (mapQueue.empty())
   {
-    target.y() = 0;
+    return true;
   }
-  bool operator()(vec a, vec b) const
+
+  //Dont send all at once, login chunks go out before anything is measured
+  int maxcount = login ? 5 : pacer.budget(sendBacklog(), sendWritten());
+  if (maxcount == 0)
   {
-    a.y() = 0;
-    b.y() = 0;
-    return vec::squareDistance(a, target) <
-           vec::squareDistance(b, target);
+    return true;
   }
-};
+  const int budget = maxcount;
+  // Nor wait on too many chunks still being read from disk
+  int maxpending = 16;
 
-}
+  // Nearest first, and what we're looking at before what's behind
+  mapQueue.setCenter(blockToChunk((int32_t)pos.x), blockToChunk((int32_t)pos.z), pos.yaw);
+
+  Map* map = Mineserver::get()->map(pos.map);
 
-bool User::pushMap(bool login)
-{
-  //Dont send all at once
-  int maxcount = 5;
   // If map in queue, push it to client
-  while (this->mapQueue.size() > 0 && maxcount > 0)
+  std::vector<uint64_t> loading;
+  int x, z;
+  while (maxcount > 0 && mapQueue.pop(x, z))
   {
+    // Skip chunks that are still loading, login chunks are loaded right away
+    if (!login && !map->requestMap(x, z))
+    {
+      loading.push_back(ChunkSet::key(x, z));
+      if (--maxpending == 0)
+      {
+        break;
+      }
+      continue;
+    }
+
     maxcount--;
-    // Sort by distance from center
-    vec target(static_cast<int>(pos.x / 16),
-               static_cast<int>(pos.y / 16),
-               static_cast<int>(pos.z / 16));
-    sort(mapQueue.begin(), mapQueue.end(), DistanceComparator(target));
 
-    Mineserver::get()->map(pos.map)->sendToUser(this, mapQueue[0].x(), mapQueue[0].z(), login);
+    map->sendToUser(this, x, z, login);
 
     // Add this to known list
-    addKnown(mapQueue[0].x(), mapQueue[0].z());
+    addKnown(x, z);
+  }
+
+  // Back in the queue until they're loaded
+  for (size_t i = 0; i < loading.size(); i++)
+  {
+    mapQueue.insert(ChunkSet::keyX(loading[i]), ChunkSet::keyZ(loading[i]));
+  }
 
-    // Remove from queue
-    mapQueue.erase(mapQueue.begin());
+  if (!login)
+  {
+    pacer.sent(budget - maxcount);
   }
 
   return true;
 }
 
+uint32_t User::sendBacklog() const
+{
+  uint32_t backlog = buffer.getPendingWriteLen();
+
+  uint32_t pending, written;
+  if (Mineserver::get()->netThreads()->sendState(this, pending, written))
+  {
+    return backlog + pending;
+  }
+
+#ifdef TIOCOUTQ
+  // What the kernel hasn't got out on the wire either
+  int queued = 0;
+  if (ioctl(fd, TIOCOUTQ, &queued) == 0 && queued > 0)
+  {
+    backlog += queued;
+  }
+#endif
+  return backlog;
+}
+
+uint32_t User::sendWritten() const
+{
+  uint32_t pending, written;
+  if (Mineserver::get()->netThreads()->sendState(this, pending, written))
+  {
+    return written;
+  }
+  return bytesWritten;
+}
+
 bool User::teleport(double x, double y, double z, int map)
 {
   if (map == -1)
@@ -1200,51 +1115,6 @@ bool User::teleport(double x, double y, double z, int map)
   return true;
 }
 
-bool User::spawnUser(int x, int y, int z)
-{
-  Packet pkt;
-  pkt << (int8_t)PACKET_NAMED_ENTITY_SPAWN << (int32_t)UID << nick
-      << (int32_t)x << (int32_t)y << (int32_t)z << (int8_t)0 << (int8_t)0
-      << (int16_t)0;
-  sChunk* chunk = Mineserver::get()->map(pos.map)->chunks.getChunk(blockToChunk(x >> 5), blockToChunk(z >> 5));
-  if (chunk != NULL)
-  {
-    chunk->sendPacket(pkt, this);
-  }
-  return true;
-}
-
-bool User::spawnOthers()
-{
-
-  for (unsigned int i = 0; i < Mineserver::get()->users().size(); i++)
-  {
-    //    if (Mineserver::get()->users()[i]->logged && Mineserver::get()->users()[i]->UID != this->UID && Mineserver::get()->users()[i]->nick != this->nick)
-    if (Mineserver::get()->users()[i]->logged)
-    {
-      loginBuffer << (int8_t)PACKET_NAMED_ENTITY_SPAWN << (int32_t)Mineserver::get()->users()[i]->UID << Mineserver::get()->users()[i]->nick
-                  << (int32_t)(Mineserver::get()->users()[i]->pos.x * 32) << (int32_t)(Mineserver::get()->users()[i]->pos.y * 32) << (int32_t)(Mineserver::get()->users()[i]->pos.z * 32)
-                  << (int8_t)0 << (int8_t)0 << (int16_t)0;
-      for (int b = 0; b < 5; b++)
-      {
-        int n = b;
-        if (b == 0)
-        {
-          n = Mineserver::get()->users()[i]->curItem + 36;
-        }
-        else
-        {
-          n = 9 - b;
-        }
-        int type = Mineserver::get()->users()[i]->inv[n].getType();
-        loginBuffer << (int8_t)PACKET_ENTITY_EQUIPMENT << (int32_t)Mineserver::get()->users()[i]->UID
-                    << (int16_t)b << (int16_t)type << (int16_t) 0;
-      }
-    }
-  }
-  return true;
-}
-
 void User::checkEnvironmentDamage()
 {
   uint8_t type, meta;
@@ -1393,7 +1263,8 @@ bool User::sethealth(int userHealth)
     }
     Packet pkt;
     pkt << (int8_t)PACKET_ARM_ANIMATION << (int32_t)UID << (int8_t)2;
-    sendAll((uint8_t*)pkt.getWrite(), pkt.getWriteLen());
+    buffer.addToWrite(pkt.getWrite(), pkt.getWriteLen());
+    Mineserver::get()->entityTracker()->sendToObservers(UID, pkt);
 
 
   }
@@ -1409,15 +1280,9 @@ bool User::respawn()
   this->health = 20;
   this->timeUnderwater = 0;
   buffer << (int8_t)PACKET_RESPAWN;
-  Packet destroyPkt;
-  destroyPkt << (int8_t)PACKET_DESTROY_ENTITY << (int32_t)UID;
-  sChunk* chunk = Mineserver::get()->map(pos.map)->getMapData(blockToChunk((int32_t)pos.x), blockToChunk((int32_t)pos.z));
-  if (chunk != NULL)
-  {
-    chunk->sendPacket(destroyPkt, this);
-  }
+  Mineserver::get()->entityTracker()->remove(UID);
 
-  if ((static_cast<Hook1<bool, const char*>*>(Mineserver::get()->plugin()->getHook("PlayerRespawn")))->doUntilFalse(nick.c_str()))
+  if ((static_cast<Hook1<bool, const char*>*>(Mineserver::get()->plugin()->getHook(Plugin::HOOK_PLAYER_RESPAWN)))->doUntilFalse(nick.c_str()))
   {
     // In this case, the plugin teleports automatically
   }
@@ -1426,15 +1291,9 @@ bool User::respawn()
     teleport(Mineserver::get()->map(pos.map)->spawnPos.x(), Mineserver::get()->map(pos.map)->spawnPos.y() + 2, Mineserver::get()->map(pos.map)->spawnPos.z(), 0);
   }
 
-  Packet spawnPkt;
-  spawnPkt << (int8_t)PACKET_NAMED_ENTITY_SPAWN << (int32_t)UID << nick
-           << (int32_t)(pos.x * 32) << (int32_t)(pos.y * 32) << (int32_t)(pos.z * 32) << angleToByte(pos.yaw) << angleToByte(pos.pitch) << (int16_t)curItem;
-
-  chunk = Mineserver::get()->map(pos.map)->getMapData(blockToChunk((int32_t)pos.x), blockToChunk((int32_t)pos.z));
-  if (chunk != NULL)
-  {
-    chunk->sendPacket(spawnPkt, this);
-  }
+  // The client dropped its entities with the respawn, so everything near
+  // is spawned again along with us
+  Mineserver::get()->entityTracker()->addUser(this);
 
   return true;
 }
@@ -41,6 +41,11 @@
 #include "vec.h"
 #include "inventory.h"
 #include "packets.h"
+#include "chunkset.h"
+#include "chunkqueue.h"
+#include "sendpacer.h"
+
+struct NetConnection;
 
 struct position
 {
@@ -61,12 +66,14 @@ public:
   ~User();
 
   int fd;
+  // Set while a network thread owns the socket
+  NetConnection* netConn;
 
   //When we last received data from this user
   time_t lastData;
 
   //View distance in chunks -viewDistance <-> viewDistance
-  static const int viewDistance = 10;
+  int viewDistance;
   uint8_t action;
   bool waitForData;
   uint32_t write_err_count;
@@ -98,6 +105,8 @@ public:
   //Input buffer
   Packet buffer;
   Packet loginBuffer; // Used to send all login info at once
+  // Bytes written to the socket by the main thread
+  uint32_t bytesWritten;
 
   static std::vector<User*>& all();
   static bool isUser(int sock);
@@ -137,13 +146,15 @@ public:
   //Map related
 
   //Map queue
-  std::vector<vec> mapQueue;
+  ChunkQueue mapQueue;
+  //How many of the queued chunks to send at a time
+  SendPacer pacer;
 
   //Chunks needed to be removed from client
-  std::vector<vec> mapRemoveQueue;
+  ChunkSet mapRemoveQueue;
 
   //Known map pieces
-  std::vector<vec> mapKnown;
+  ChunkSet mapKnown;
 
   //Add map coords to queue
   bool addQueue(int x, int z);
@@ -157,15 +168,20 @@ public:
   //Delete known map piece
   bool delKnown(int x, int z);
 
+  //Change the view distance, queueing or unloading chunks at the edge
+  void setViewDistance(int distance);
+
   //Push queued map data to client
   bool pushMap(bool login = false);
+  // Output waiting to go out to the client and the running count of bytes
+  // written to its socket, for the pacer
+  uint32_t sendBacklog() const;
+  uint32_t sendWritten() const;
 
   //Push remove queued map data to client
   bool popMap();
 
   bool teleport(double x, double y, double z, int map = -1);
-  bool spawnUser(int x, int y, int z);
-  bool spawnOthers();
   bool sethealth(int userHealth);
   bool respawn();
   bool dropInventory();
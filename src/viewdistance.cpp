@@ -0,0 +1,87 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "viewdistance.h"
+
+namespace
+{
+
+// Seconds to wait after a change before shrinking again, and before growing
+const time_t SHRINK_DELAY = 2;
+const time_t GROW_DELAY   = 10;
+// Growing needs the tick under this share of its budget
+const double TICK_HEADROOM = 0.6;
+
+}
+
+ViewDistance::ViewDistance(int maxDistance, int minDistance, uint32_t tickBudgetMs, int chunkBudget)
+  : m_max(maxDistance),
+    m_min(minDistance < maxDistance ? minDistance : maxDistance),
+    m_tickBudget(tickBudgetMs),
+    m_chunkBudget(chunkBudget),
+    m_distance(maxDistance),
+    m_tickAverage(0),
+    m_lastChange(0)
+{
+}
+
+bool ViewDistance::update(time_t now, uint32_t tickMs, int chunks)
+{
+  m_tickAverage += (tickMs - m_tickAverage) / 8;
+
+  const bool tickOver  = m_tickBudget != 0 && m_tickAverage > m_tickBudget;
+  const bool chunkOver = m_chunkBudget != 0 && chunks > m_chunkBudget;
+
+  if (tickOver || chunkOver)
+  {
+    if (m_distance > m_min && now - m_lastChange >= SHRINK_DELAY)
+    {
+      m_distance--;
+      m_lastChange = now;
+      return true;
+    }
+    return false;
+  }
+
+  if (m_distance >= m_max || now - m_lastChange < GROW_DELAY)
+  {
+    return false;
+  }
+
+  // The loaded area grows with the square of the distance, make sure the
+  // next step still fits
+  const double grown = (double)(2 * m_distance + 3) * (2 * m_distance + 3) /
+                       ((double)(2 * m_distance + 1) * (2 * m_distance + 1));
+  if ((m_tickBudget == 0 || m_tickAverage < m_tickBudget * TICK_HEADROOM) &&
+      (m_chunkBudget == 0 || chunks * grown < m_chunkBudget))
+  {
+    m_distance++;
+    m_lastChange = now;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,73 @@
+/*
+   Copyright (c) 2011, The Mineserver Project
+   All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * Neither the name of the The Mineserver Project nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _VIEWDISTANCE_H
+#define _VIEWDISTANCE_H
+
+#include <stdint.h>
+#include <ctime>
+
+//
+// The view distance every player gets, in chunks. It comes down a chunk at
+// a time while a tick takes longer than the tick budget on average
+// or more chunks are loaded than the chunk budget, and goes back up once
+// both have headroom again. Growing waits longer than shrinking so it
+// doesn't swing back and forth around a budget.
+//
+class ViewDistance
+{
+public:
+  // A budget of 0 isn't checked
+  ViewDistance(int maxDistance, int minDistance, uint32_t tickBudgetMs, int chunkBudget);
+
+  int distance() const
+  {
+    return m_distance;
+  }
+
+  // Feed one tick: how long it took and how many chunks
+  // are loaded. Returns true if the distance changed.
+  bool update(time_t now, uint32_t tickMs, int chunks);
+
+  // Average tick, in ms
+  double tickAverage() const
+  {
+    return m_tickAverage;
+  }
+
+private:
+  int m_max;
+  int m_min;
+  uint32_t m_tickBudget;
+  int m_chunkBudget;
+
+  int m_distance;
+  double m_tickAverage;
+  time_t m_lastChange;
+};
+
+#endif